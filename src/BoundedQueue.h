@@ -0,0 +1,84 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+#ifndef BOUNDED_QUEUE_H_
+#define BOUNDED_QUEUE_H_
+
+#include <condition_variable>
+#include <cstddef> /* std::size_t */
+#include <deque>
+#include <mutex>
+#include <utility> /* move */
+
+
+
+namespace GS {
+
+/*******************************************************************************
+ * Queue with a maximum size, to pass items from one thread to another.
+ *
+ * push waits while the queue is full, and pop waits while it is empty.
+ * After close(), both return false immediately, and the items that are
+ * still in the queue are discarded. It is used to stop the other thread
+ * when one of them fails.
+ */
+template<typename T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(std::size_t capacity)
+		: capacity_(capacity)
+		, closed_(false) {}
+
+	bool push(T item) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		notFull_.wait(lock, [this] { return closed_ || queue_.size() < capacity_; });
+		if (closed_) return false;
+		queue_.push_back(std::move(item));
+		notEmpty_.notify_one();
+		return true;
+	}
+	bool pop(T& item) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		notEmpty_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+		if (closed_) return false;
+		item = std::move(queue_.front());
+		queue_.pop_front();
+		notFull_.notify_one();
+		return true;
+	}
+	void close() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		closed_ = true;
+		queue_.clear();
+		notEmpty_.notify_all();
+		notFull_.notify_all();
+	}
+private:
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	const std::size_t capacity_;
+	bool closed_;
+	std::deque<T> queue_;
+	std::mutex mutex_;
+	std::condition_variable notEmpty_;
+	std::condition_variable notFull_;
+};
+
+} /* namespace GS */
+
+#endif /* BOUNDED_QUEUE_H_ */
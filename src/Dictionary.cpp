@@ -17,29 +17,126 @@
 
 #include "Dictionary.h"
 
+#include <algorithm> /* stable_sort */
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <iterator> /* istreambuf_iterator */
+#include <utility> /* move, pair */
+#include <vector>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
 
 #include "Exception.h"
 #include "Log.h"
 
+/*******************************************************************************
+ * Binary format (all integers are 32-bit little-endian):
+ *
+ *   magic          8 bytes
+ *   numEntries
+ *   versionOffset
+ *   entries        numEntries x (keyOffset, valueOffset), sorted by key
+ *   strings        null-terminated
+ *
+ * The offsets are relative to the start of the file.
+ */
+#define BINARY_DICTIONARY_MAGIC "GSDICT01"
+#define BINARY_DICTIONARY_MAGIC_SIZE 8
+#define BINARY_DICTIONARY_HEADER_SIZE (BINARY_DICTIONARY_MAGIC_SIZE + 2 * 4)
+#define BINARY_DICTIONARY_ENTRY_SIZE (2 * 4)
+
+
+
+namespace {
+
+unsigned int
+readUInt32LE(const char* p)
+{
+	const unsigned char* up = reinterpret_cast<const unsigned char*>(p);
+	return  static_cast<unsigned int>(up[0])
+		| (static_cast<unsigned int>(up[1]) << 8)
+		| (static_cast<unsigned int>(up[2]) << 16)
+		| (static_cast<unsigned int>(up[3]) << 24);
+}
+
+void
+writeUInt32LE(std::ostream& out, std::size_t data)
+{
+	char array[4];
+
+	array[0] =  data        & 0xff;
+	array[1] = (data >> 8)  & 0xff;
+	array[2] = (data >> 16) & 0xff;
+	array[3] = (data >> 24) & 0xff;
 
+	out.write(array, 4);
+}
+
+} /* namespace */
 
 namespace GS {
 
 Dictionary::Dictionary()
+		: data_(nullptr)
+		, dataSize_(0)
+		, numEntries_(0)
 {
 }
 
 Dictionary::~Dictionary()
 {
+	clear();
 }
 
 void
-Dictionary::load(const char* filePath)
+Dictionary::clear()
 {
 	map_.clear();
+	version_.clear();
+#ifdef _WIN32
+	fileData_.clear();
+#else
+	if (data_ != nullptr) {
+		munmap(const_cast<char*>(data_), dataSize_);
+	}
+#endif
+	data_ = nullptr;
+	dataSize_ = 0;
+	numEntries_ = 0;
+}
 
+void
+Dictionary::load(const char* filePath)
+{
+	clear();
+
+	char magic[BINARY_DICTIONARY_MAGIC_SIZE];
+	{
+		std::ifstream in(filePath, std::ios_base::in | std::ios_base::binary);
+		if (!in) {
+			THROW_EXCEPTION(IOException, "Could not open the file " << filePath << '.');
+		}
+		if (!in.read(magic, BINARY_DICTIONARY_MAGIC_SIZE)) {
+			magic[0] = '\0';
+		}
+	}
+
+	if (std::memcmp(magic, BINARY_DICTIONARY_MAGIC, BINARY_DICTIONARY_MAGIC_SIZE) == 0) {
+		loadBinary(filePath);
+	} else {
+		loadText(filePath);
+	}
+}
+
+void
+Dictionary::loadText(const char* filePath)
+{
 	std::ifstream in(filePath, std::ios_base::in | std::ios_base::binary);
 	if (!in) {
 		THROW_EXCEPTION(IOException, "Could not open the file " << filePath << '.');
@@ -71,9 +168,81 @@ Dictionary::load(const char* filePath)
 	}
 }
 
+void
+Dictionary::loadBinary(const char* filePath)
+{
+#ifdef _WIN32
+	std::ifstream in(filePath, std::ios_base::in | std::ios_base::binary);
+	if (!in) {
+		THROW_EXCEPTION(IOException, "Could not open the file " << filePath << '.');
+	}
+	fileData_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	data_ = fileData_.data();
+	dataSize_ = fileData_.size();
+#else
+	int fd = open(filePath, O_RDONLY);
+	if (fd == -1) {
+		THROW_EXCEPTION(IOException, "Could not open the file " << filePath << '.');
+	}
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) == -1) {
+		close(fd);
+		THROW_EXCEPTION(IOException, "Could not get the size of the file " << filePath << '.');
+	}
+	void* p = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		THROW_EXCEPTION(IOException, "Could not map the file " << filePath << " into memory.");
+	}
+	data_ = static_cast<const char*>(p);
+	dataSize_ = fileStat.st_size;
+#endif
+
+	if (dataSize_ < BINARY_DICTIONARY_HEADER_SIZE || data_[dataSize_ - 1] != '\0') {
+		clear();
+		THROW_EXCEPTION(IOException, "Invalid binary dictionary: " << filePath << '.');
+	}
+	unsigned int numEntries = readUInt32LE(data_ + BINARY_DICTIONARY_MAGIC_SIZE);
+	if (numEntries > (dataSize_ - BINARY_DICTIONARY_HEADER_SIZE) / BINARY_DICTIONARY_ENTRY_SIZE) {
+		clear();
+		THROW_EXCEPTION(IOException, "Invalid binary dictionary: " << filePath << '.');
+	}
+	numEntries_ = numEntries;
+
+	version_ = binaryString(readUInt32LE(data_ + BINARY_DICTIONARY_MAGIC_SIZE + 4));
+	LOG_DEBUG("Dictionary version: " << version_);
+}
+
+const char*
+Dictionary::binaryString(unsigned int offset) const
+{
+	if (offset >= dataSize_) {
+		THROW_EXCEPTION(IOException, "Invalid offset in the binary dictionary: " << offset << '.');
+	}
+	return data_ + offset;
+}
+
 const char*
 Dictionary::getEntry(const char* word) const
 {
+	if (data_ != nullptr) {
+		const char* entries = data_ + BINARY_DICTIONARY_HEADER_SIZE;
+		unsigned int first = 0, last = numEntries_;
+		while (first < last) {
+			unsigned int middle = first + (last - first) / 2;
+			const char* entry = entries + middle * BINARY_DICTIONARY_ENTRY_SIZE;
+			int cmp = std::strcmp(word, binaryString(readUInt32LE(entry)));
+			if (cmp == 0) {
+				return binaryString(readUInt32LE(entry + 4));
+			} else if (cmp < 0) {
+				last = middle;
+			} else {
+				first = middle + 1;
+			}
+		}
+		return nullptr;
+	}
+
 	if (map_.empty()) {
 		return nullptr;
 	}
@@ -90,11 +259,83 @@ Dictionary::getEntry(const char* word) const
 const char*
 Dictionary::version() const
 {
-	if (map_.empty()) {
+	if (map_.empty() && numEntries_ == 0) {
 		return "None";
 	}
 
 	return version_.c_str();
 }
 
+/*******************************************************************************
+ * If a word is duplicated, the first entry is used, as in load().
+ */
+void
+Dictionary::compile(const char* textFilePath, const char* binaryFilePath)
+{
+	std::ifstream in(textFilePath, std::ios_base::in | std::ios_base::binary);
+	if (!in) {
+		THROW_EXCEPTION(IOException, "Could not open the file " << textFilePath << '.');
+	}
+
+	std::string version;
+	if (!std::getline(in, version)) {
+		THROW_EXCEPTION(IOException, "Could not read the dictionary version.");
+	}
+
+	std::vector<std::pair<std::string, std::string>> entryList;
+	std::string line;
+	while (std::getline(in, line)) {
+		auto pos = line.find_first_of(' ');
+		if (pos == std::string::npos) {
+			THROW_EXCEPTION(IOException, "Could not find a space in the line: [" << line << ']');
+		}
+		entryList.push_back(std::make_pair(line.substr(0, pos), line.substr(pos + 1, std::string::npos)));
+	}
+
+	std::stable_sort(entryList.begin(), entryList.end(),
+		[](const std::pair<std::string, std::string>& a, const std::pair<std::string, std::string>& b) {
+			return std::strcmp(a.first.c_str(), b.first.c_str()) < 0;
+		});
+	std::size_t numEntries = 0;
+	for (std::size_t i = 0; i < entryList.size(); ++i) {
+		if (numEntries > 0 && entryList[i].first == entryList[numEntries - 1].first) {
+			std::cerr << "Duplicate word: [" << entryList[i].first << ']' << std::endl;
+			continue;
+		}
+		if (numEntries != i) {
+			entryList[numEntries] = std::move(entryList[i]);
+		}
+		++numEntries;
+	}
+	entryList.resize(numEntries);
+
+	std::ofstream out(binaryFilePath, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	if (!out) {
+		THROW_EXCEPTION(IOException, "Could not open the file " << binaryFilePath << " for writing.");
+	}
+
+	out.write(BINARY_DICTIONARY_MAGIC, BINARY_DICTIONARY_MAGIC_SIZE);
+	writeUInt32LE(out, numEntries);
+	std::size_t offset = BINARY_DICTIONARY_HEADER_SIZE + numEntries * BINARY_DICTIONARY_ENTRY_SIZE;
+	writeUInt32LE(out, offset); // version
+	offset += version.size() + 1;
+	for (const auto& entry : entryList) {
+		writeUInt32LE(out, offset);
+		offset += entry.first.size() + 1;
+		writeUInt32LE(out, offset);
+		offset += entry.second.size() + 1;
+	}
+	if (offset > 0xffffffffU) {
+		THROW_EXCEPTION(IOException, "The dictionary is too large.");
+	}
+	out.write(version.c_str(), version.size() + 1);
+	for (const auto& entry : entryList) {
+		out.write(entry.first.c_str(), entry.first.size() + 1);
+		out.write(entry.second.c_str(), entry.second.size() + 1);
+	}
+	if (!out) {
+		THROW_EXCEPTION(IOException, "Could not write to the file " << binaryFilePath << '.');
+	}
+}
+
 } /* namespace GS */
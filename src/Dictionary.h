@@ -18,25 +18,46 @@
 #ifndef DICTIONARY_H_
 #define DICTIONARY_H_
 
+#include <cstddef> /* std::size_t */
 #include <string>
 #include <unordered_map>
 
 namespace GS {
 
+// The dictionary may be stored as text (one "word pronunciation" line per
+// entry, after a version line) or in the binary format created by compile().
+// A binary dictionary is mapped into memory and searched in place.
 class Dictionary {
 public:
 	Dictionary();
 	~Dictionary();
 
+	// Detects the format of the file.
 	void load(const char* filePath);
 	const char* getEntry(const char* word) const;
 	const char* version() const;
+
+	// Converts a text dictionary to the binary format.
+	static void compile(const char* textFilePath, const char* binaryFilePath);
 private:
 	Dictionary(const Dictionary&) = delete;
 	Dictionary& operator=(const Dictionary&) = delete;
 
+	void clear();
+	void loadText(const char* filePath);
+	void loadBinary(const char* filePath);
+	const char* binaryString(unsigned int offset) const;
+
 	std::unordered_map<std::string, std::string> map_;
 	std::string version_;
+
+	// Binary format.
+	const char* data_;
+	std::size_t dataSize_;
+	unsigned int numEntries_;
+#ifdef _WIN32
+	std::string fileData_;
+#endif
 };
 
 } /* namespace GS */
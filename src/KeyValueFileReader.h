@@ -32,6 +32,7 @@ class KeyValueFileReader {
 public:
 	KeyValueFileReader(const std::string& filePath);
 
+	bool hasKey(const std::string& key) const { return valueMap_.find(key) != valueMap_.end(); }
 	template<typename T> T value(const std::string& key) const;
 	template<typename T> T value(const std::string& key, T minValue, T maxValue) const;
 private:
@@ -30,6 +30,7 @@
 
 
 #define BITS_PER_SAMPLE 16
+#define WRITE_BLOCK_SIZE 1024
 
 
 
@@ -143,6 +144,36 @@ WAVEFileWriter::writeStereoSamples(float leftSample, float rightSample)
 	writeUInt16LE(static_cast<int>(std::round(rightSample * sampleScale_)));
 }
 
+/******************************************************************************
+*
+*       function:       writeSamples
+*
+*       purpose:        Converts a block of samples (interleaved, if there
+*                       are two channels) like writeSample, and writes
+*                       them to the output file with one call to fwrite
+*                       per WRITE_BLOCK_SIZE samples.
+*
+*       samples: [-1.0, 1.0]
+*
+******************************************************************************/
+void
+WAVEFileWriter::writeSamples(const float* samples, std::size_t size)
+{
+	unsigned char array[2 * WRITE_BLOCK_SIZE];
+
+	while (size > 0) {
+		std::size_t n = size < WRITE_BLOCK_SIZE ? size : WRITE_BLOCK_SIZE;
+		for (std::size_t i = 0; i < n; ++i) {
+			int data = static_cast<int>(std::round(samples[i] * sampleScale_));
+			array[2 * i    ] =  data       & 0xff;
+			array[2 * i + 1] = (data >> 8) & 0xff;
+		}
+		fwrite(array, sizeof(unsigned char), 2 * n, stream_);
+		samples += n;
+		size -= n;
+	}
+}
+
 /******************************************************************************
 *
 *       function:       writeUInt32LE
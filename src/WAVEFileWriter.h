@@ -23,6 +23,7 @@
 #ifndef WAVE_FILE_WRITER_H_
 #define WAVE_FILE_WRITER_H_
 
+#include <cstddef> /* std::size_t */
 #include <cstdio>
 
 
@@ -38,6 +39,7 @@ public:
 
 	void writeSample(float sample);
 	void writeStereoSamples(float leftSample, float rightSample);
+	void writeSamples(const float* samples, std::size_t size);
 private:
 	WAVEFileWriter(const WAVEFileWriter&) = delete;
 	WAVEFileWriter& operator=(const WAVEFileWriter&) = delete;
@@ -0,0 +1,58 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+#include "Dictionary.h"
+#include "global.h"
+
+
+
+void
+showUsage(const char* programName)
+{
+	std::cout << "\nGnuspeechSA " << PROGRAM_VERSION << "\n\n";
+	std::cout << "Usage:\n\n";
+	std::cout << programName << " --version\n";
+	std::cout << "        Shows the program version.\n\n";
+	std::cout << programName << " dictionary dictionary.bin\n";
+	std::cout << "        Converts a text dictionary to the binary format.\n" << std::endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+	if (argc == 2 && strcmp(argv[1], "--version") == 0) {
+		showUsage(argv[0]);
+		return 0;
+	}
+	if (argc != 3) {
+		showUsage(argv[0]);
+		return 1;
+	}
+
+	try {
+		GS::Dictionary::compile(argv[1], argv[2]);
+	} catch (std::exception& e) {
+		std::cerr << "Caught an exception: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,669 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+// Synthesis server.
+//
+// The configuration, the model and the dictionaries are loaded once, and
+// the requests are received from a Unix domain socket or from stdin.
+//
+// Request:
+//     SYNTHESIZE length=<n> [format=wav|pcm] [voice=<name>] [tempo=<x>] [pitch=<x>]\n
+//     <n bytes of text>
+//   format: wav (default) or pcm (16-bit signed little-endian, interleaved)
+//   voice : name of a voice_<name>.config file in the configuration directory
+//   tempo : replaces the tempo of trm_control_model.config
+//   pitch : replaces the pitch offset (semitones) of trm_control_model.config
+//
+// Response:
+//     OK format=<wav|pcm> rate=<Hz> channels=<n> length=<n>\n
+//     <n bytes of audio>
+//   or
+//     ERROR <message>\n
+//
+// The connection is closed after an ERROR caused by an invalid request header.
+
+#include <algorithm> /* max, min, replace */
+#include <cerrno>
+#include <cmath> /* round */
+#include <cstdint>
+#include <cstdlib> /* atoi, strtod */
+#include <cstring>
+#include <exception>
+#include <functional> /* ref */
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+# include <io.h>
+# define read _read
+# define write _write
+#else
+# include <csignal>
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <unistd.h>
+#endif
+
+#include "Controller.h"
+#include "Exception.h"
+#include "global.h"
+#include "Log.h"
+#include "Model.h"
+#include "en/phonetic_string_parser/PhoneticStringParser.h"
+#include "en/text_parser/TextParser.h"
+#include "TRMConfiguration.h"
+#include "TRMControlModelConfiguration.h"
+
+#define TRM_CONFIG_FILE_NAME "/trm.config"
+#define VOICE_FILE_PREFIX "/voice_"
+#define MAX_HEADER_SIZE 1024
+#define MAX_TEXT_SIZE (1024 * 1024)
+
+
+
+namespace {
+
+enum OutputFormat {
+	FORMAT_WAV,
+	FORMAT_PCM
+};
+
+struct Request {
+	std::size_t length;
+	OutputFormat format;
+	std::string voice;
+	bool hasTempo;
+	double tempo;
+	bool hasPitch;
+	double pitch;
+	Request()
+		: length(0)
+		, format(FORMAT_WAV)
+		, hasTempo(false)
+		, tempo(0.0)
+		, hasPitch(false)
+		, pitch(0.0) {}
+};
+
+/*******************************************************************************
+ * The voice configurations are loaded on first use, and shared by the sessions.
+ */
+class VoiceCache {
+public:
+	explicit VoiceCache(const char* configDirPath) : configDirPath_(configDirPath) {}
+
+	const GS::TRM::Configuration& get(const std::string& voiceName);
+private:
+	std::string configDirPath_;
+	std::mutex mutex_;
+	std::map<std::string, GS::TRM::Configuration> voiceMap_;
+};
+
+/*******************************************************************************
+ * The objects used to synthesize one request at a time.
+ */
+class Session {
+public:
+	Session(const char* configDirPath, const GS::TRMControlModel::Model& model, VoiceCache& voiceCache);
+
+	void synthesize(const Request& request, const std::string& text, std::vector<char>& audio,
+			unsigned int& outputRate, unsigned int& channels);
+private:
+	Session(const Session&) = delete;
+	Session& operator=(const Session&) = delete;
+
+	VoiceCache& voiceCache_;
+	std::unique_ptr<GS::TRMControlModel::Controller> trmController_;
+	std::unique_ptr<GS::En::TextParser> textParser_;
+	std::unique_ptr<GS::En::PhoneticStringParser> phoneticStringParser_;
+	GS::TRMControlModel::Configuration defaultTRMControlModelConfig_;
+	GS::TRM::Configuration defaultTRMConfig_;
+	std::vector<float> buffer_;
+};
+
+std::mutex logMutex;
+
+
+
+const GS::TRM::Configuration&
+VoiceCache::get(const std::string& voiceName)
+{
+	if (voiceName.empty() || voiceName.find_first_not_of("abcdefghijklmnopqrstuvwxyz0123456789_") != std::string::npos) {
+		THROW_EXCEPTION(GS::InvalidParameterException, "Invalid voice name: " << voiceName << '.');
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto iter = voiceMap_.find(voiceName);
+	if (iter != voiceMap_.end()) {
+		return iter->second;
+	}
+
+	GS::TRM::Configuration config;
+	config.load(configDirPath_ + TRM_CONFIG_FILE_NAME, configDirPath_ + VOICE_FILE_PREFIX + voiceName + ".config");
+	return voiceMap_.insert(std::make_pair(voiceName, config)).first->second;
+}
+
+Session::Session(const char* configDirPath, const GS::TRMControlModel::Model& model, VoiceCache& voiceCache)
+		: voiceCache_(voiceCache)
+{
+	trmController_.reset(new GS::TRMControlModel::Controller(configDirPath, model));
+	const GS::TRMControlModel::Configuration& trmControlConfig = trmController_->trmControlModelConfiguration();
+	textParser_.reset(new GS::En::TextParser(configDirPath,
+							trmControlConfig.dictionary1File,
+							trmControlConfig.dictionary2File,
+							trmControlConfig.dictionary3File));
+	phoneticStringParser_.reset(new GS::En::PhoneticStringParser(configDirPath, *trmController_));
+
+	defaultTRMControlModelConfig_ = trmController_->trmControlModelConfiguration();
+	defaultTRMConfig_ = trmController_->trmConfiguration();
+}
+
+void
+Session::synthesize(const Request& request, const std::string& text, std::vector<char>& audio,
+			unsigned int& outputRate, unsigned int& channels)
+{
+	GS::TRMControlModel::Configuration& trmControlConfig = trmController_->trmControlModelConfiguration();
+	trmControlConfig = defaultTRMControlModelConfig_;
+	if (request.hasTempo) {
+		trmControlConfig.tempo = request.tempo;
+	}
+	if (request.hasPitch) {
+		trmControlConfig.pitchOffset = request.pitch;
+	}
+	if (request.voice.empty()) {
+		trmController_->trmConfiguration() = defaultTRMConfig_;
+	} else {
+		trmControlConfig.voiceName = request.voice;
+		trmController_->trmConfiguration() = voiceCache_.get(request.voice);
+	}
+
+	std::string phoneticString = textParser_->parseText(text.c_str());
+	if (GS::Log::debugEnabled) {
+		std::lock_guard<std::mutex> lock(logMutex);
+		std::cerr << "Phonetic string: [" << phoneticString << ']' << std::endl;
+	}
+
+	trmController_->synthesizePhoneticString(*phoneticStringParser_, phoneticString.c_str(), nullptr, buffer_);
+
+	// The output rate may have been changed by the Controller.
+	outputRate = static_cast<unsigned int>(std::round(trmController_->trmConfiguration().outputRate));
+	channels = trmController_->trmConfiguration().channels;
+
+	const std::size_t headerSize = (request.format == FORMAT_WAV) ? 44 : 0;
+	const std::size_t dataSize = buffer_.size() * sizeof(std::int16_t);
+	audio.resize(headerSize + dataSize);
+	unsigned char* p = reinterpret_cast<unsigned char*>(&audio[0]);
+
+	auto putUInt32LE = [&](std::uint32_t data) {
+		*p++ =  data        & 0xff;
+		*p++ = (data >> 8)  & 0xff;
+		*p++ = (data >> 16) & 0xff;
+		*p++ = (data >> 24) & 0xff;
+	};
+	auto putUInt16LE = [&](std::uint32_t data) {
+		*p++ =  data       & 0xff;
+		*p++ = (data >> 8) & 0xff;
+	};
+
+	if (request.format == FORMAT_WAV) {
+		const unsigned int frameSize = channels * sizeof(std::int16_t);
+		std::memcpy(p, "RIFF", 4); p += 4;
+		putUInt32LE(4 + 24 + (8 + dataSize));
+		std::memcpy(p, "WAVEfmt ", 8); p += 8;
+		putUInt32LE(16);
+		putUInt16LE(1); // PCM
+		putUInt16LE(channels);
+		putUInt32LE(outputRate);
+		putUInt32LE(outputRate * frameSize);
+		putUInt16LE(frameSize);
+		putUInt16LE(16); // bits per sample
+		std::memcpy(p, "data", 4); p += 4;
+		putUInt32LE(dataSize);
+	}
+	for (float sample : buffer_) {
+		putUInt16LE(static_cast<std::uint16_t>(static_cast<int>(std::round(sample * INT16_MAX))));
+	}
+}
+
+bool
+writeAll(int fd, const char* data, std::size_t size)
+{
+	while (size > 0) {
+		int n = write(fd, data, size);
+		if (n <= 0) return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+bool
+writeString(int fd, const std::string& s)
+{
+	return writeAll(fd, s.data(), s.size());
+}
+
+/*******************************************************************************
+ * Buffered reader for the request stream.
+ */
+class RequestReader {
+public:
+	explicit RequestReader(int fd) : fd_(fd), pos_(0), end_(0) {}
+
+	// Returns false at the end of the stream.
+	// Throws an exception if the line is too long.
+	bool readLine(std::string& line);
+	// Returns false if the stream ends before size bytes.
+	bool readData(std::string& data, std::size_t size);
+private:
+	bool fill();
+
+	int fd_;
+	std::size_t pos_;
+	std::size_t end_;
+	char buffer_[4096];
+};
+
+bool
+RequestReader::fill()
+{
+	int n = ::read(fd_, buffer_, sizeof buffer_);
+	if (n <= 0) return false;
+	pos_ = 0;
+	end_ = n;
+	return true;
+}
+
+bool
+RequestReader::readLine(std::string& line)
+{
+	line.clear();
+	for (;;) {
+		if (pos_ == end_ && !fill()) {
+			return false;
+		}
+		char c = buffer_[pos_++];
+		if (c == '\n') {
+			if (!line.empty() && line[line.size() - 1] == '\r') {
+				line.resize(line.size() - 1);
+			}
+			return true;
+		}
+		if (line.size() == MAX_HEADER_SIZE) {
+			THROW_EXCEPTION(GS::ParsingException, "Request header too long.");
+		}
+		line += c;
+	}
+}
+
+bool
+RequestReader::readData(std::string& data, std::size_t size)
+{
+	data.clear();
+	data.reserve(size);
+	while (data.size() < size) {
+		if (pos_ == end_ && !fill()) {
+			return false;
+		}
+		std::size_t n = std::min(size - data.size(), end_ - pos_);
+		data.append(buffer_ + pos_, n);
+		pos_ += n;
+	}
+	return true;
+}
+
+double
+parseDouble(const std::string& key, const std::string& value)
+{
+	char* end;
+	double d = std::strtod(value.c_str(), &end);
+	if (value.empty() || *end != '\0') {
+		THROW_EXCEPTION(GS::ParsingException, "Invalid value for " << key << ": " << value << '.');
+	}
+	return d;
+}
+
+void
+parseRequestHeader(const std::string& line, Request& request)
+{
+	std::istringstream in(line);
+	std::string command;
+	in >> command;
+	if (command != "SYNTHESIZE") {
+		THROW_EXCEPTION(GS::ParsingException, "Invalid command: " << command << '.');
+	}
+
+	bool hasLength = false;
+	std::string token;
+	while (in >> token) {
+		std::size_t equalPos = token.find('=');
+		if (equalPos == std::string::npos) {
+			THROW_EXCEPTION(GS::ParsingException, "Invalid request parameter: " << token << '.');
+		}
+		std::string key = token.substr(0, equalPos);
+		std::string value = token.substr(equalPos + 1);
+		if (key == "length") {
+			char* end;
+			unsigned long length = std::strtoul(value.c_str(), &end, 10);
+			if (value.empty() || *end != '\0' || length > MAX_TEXT_SIZE) {
+				THROW_EXCEPTION(GS::ParsingException, "Invalid length: " << value << '.');
+			}
+			request.length = length;
+			hasLength = true;
+		} else if (key == "format") {
+			if (value == "wav") {
+				request.format = FORMAT_WAV;
+			} else if (value == "pcm") {
+				request.format = FORMAT_PCM;
+			} else {
+				THROW_EXCEPTION(GS::ParsingException, "Invalid format: " << value << '.');
+			}
+		} else if (key == "voice") {
+			request.voice = value;
+		} else if (key == "tempo") {
+			request.tempo = parseDouble(key, value);
+			if (request.tempo <= 0.0) {
+				THROW_EXCEPTION(GS::ParsingException, "Invalid tempo: " << value << '.');
+			}
+			request.hasTempo = true;
+		} else if (key == "pitch") {
+			request.pitch = parseDouble(key, value);
+			request.hasPitch = true;
+		} else {
+			THROW_EXCEPTION(GS::ParsingException, "Invalid request parameter: " << key << '.');
+		}
+	}
+	if (!hasLength) {
+		THROW_EXCEPTION(GS::ParsingException, "Missing length.");
+	}
+}
+
+std::string
+errorLine(const std::exception& e)
+{
+	// Only the first line of the message (the others contain the location in the source code).
+	std::string message = e.what();
+	std::size_t pos = message.find('\n');
+	if (pos != std::string::npos) {
+		message.resize(pos);
+	}
+	return "ERROR " + message + '\n';
+}
+
+/*******************************************************************************
+ * Serves the requests until the end of the input stream.
+ */
+void
+serve(Session& session, int inputFd, int outputFd)
+{
+	RequestReader reader(inputFd);
+	std::string line;
+	std::string text;
+	std::vector<char> audio;
+	for (;;) {
+		Request request;
+		try {
+			if (!reader.readLine(line)) return;
+			if (line.empty()) continue;
+			parseRequestHeader(line, request);
+		} catch (std::exception& e) {
+			// The stream is out of sync.
+			writeString(outputFd, errorLine(e));
+			return;
+		}
+		if (!reader.readData(text, request.length)) return;
+		std::replace(text.begin(), text.end(), '\n', ' ');
+		std::replace(text.begin(), text.end(), '\r', ' ');
+
+		std::string responseHeader;
+		try {
+			unsigned int outputRate, channels;
+			session.synthesize(request, text, audio, outputRate, channels);
+
+			std::ostringstream out;
+			out << "OK format=" << (request.format == FORMAT_WAV ? "wav" : "pcm")
+				<< " rate=" << outputRate << " channels=" << channels
+				<< " length=" << audio.size() << '\n';
+			responseHeader = out.str();
+		} catch (std::exception& e) {
+			if (GS::Log::debugEnabled) {
+				std::lock_guard<std::mutex> lock(logMutex);
+				std::cerr << "Caught an exception: " << e.what() << std::endl;
+			}
+			if (!writeString(outputFd, errorLine(e))) return;
+			continue;
+		}
+		if (!writeString(outputFd, responseHeader)) return;
+		if (!audio.empty() && !writeAll(outputFd, &audio[0], audio.size())) return;
+	}
+}
+
+#ifndef _WIN32
+/*******************************************************************************
+ * Each thread has its own session, and accepts connections from the shared socket.
+ */
+int
+serveSocket(const char* configDirPath, const GS::TRMControlModel::Model& model, VoiceCache& voiceCache,
+		const char* socketPath, unsigned int numThreads)
+{
+	struct sockaddr_un address;
+	if (std::strlen(socketPath) >= sizeof address.sun_path) {
+		std::cerr << "Socket path too long: " << socketPath << std::endl;
+		return 1;
+	}
+	std::memset(&address, 0, sizeof address);
+	address.sun_family = AF_UNIX;
+	std::strcpy(address.sun_path, socketPath);
+
+	int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd == -1) {
+		std::cerr << "Could not create the socket: " << std::strerror(errno) << std::endl;
+		return 1;
+	}
+	unlink(socketPath);
+	if (bind(listenFd, reinterpret_cast<struct sockaddr*>(&address), sizeof address) == -1 ||
+			listen(listenFd, SOMAXCONN) == -1) {
+		std::cerr << "Could not listen on the socket " << socketPath << ": " << std::strerror(errno) << std::endl;
+		close(listenFd);
+		return 1;
+	}
+
+	std::vector<std::unique_ptr<Session>> sessionList;
+	for (unsigned int i = 0; i < numThreads; ++i) {
+		sessionList.push_back(std::unique_ptr<Session>(new Session(configDirPath, model, voiceCache)));
+	}
+
+	auto worker = [&](Session& session) {
+		for (;;) {
+			int fd = accept(listenFd, nullptr, nullptr);
+			if (fd == -1) {
+				if (errno == EINTR || errno == ECONNABORTED) continue;
+				std::lock_guard<std::mutex> lock(logMutex);
+				std::cerr << "Could not accept a connection: " << std::strerror(errno) << std::endl;
+				return;
+			}
+			serve(session, fd, fd);
+			close(fd);
+		}
+	};
+
+	if (GS::Log::debugEnabled) {
+		std::cerr << "Listening on " << socketPath << std::endl;
+	}
+
+	std::vector<std::thread> threadList;
+	for (unsigned int i = 1; i < numThreads; ++i) {
+		threadList.push_back(std::thread(worker, std::ref(*sessionList[i])));
+	}
+	worker(*sessionList[0]);
+	for (std::thread& t : threadList) {
+		t.join();
+	}
+
+	close(listenFd);
+	return 1;
+}
+#endif
+
+} /* namespace */
+
+
+
+void
+showUsage(const char* programName)
+{
+	std::cout << "\nGnuspeechSA " << PROGRAM_VERSION << "\n\n";
+	std::cout << "Usage:\n\n";
+	std::cout << programName << " --version\n";
+	std::cout << "        Shows the program version.\n\n";
+#ifndef _WIN32
+	std::cout << programName << " [-v] -c config_dir -s socket_path [-j num_threads]\n";
+	std::cout << "        Serves synthesis requests on a Unix domain socket.\n";
+	std::cout << "        -v : verbose (to stderr)\n";
+	std::cout << "        -j : number of connections served in parallel (default: number of processors)\n\n";
+#endif
+	std::cout << programName << " [-v] -c config_dir --stdio\n";
+	std::cout << "        Serves synthesis requests from stdin, and sends the responses to stdout.\n";
+	std::cout << "        -v : verbose (to stderr)\n\n";
+	std::cout << "Request:\n";
+	std::cout << "        SYNTHESIZE length=n [format=wav|pcm] [voice=name] [tempo=x] [pitch=x]\\n\n";
+	std::cout << "        followed by n bytes of text.\n";
+	std::cout << "Response:\n";
+	std::cout << "        OK format=wav|pcm rate=Hz channels=n length=n\\n followed by n bytes of audio\n";
+	std::cout << "        or ERROR message\\n" << std::endl;
+}
+
+int
+main(int argc, char* argv[])
+{
+	if (argc < 2) {
+		showUsage(argv[0]);
+		return 1;
+	}
+
+	const char* configDirPath = nullptr;
+	const char* socketPath = nullptr;
+	bool useStdio = false;
+	unsigned int numThreads = 0;
+
+	int i = 1;
+	while (i < argc) {
+		if (strcmp(argv[i], "-v") == 0) {
+			++i;
+			GS::Log::debugEnabled = true;
+		} else if (strcmp(argv[i], "-c") == 0) {
+			++i;
+			if (i == argc) {
+				showUsage(argv[0]);
+				return 1;
+			}
+			configDirPath = argv[i];
+			++i;
+#ifndef _WIN32
+		} else if (strcmp(argv[i], "-s") == 0) {
+			++i;
+			if (i == argc) {
+				showUsage(argv[0]);
+				return 1;
+			}
+			socketPath = argv[i];
+			++i;
+		} else if (strcmp(argv[i], "-j") == 0) {
+			++i;
+			if (i == argc) {
+				showUsage(argv[0]);
+				return 1;
+			}
+			numThreads = std::atoi(argv[i]);
+			if (numThreads == 0) {
+				showUsage(argv[0]);
+				return 1;
+			}
+			++i;
+#endif
+		} else if (strcmp(argv[i], "--stdio") == 0) {
+			++i;
+			useStdio = true;
+		} else if (strcmp(argv[i], "--version") == 0) {
+			++i;
+			showUsage(argv[0]);
+			return 0;
+		} else {
+			showUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (configDirPath == nullptr || (socketPath == nullptr) == !useStdio) {
+		showUsage(argv[0]);
+		return 1;
+	}
+
+	int outputFd = 1;
+	if (useStdio) {
+		// The library writes the debug messages to stdout.
+		// The responses are sent to a copy of stdout, and stdout is redirected to stderr.
+		std::cout.flush();
+#ifdef _WIN32
+		outputFd = _dup(1);
+		_dup2(2, 1);
+#else
+		outputFd = dup(1);
+		dup2(2, 1);
+#endif
+		if (outputFd == -1) {
+			std::cerr << "Could not duplicate stdout." << std::endl;
+			return 1;
+		}
+	}
+#ifndef _WIN32
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	try {
+		GS::TRMControlModel::Model trmControlModel;
+		trmControlModel.load(configDirPath, TRM_CONTROL_MODEL_CONFIG_FILE);
+
+		VoiceCache voiceCache(configDirPath);
+
+		if (useStdio) {
+			Session session(configDirPath, trmControlModel, voiceCache);
+			serve(session, 0, outputFd);
+			return 0;
+		}
+#ifndef _WIN32
+		if (numThreads == 0) {
+			numThreads = std::max(1U, std::thread::hardware_concurrency());
+		}
+		return serveSocket(configDirPath, trmControlModel, voiceCache, socketPath, numThreads);
+#endif
+	} catch (std::exception& e) {
+		std::cerr << "Caught an exception: " << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Caught an unknown exception." << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -15,13 +15,24 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
  ***************************************************************************/
 
+#include <algorithm> /* max, min */
+#include <atomic>
+#include <cstdlib> /* atoi */
 #include <cstring>
 #include <exception>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <utility> /* pair */
+#include <vector>
+
+#ifndef _WIN32
+# include <dirent.h>
+#endif
 
 #include "Controller.h"
 #include "Exception.h"
@@ -31,6 +42,11 @@
 #include "en/phonetic_string_parser/PhoneticStringParser.h"
 #include "en/text_parser/TextParser.h"
 #include "TRMControlModelConfiguration.h"
+#include "Tube.h"
+
+
+
+typedef std::pair<std::string, std::string> BatchItem; // id, text
 
 
 
@@ -41,12 +57,163 @@ showUsage(const char* programName)
 	std::cout << "Usage:\n\n";
 	std::cout << programName << " --version\n";
 	std::cout << "        Shows the program version.\n\n";
-	std::cout << programName << " [-v] -c config_dir -p trm_param_file.txt -o output_file.wav \"Hello world.\"\n";
+	std::cout << programName << " [-v] -c config_dir [-p trm_param_file.txt] -o output_file.wav \"Hello world.\"\n";
 	std::cout << "        Synthesizes text from the command line.\n";
-	std::cout << "        -v : verbose\n\n";
-	std::cout << programName << " [-v] -c config_dir -i input_text.txt -p trm_param_file.txt -o output_file.wav\n";
+	std::cout << "        -v : verbose\n";
+	std::cout << "        -p : also write the TRM parameters to a file\n\n";
+	std::cout << programName << " [-v] -c config_dir -i input_text.txt [-p trm_param_file.txt] -o output_file.wav [-j num_threads]\n";
 	std::cout << "        Synthesizes text from a file.\n";
-	std::cout << "        -v : verbose\n" << std::endl;
+	std::cout << "        -v : verbose\n";
+	std::cout << "        -p : also write the TRM parameters to a file\n";
+	std::cout << "        -j : synthesize the chunks of the text in parallel, using this number of threads\n";
+	std::cout << "             (default: 1). The output is not identical.\n\n";
+	std::cout << programName << " [-v] -c config_dir -b manifest.txt|input_dir -d output_dir [-j num_threads]\n";
+	std::cout << "        Synthesizes a batch of texts. Each line of the manifest contains \"id<TAB>text\".\n";
+	std::cout << "        If a directory is given, each .txt file is synthesized, and its name\n";
+	std::cout << "        without the extension is the id. The output files are output_dir/id.wav.\n";
+	std::cout << "        -v : verbose\n";
+	std::cout << "        -j : number of threads (default: number of processors)\n" << std::endl;
+}
+
+std::string
+readTextFile(const std::string& filePath)
+{
+	std::ifstream in(filePath.c_str(), std::ios_base::in | std::ios_base::binary);
+	if (!in) {
+		THROW_EXCEPTION(GS::IOException, "Could not open the file " << filePath << '.');
+	}
+	std::ostringstream textStream;
+	std::string line;
+	while (std::getline(in, line)) {
+		textStream << line << ' ';
+	}
+	return textStream.str();
+}
+
+void
+readBatchManifest(const char* manifestFile, std::vector<BatchItem>& itemList)
+{
+	std::ifstream in(manifestFile, std::ios_base::in | std::ios_base::binary);
+	if (!in) {
+		THROW_EXCEPTION(GS::IOException, "Could not open the file " << manifestFile << '.');
+	}
+	std::string line;
+	unsigned int lineNumber = 0;
+	while (std::getline(in, line)) {
+		++lineNumber;
+		if (!line.empty() && line[line.size() - 1] == '\r') {
+			line.resize(line.size() - 1);
+		}
+		if (line.empty()) continue;
+
+		std::size_t tabPos = line.find('\t');
+		if (tabPos == 0 || tabPos == std::string::npos) {
+			THROW_EXCEPTION(GS::ParsingException, "Invalid line in the manifest " << manifestFile << ": " << lineNumber << '.');
+		}
+		itemList.push_back(BatchItem(line.substr(0, tabPos), line.substr(tabPos + 1)));
+	}
+}
+
+/*******************************************************************************
+ * batchInput is a manifest file or a directory containing .txt files.
+ */
+void
+readBatchInput(const char* batchInput, std::vector<BatchItem>& itemList)
+{
+#ifdef _WIN32
+	readBatchManifest(batchInput, itemList);
+#else
+	DIR* dir = opendir(batchInput);
+	if (dir == nullptr) {
+		readBatchManifest(batchInput, itemList);
+		return;
+	}
+	std::vector<std::string> nameList;
+	while (struct dirent* entry = readdir(dir)) {
+		std::string name = entry->d_name;
+		if (name.size() > 4 && name.compare(name.size() - 4, 4, ".txt") == 0) {
+			nameList.push_back(name);
+		}
+	}
+	closedir(dir);
+
+	std::sort(nameList.begin(), nameList.end());
+	for (const std::string& name : nameList) {
+		itemList.push_back(BatchItem(name.substr(0, name.size() - 4), readTextFile(std::string(batchInput) + '/' + name)));
+	}
+#endif
+}
+
+/*******************************************************************************
+ * Synthesizes the items using a pool of threads. Each thread has its own
+ * Controller and parsers, and all of them share the same model.
+ *
+ * Returns the number of failed items.
+ */
+unsigned int
+synthesizeBatch(const char* configDirPath, const GS::TRMControlModel::Model& model,
+		const std::vector<BatchItem>& itemList, const char* outputDir, unsigned int numThreads)
+{
+	std::atomic<std::size_t> nextItem(0);
+	std::atomic<unsigned int> numFailures(0);
+	std::mutex logMutex;
+
+	numThreads = std::max(1U, std::min<unsigned int>(numThreads, itemList.size()));
+
+	auto worker = [&]() {
+		std::unique_ptr<GS::TRMControlModel::Controller> trmController;
+		std::unique_ptr<GS::En::TextParser> textParser;
+		std::unique_ptr<GS::En::PhoneticStringParser> phoneticStringParser;
+		try {
+			trmController.reset(new GS::TRMControlModel::Controller(configDirPath, model));
+			const GS::TRMControlModel::Configuration& trmControlConfig = trmController->trmControlModelConfiguration();
+			textParser.reset(new GS::En::TextParser(configDirPath,
+								trmControlConfig.dictionary1File,
+								trmControlConfig.dictionary2File,
+								trmControlConfig.dictionary3File));
+			phoneticStringParser.reset(new GS::En::PhoneticStringParser(configDirPath, *trmController));
+		} catch (std::exception& e) {
+			std::lock_guard<std::mutex> lock(logMutex);
+			std::cerr << "Caught an exception: " << e.what() << std::endl;
+			return;
+		}
+
+		GS::TRM::Tube tube;
+		GS::TRM::ControlFrameBuffer frameBuffer;
+		for (std::size_t i = nextItem++; i < itemList.size(); i = nextItem++) {
+			const BatchItem& item = itemList[i];
+			std::string outputFile = std::string(outputDir) + '/' + item.first + ".wav";
+			try {
+				std::string phoneticString = textParser->parseText(item.second.c_str());
+				trmController->synthesizePhoneticString(*phoneticStringParser, phoneticString.c_str(), frameBuffer);
+				tube.synthesizeToFile(frameBuffer, outputFile.c_str());
+				if (GS::Log::debugEnabled) {
+					std::lock_guard<std::mutex> lock(logMutex);
+					std::cout << "Wrote " << outputFile << std::endl;
+				}
+			} catch (std::exception& e) {
+				++numFailures;
+				std::lock_guard<std::mutex> lock(logMutex);
+				std::cerr << "[" << item.first << "] Caught an exception: " << e.what() << std::endl;
+			}
+		}
+	};
+
+	std::vector<std::thread> threadList;
+	for (unsigned int i = 1; i < numThreads; ++i) {
+		threadList.push_back(std::thread(worker));
+	}
+	worker();
+	for (std::thread& t : threadList) {
+		t.join();
+	}
+
+	// If all the threads have failed to initialize, some items may not have been processed.
+	if (nextItem < itemList.size()) {
+		numFailures += itemList.size() - nextItem;
+	}
+
+	return numFailures;
 }
 
 int
@@ -61,6 +228,9 @@ main(int argc, char* argv[])
 	const char* inputFile = nullptr;
 	const char* outputFile = nullptr;
 	const char* trmParamFile = nullptr;
+	const char* batchInput = nullptr;
+	const char* outputDir = nullptr;
+	unsigned int numThreads = 0;
 	std::ostringstream inputTextStream;
 
 	int i = 1;
@@ -92,6 +262,34 @@ main(int argc, char* argv[])
 			}
 			trmParamFile = argv[i];
 			++i;
+		} else if (strcmp(argv[i], "-b") == 0) {
+			++i;
+			if (i == argc) {
+				showUsage(argv[0]);
+				return 1;
+			}
+			batchInput = argv[i];
+			++i;
+		} else if (strcmp(argv[i], "-d") == 0) {
+			++i;
+			if (i == argc) {
+				showUsage(argv[0]);
+				return 1;
+			}
+			outputDir = argv[i];
+			++i;
+		} else if (strcmp(argv[i], "-j") == 0) {
+			++i;
+			if (i == argc) {
+				showUsage(argv[0]);
+				return 1;
+			}
+			numThreads = std::atoi(argv[i]);
+			if (numThreads == 0) {
+				showUsage(argv[0]);
+				return 1;
+			}
+			++i;
 		} else if (strcmp(argv[i], "-o") == 0) {
 			++i;
 			if (i == argc) {
@@ -111,7 +309,35 @@ main(int argc, char* argv[])
 		}
 	}
 
-	if (configDirPath == nullptr || trmParamFile == nullptr || outputFile == nullptr) {
+	if (batchInput != nullptr) {
+		if (configDirPath == nullptr || outputDir == nullptr) {
+			showUsage(argv[0]);
+			return 1;
+		}
+		if (numThreads == 0) {
+			numThreads = std::max(1U, std::thread::hardware_concurrency());
+		}
+
+		try {
+			std::vector<BatchItem> itemList;
+			readBatchInput(batchInput, itemList);
+			if (itemList.empty()) {
+				std::cerr << "Empty batch input." << std::endl;
+				return 1;
+			}
+
+			GS::TRMControlModel::Model trmControlModel;
+			trmControlModel.load(configDirPath, TRM_CONTROL_MODEL_CONFIG_FILE);
+
+			unsigned int numFailures = synthesizeBatch(configDirPath, trmControlModel, itemList, outputDir, numThreads);
+			return numFailures == 0 ? 0 : 1;
+		} catch (std::exception& e) {
+			std::cerr << "Caught an exception: " << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	if (configDirPath == nullptr || outputFile == nullptr) {
 		showUsage(argv[0]);
 		return 1;
 	}
@@ -145,6 +371,9 @@ main(int argc, char* argv[])
 
 		std::unique_ptr<GS::TRMControlModel::Controller> trmController(new GS::TRMControlModel::Controller(configDirPath, *trmControlModel));
 		const GS::TRMControlModel::Configuration& trmControlConfig = trmController->trmControlModelConfiguration();
+		if (numThreads > 1) {
+			trmController->setSynthesisThreads(numThreads);
+		}
 
 		std::unique_ptr<GS::En::TextParser> textParser(new GS::En::TextParser(configDirPath,
 											trmControlConfig.dictionary1File,
@@ -22,12 +22,15 @@
 
 #include <cmath>
 
+#include "FastMath.h"
+
 
 
 namespace GS {
 namespace TRM {
 
-BandpassFilter::BandpassFilter()
+template<typename FloatType>
+BandpassFilter<FloatType>::BandpassFilter()
 		: bpAlpha_(0.0)
 		, bpBeta_(0.0)
 		, bpGamma_(0.0)
@@ -38,12 +41,14 @@ BandpassFilter::BandpassFilter()
 {
 }
 
-BandpassFilter::~BandpassFilter()
+template<typename FloatType>
+BandpassFilter<FloatType>::~BandpassFilter()
 {
 }
 
+template<typename FloatType>
 void
-BandpassFilter::reset()
+BandpassFilter<FloatType>::reset()
 {
 	xn1_ = 0.0;
 	xn2_ = 0.0;
@@ -51,14 +56,34 @@ BandpassFilter::reset()
 	yn2_ = 0.0;
 }
 
+template<typename FloatType>
+void
+BandpassFilter<FloatType>::update(double sampleRate, double bandwidth, double centerFreq)
+{
+	double tanValue = FastMath::tan((M_PI * bandwidth) / sampleRate);
+	double cosValue = FastMath::cos((2.0 * M_PI * centerFreq) / sampleRate);
+	double beta = (1.0 - tanValue) / (2.0 * (1.0 + tanValue));
+	bpBeta_ = static_cast<FloatType>(beta);
+	bpGamma_ = static_cast<FloatType>((0.5 + beta) * cosValue);
+	bpAlpha_ = static_cast<FloatType>((0.5 - beta) / 2.0);
+}
+
+template<typename FloatType>
 void
-BandpassFilter::update(double sampleRate, double bandwidth, double centerFreq)
+BandpassFilter<FloatType>::getCoefficients(double* coef) const
 {
-	double tanValue = tan((M_PI * bandwidth) / sampleRate);
-	double cosValue = cos((2.0 * M_PI * centerFreq) / sampleRate);
-	bpBeta_ = (1.0 - tanValue) / (2.0 * (1.0 + tanValue));
-	bpGamma_ = (0.5 + bpBeta_) * cosValue;
-	bpAlpha_ = (0.5 - bpBeta_) / 2.0;
+	coef[0] = bpAlpha_;
+	coef[1] = bpBeta_;
+	coef[2] = bpGamma_;
+}
+
+template<typename FloatType>
+void
+BandpassFilter<FloatType>::setCoefficients(const double* coef)
+{
+	bpAlpha_ = static_cast<FloatType>(coef[0]);
+	bpBeta_  = static_cast<FloatType>(coef[1]);
+	bpGamma_ = static_cast<FloatType>(coef[2]);
 }
 
 /******************************************************************************
@@ -69,10 +94,11 @@ BandpassFilter::update(double sampleRate, double bandwidth, double centerFreq)
 *             frequency and bandwidth.
 *
 ******************************************************************************/
-double
-BandpassFilter::filter(double input)
+template<typename FloatType>
+FloatType
+BandpassFilter<FloatType>::filter(FloatType input)
 {
-	double output = 2.0 * ((bpAlpha_ * (input - xn2_)) + (bpGamma_ * yn1_) - (bpBeta_ * yn2_));
+	FloatType output = static_cast<FloatType>(2.0) * ((bpAlpha_ * (input - xn2_)) + (bpGamma_ * yn1_) - (bpBeta_ * yn2_));
 
 	xn2_ = xn1_;
 	xn1_ = input;
@@ -82,5 +108,9 @@ BandpassFilter::filter(double input)
 	return output;
 }
 
+// Explicit instantiation.
+template class BandpassFilter<float>;
+template class BandpassFilter<double>;
+
 } /* namespace TRM */
 } /* namespace GS */
@@ -26,6 +26,7 @@
 namespace GS {
 namespace TRM {
 
+template<typename FloatType>
 class BandpassFilter {
 public:
 	BandpassFilter();
@@ -33,18 +34,21 @@ public:
 
 	void reset();
 	void update(double sampleRate, double bandwidth, double centerFreq);
-	double filter(double input);
+	// coef must point to 3 elements.
+	void getCoefficients(double* coef) const;
+	void setCoefficients(const double* coef);
+	FloatType filter(FloatType input);
 private:
 	BandpassFilter(const BandpassFilter&) = delete;
 	BandpassFilter& operator=(const BandpassFilter&) = delete;
 
-	double bpAlpha_;
-	double bpBeta_;
-	double bpGamma_;
-	double xn1_;
-	double xn2_;
-	double yn1_;
-	double yn2_;
+	FloatType bpAlpha_;
+	FloatType bpBeta_;
+	FloatType bpGamma_;
+	FloatType xn1_;
+	FloatType xn2_;
+	FloatType yn1_;
+	FloatType yn2_;
 };
 
 } /* namespace TRM */
@@ -0,0 +1,225 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+#include "ControlFrameBuffer.h"
+
+#include <sstream>
+#include <string>
+
+#include "Exception.h"
+#include "Text.h"
+
+
+
+namespace {
+
+template<typename T>
+void
+readHeaderValue(std::istream& in, T& value, const char* name)
+{
+	std::string line;
+	if (!std::getline(in, line)) {
+		THROW_EXCEPTION(GS::TRMException, "Error in tube input parsing: Could not read " << name << '.');
+	}
+	value = GS::Text::parseString<T>(line);
+}
+
+} /* namespace */
+
+namespace GS {
+namespace TRM {
+
+ControlFrameBuffer::Header::Header()
+		: outputRate(0.0)
+		, controlRate(0.0)
+		, volume(0.0)
+		, channels(0)
+		, balance(0.0)
+		, waveform(0)
+		, tp(0.0)
+		, tnMin(0.0)
+		, tnMax(0.0)
+		, breathiness(0.0)
+		, length(0.0)
+		, temperature(0.0)
+		, lossFactor(0.0)
+		, apertureRadius(0.0)
+		, mouthCoef(0.0)
+		, noseCoef(0.0)
+		, noseRadius()
+		, throatCutoff(0.0)
+		, throatVol(0.0)
+		, modulation(0)
+		, mixOffset(0.0)
+		, coefficientUpdatePeriod(1)
+		, sampleRateConverterQuality(1) /*  SampleRateConverterBase::QUALITY_DEFAULT  */
+		, glottalSourceOscillator(0)    /*  WavetableGlottalSourceBase::OSCILLATOR_OVERSAMPLING  */
+{
+}
+
+ControlFrameBuffer::ControlFrameBuffer()
+{
+}
+
+ControlFrameBuffer::~ControlFrameBuffer()
+{
+}
+
+void
+ControlFrameBuffer::reserve(std::size_t numFrames)
+{
+	for (int i = 0; i < NUM_PARAMETERS; ++i) {
+		param_[i].reserve(numFrames);
+	}
+}
+
+/*******************************************************************************
+ * Removes the frames. The header is not changed.
+ */
+void
+ControlFrameBuffer::clear()
+{
+	for (int i = 0; i < NUM_PARAMETERS; ++i) {
+		param_[i].clear();
+	}
+}
+
+void
+ControlFrameBuffer::addFrame(const float* values)
+{
+	for (int i = 0; i < NUM_PARAMETERS; ++i) {
+		param_[i].push_back(values[i]);
+	}
+}
+
+std::size_t
+ControlFrameBuffer::addFrames(std::size_t numFrames)
+{
+	const std::size_t firstFrame = size();
+	for (int i = 0; i < NUM_PARAMETERS; ++i) {
+		param_[i].resize(firstFrame + numFrames);
+	}
+	return firstFrame;
+}
+
+void
+ControlFrameBuffer::addFrames(const ControlFrameBuffer& other)
+{
+	for (int i = 0; i < NUM_PARAMETERS; ++i) {
+		param_[i].insert(param_[i].end(), other.param_[i].begin(), other.param_[i].end());
+	}
+}
+
+void
+ControlFrameBuffer::read(std::istream& in)
+{
+	readHeaderValue(in, header_.outputRate    , "output sample rate");
+	readHeaderValue(in, header_.controlRate   , "input control rate");
+	readHeaderValue(in, header_.volume        , "master volume");
+	readHeaderValue(in, header_.channels      , "number of sound output channels");
+	readHeaderValue(in, header_.balance       , "stereo balance");
+	readHeaderValue(in, header_.waveform      , "glottal source waveform type");
+	readHeaderValue(in, header_.tp            , "glottal pulse rise time (tp)");
+	readHeaderValue(in, header_.tnMin         , "glottal pulse fall time minimum (tnMin)");
+	readHeaderValue(in, header_.tnMax         , "glottal pulse fall time maximum (tnMax)");
+	readHeaderValue(in, header_.breathiness   , "glottal source breathiness");
+	readHeaderValue(in, header_.length        , "nominal tube length");
+	readHeaderValue(in, header_.temperature   , "tube temperature");
+	readHeaderValue(in, header_.lossFactor    , "junction loss factor");
+	readHeaderValue(in, header_.apertureRadius, "aperture scaling radius");
+	readHeaderValue(in, header_.mouthCoef     , "mouth aperture coefficient");
+	readHeaderValue(in, header_.noseCoef      , "nose aperture coefficient");
+	header_.noseRadius[0] = 0.0;
+	for (int i = 1; i < NUM_NOSE_SECTIONS; ++i) {
+		std::ostringstream name;
+		name << "nose radius " << i;
+		readHeaderValue(in, header_.noseRadius[i], name.str().c_str());
+	}
+	readHeaderValue(in, header_.throatCutoff  , "throat lowpass filter cutoff");
+	readHeaderValue(in, header_.throatVol     , "throat volume");
+	readHeaderValue(in, header_.modulation    , "pulse modulation of noise flag");
+	readHeaderValue(in, header_.mixOffset     , "noise crossmix offset");
+
+	clear();
+
+	std::string line;
+	float values[NUM_PARAMETERS];
+	unsigned int paramNumber = 0;
+	while (std::getline(in, line)) {
+		std::istringstream lineStream(line);
+		for (int i = 0; i < NUM_PARAMETERS; ++i) {
+			lineStream >> values[i];
+		}
+		if (!lineStream) {
+			THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read parameters (number " << paramNumber << ").");
+		}
+		addFrame(values);
+		++paramNumber;
+	}
+}
+
+void
+ControlFrameBuffer::write(std::ostream& out) const
+{
+	writeHeader(out);
+	writeFrames(out);
+}
+
+void
+ControlFrameBuffer::writeHeader(std::ostream& out) const
+{
+	out <<
+		header_.outputRate     << '\n' <<
+		header_.controlRate    << '\n' <<
+		header_.volume         << '\n' <<
+		header_.channels       << '\n' <<
+		header_.balance        << '\n' <<
+		header_.waveform       << '\n' <<
+		header_.tp             << '\n' <<
+		header_.tnMin          << '\n' <<
+		header_.tnMax          << '\n' <<
+		header_.breathiness    << '\n' <<
+		header_.length         << '\n' <<
+		header_.temperature    << '\n' <<
+		header_.lossFactor     << '\n' <<
+		header_.apertureRadius << '\n' <<
+		header_.mouthCoef      << '\n' <<
+		header_.noseCoef       << '\n';
+	for (int i = 1; i < NUM_NOSE_SECTIONS; ++i) {
+		out << header_.noseRadius[i] << '\n';
+	}
+	out <<
+		header_.throatCutoff   << '\n' <<
+		header_.throatVol      << '\n' <<
+		header_.modulation     << '\n' <<
+		header_.mixOffset      << '\n';
+}
+
+void
+ControlFrameBuffer::writeFrames(std::ostream& out, std::size_t firstFrame) const
+{
+	for (std::size_t i = firstFrame, numFrames = size(); i < numFrames; ++i) {
+		out << param_[0][i];
+		for (int j = 1; j < NUM_PARAMETERS; ++j) {
+			out << ' ' << param_[j][i];
+		}
+		out << '\n';
+	}
+}
+
+} /* namespace TRM */
+} /* namespace GS */
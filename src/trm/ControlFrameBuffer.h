@@ -0,0 +1,110 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+#ifndef TRM_CONTROL_FRAME_BUFFER_H_
+#define TRM_CONTROL_FRAME_BUFFER_H_
+
+#include <cstddef> /* std::size_t */
+#include <istream>
+#include <ostream>
+#include <vector>
+
+
+
+namespace GS {
+namespace TRM {
+
+/*******************************************************************************
+ * Input of the Tube: the utterance parameters (the header of a
+ * trm_param file) and the sequence of control-rate parameter frames.
+ *
+ * The frames are stored as a struct of arrays, one array per parameter,
+ * in the order of Tube::ParameterIndex.
+ */
+class ControlFrameBuffer {
+public:
+	enum {
+		NUM_PARAMETERS = 16,
+		NUM_NOSE_SECTIONS = 6
+	};
+
+	struct Header {
+		Header();
+
+		float  outputRate;                   /*  output sample rate (Hz)  */
+		float  controlRate;                  /*  1.0-1000.0 input tables/second (Hz)  */
+		double volume;                       /*  master volume (0 - 60 dB)  */
+		int    channels;                     /*  # of sound output channels (1, 2)  */
+		double balance;                      /*  stereo balance (-1 to +1)  */
+		int    waveform;                     /*  GS waveform type (0=PULSE, 1=SINE  */
+		double tp;                           /*  % glottal pulse rise time  */
+		double tnMin;                        /*  % glottal pulse fall time minimum  */
+		double tnMax;                        /*  % glottal pulse fall time maximum  */
+		double breathiness;                  /*  % glottal source breathiness  */
+		double length;                       /*  nominal tube length (10 - 20 cm)  */
+		double temperature;                  /*  tube temperature (25 - 40 C)  */
+		double lossFactor;                   /*  junction loss factor in (0 - 5 %)  */
+		double apertureRadius;               /*  aperture scl. radius (3.05 - 12 cm)  */
+		double mouthCoef;                    /*  mouth aperture coefficient  */
+		double noseCoef;                     /*  nose aperture coefficient  */
+		double noseRadius[NUM_NOSE_SECTIONS]; /*  fixed nose radii (0 - 3 cm), [0] is not used  */
+		double throatCutoff;                 /*  throat lp cutoff (50 - nyquist Hz)  */
+		double throatVol;                    /*  throat volume (0 - 48 dB) */
+		int    modulation;                   /*  pulse mod. of noise (0=OFF, 1=ON)  */
+		double mixOffset;                    /*  noise crossmix offset (30 - 60 dB)  */
+		// Not stored in the trm_param files.
+		int    coefficientUpdatePeriod;      /*  samples between updates of the coefficients (1 = every sample)  */
+		int    sampleRateConverterQuality;   /*  SampleRateConverterBase::Quality  */
+		int    glottalSourceOscillator;      /*  WavetableGlottalSourceBase::Oscillator  */
+	};
+
+	ControlFrameBuffer();
+	~ControlFrameBuffer();
+
+	Header& header() { return header_; }
+	const Header& header() const { return header_; }
+
+	std::size_t size() const { return param_[0].size(); }
+	bool empty() const { return param_[0].empty(); }
+	void reserve(std::size_t numFrames);
+	void clear();
+
+	// values must point to NUM_PARAMETERS elements.
+	void addFrame(const float* values);
+	// Appends numFrames frames with zero values, to be filled through
+	// parameterData. Returns the index of the first new frame.
+	std::size_t addFrames(std::size_t numFrames);
+	// Appends the frames of another buffer. The header is not changed.
+	void addFrames(const ControlFrameBuffer& other);
+	float value(int parameter, std::size_t frame) const { return param_[parameter][frame]; }
+	const std::vector<float>& parameter(int parameter) const { return param_[parameter]; }
+	float* parameterData(int parameter) { return param_[parameter].data(); }
+
+	// Text format of the trm_param files.
+	void read(std::istream& in);
+	void write(std::ostream& out) const;
+	void writeHeader(std::ostream& out) const;
+	void writeFrames(std::ostream& out, std::size_t firstFrame = 0) const;
+private:
+	Header header_;
+	std::vector<float> param_[NUM_PARAMETERS];
+};
+
+} /* namespace TRM */
+} /* namespace GS */
+
+#endif /* TRM_CONTROL_FRAME_BUFFER_H_ */
@@ -23,6 +23,7 @@
 #include <cmath>
 
 #include "Exception.h"
+#include "Simd.h"
 
 #define LIMIT 200
 
@@ -30,8 +31,8 @@
 
 namespace GS {
 namespace TRM {
-
-FIRFilter::FIRFilter(double beta, double gamma, double cutoff)
+template<typename FloatType>
+FIRFilter<FloatType>::FIRFilter(double beta, double gamma, double cutoff)
 {
 	int pointer, increment, numberCoefficients;
 	double coefficient[LIMIT + 1];
@@ -46,14 +47,18 @@ FIRFilter::FIRFilter(double beta, double gamma, double cutoff)
 	numberTaps_ = (numberCoefficients * 2) - 1;
 
 	/*  ALLOCATE MEMORY FOR DATA AND COEFFICIENTS  */
-	data_.resize(numberTaps_);
-	coef_.resize(numberTaps_);
+	/*  THE NUMBER OF COEFFICIENTS IS ROUNDED UP TO THE BLOCK SIZE OF dotProduct, WITH ZEROS  */
+	/*  THE DATA ARE STORED TWICE, SO THAT THE TAPS ARE CONTIGUOUS  */
+	const int blockSize = DotProductBlock<FloatType>::SIZE;
+	const int paddedTaps = (numberTaps_ + blockSize - 1) / blockSize * blockSize;
+	data_.assign(numberTaps_ + paddedTaps, 0.0);
+	coef_.assign(paddedTaps, 0.0);
 
 	/*  INITIALIZE THE COEFFICIENTS  */
 	increment = -1;
 	pointer = numberCoefficients;
 	for (int i = 0; i < numberTaps_; i++) {
-		coef_[i] = coefficient[pointer];
+		coef_[i] = static_cast<FloatType>(coefficient[pointer]);
 		pointer += increment;
 		if (pointer <= 0) {
 			pointer = 2;
@@ -72,13 +77,14 @@ FIRFilter::FIRFilter(double beta, double gamma, double cutoff)
 	}
 #endif
 }
-
-FIRFilter::~FIRFilter()
+template<typename FloatType>
+FIRFilter<FloatType>::~FIRFilter()
 {
 }
 
+template<typename FloatType>
 void
-FIRFilter::reset()
+FIRFilter<FloatType>::reset()
 {
 	for (auto& item : data_) item = 0.0;
 	ptr_ = 0;
@@ -95,8 +101,9 @@ FIRFilter::reset()
 *             band.
 *
 ******************************************************************************/
+template<typename FloatType>
 int
-FIRFilter::maximallyFlat(double beta, double gamma, int* np, double* coefficient)
+FIRFilter<FloatType>::maximallyFlat(double beta, double gamma, int* np, double* coefficient)
 {
 	double a[LIMIT + 1], c[LIMIT + 1], betaMinimum, ac;
 	int nt, numerator, n, ll, i;
@@ -187,8 +194,9 @@ FIRFilter::maximallyFlat(double beta, double gamma, int* np, double* coefficient
 *             which fall below the cutoff value.
 *
 ******************************************************************************/
+template<typename FloatType>
 void
-FIRFilter::trim(double cutoff, int* numberCoefficients, double* coefficient)
+FIRFilter<FloatType>::trim(double cutoff, int* numberCoefficients, double* coefficient)
 {
 	for (int i = *numberCoefficients; i > 0; i--) {
 		if (fabs(coefficient[i]) >= fabs(cutoff)) {
@@ -198,24 +206,6 @@ FIRFilter::trim(double cutoff, int* numberCoefficients, double* coefficient)
 	}
 }
 
-/******************************************************************************
-*
-*  function:  increment
-*
-*  purpose:   Increments the pointer to the circular FIR filter
-*             buffer, keeping it in the range 0 -> modulus-1.
-*
-******************************************************************************/
-int
-FIRFilter::increment(int pointer, int modulus)
-{
-	if (++pointer >= modulus) {
-		return 0;
-	} else {
-		return pointer;
-	}
-}
-
 /******************************************************************************
 *
 *  function:  decrement
@@ -224,8 +214,9 @@ FIRFilter::increment(int pointer, int modulus)
 *             buffer, keeping it in the range 0 -> modulus-1.
 *
 ******************************************************************************/
+template<typename FloatType>
 int
-FIRFilter::decrement(int pointer, int modulus)
+FIRFilter<FloatType>::decrement(int pointer, int modulus)
 {
 	if (--pointer < 0) {
 		return modulus - 1;
@@ -234,36 +225,24 @@ FIRFilter::decrement(int pointer, int modulus)
 	}
 }
 
-double
-FIRFilter::filter(double input, int needOutput)
+template<typename FloatType>
+FloatType
+FIRFilter<FloatType>::filter(FloatType input, int needOutput)
 {
-	if (needOutput) {
-		int i;
-		double output = 0.0;
-
-		/*  PUT INPUT SAMPLE INTO DATA BUFFER  */
-		data_[ptr_] = input;
+	/*  PUT INPUT SAMPLE INTO DATA BUFFER, AND INTO ITS COPY  */
+	data_[ptr_] = input;
+	data_[ptr_ + numberTaps_] = input;
 
+	FloatType output = 0.0;
+	if (needOutput) {
 		/*  SUM THE OUTPUT FROM ALL FILTER TAPS  */
-		for (i = 0; i < numberTaps_; i++) {
-			output += data_[ptr_] * coef_[i];
-			ptr_ = increment(ptr_, numberTaps_);
-		}
-
-		/*  DECREMENT THE DATA POINTER READY FOR NEXT CALL  */
-		ptr_ = decrement(ptr_, numberTaps_);
-
-		/*  RETURN THE OUTPUT VALUE  */
-		return output;
-	} else {
-		/*  PUT INPUT SAMPLE INTO DATA BUFFER  */
-		data_[ptr_] = input;
+		output = dotProduct(&data_[ptr_], &coef_[0], static_cast<unsigned int>(coef_.size()));
+	}
 
-		/*  ADJUST THE DATA POINTER, READY FOR NEXT CALL  */
-		ptr_ = decrement(ptr_, numberTaps_);
+	/*  ADJUST THE DATA POINTER, READY FOR NEXT CALL  */
+	ptr_ = decrement(ptr_, numberTaps_);
 
-		return 0.0;
-	}
+	return output;
 }
 
 /******************************************************************************
@@ -274,8 +253,9 @@ FIRFilter::filter(double input, int needOutput)
 *             given the maximum 'order'.
 *
 ******************************************************************************/
+template<typename FloatType>
 void
-FIRFilter::rationalApproximation(double number, int* order, int* numerator, int* denominator)
+FIRFilter<FloatType>::rationalApproximation(double number, int* order, int* numerator, int* denominator)
 {
 	double fractionalPart, minimumError = 1.0;
 	int i, orderMaximum, modulus = 0;
@@ -323,5 +303,9 @@ FIRFilter::rationalApproximation(double number, int* order, int* numerator, int*
 	}
 }
 
+// Explicit instantiation.
+template class FIRFilter<float>;
+template class FIRFilter<double>;
+
 } /* namespace TRM */
 } /* namespace GS */
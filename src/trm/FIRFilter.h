@@ -34,27 +34,33 @@ namespace TRM {
 *
 *  purpose:  Is the linear phase, lowpass FIR filter.
 *
+*            The output is only calculated when needOutput is not
+*            zero, so the filter can be used as a decimator. The
+*            delay line is stored twice in data_, so the taps of
+*            each output are read from contiguous memory, and
+*            summed with SIMD instructions.
+*
 ******************************************************************************/
+template<typename FloatType>
 class FIRFilter {
 public:
 	FIRFilter(double beta, double gamma, double cutoff);
 	~FIRFilter();
 
 	void reset();
-	double filter(double input, int needOutput);
+	FloatType filter(FloatType input, int needOutput);
 private:
 	FIRFilter(const FIRFilter&) = delete;
 	FIRFilter& operator=(const FIRFilter&) = delete;
 
 	static int maximallyFlat(double beta, double gamma, int* np, double* coefficient);
 	static void trim(double cutoff, int* numberCoefficients, double* coefficient);
-	static int increment(int pointer, int modulus);
 	static int decrement(int pointer, int modulus);
 	static void rationalApproximation(double number, int* order, int* numerator, int* denominator);
 
-	std::vector<double> data_;
-	std::vector<double> coef_;
-	int ptr_;
+	std::vector<FloatType> data_;        /*  delay line, followed by its copy  */
+	std::vector<FloatType> coef_;        /*  padded with zeros to the block size of dotProduct  */
+	int ptr_;                            /*  position of the newest sample  */
 	int numberTaps_;
 };
 
@@ -0,0 +1,149 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+
+#ifndef TRM_FAST_MATH_H_
+#define TRM_FAST_MATH_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring> /* memcpy */
+
+// The transcendental functions used in the calculation of the tube
+// coefficients, which may be done in every sample.
+//
+// If GS_TRM_FAST_MATH is defined, the functions are approximated with
+// polynomials, valid in the domains used by the tube:
+//   exp2: |x| < 1000, relative error < 5e-10
+//   cos : absolute error < 1e-11 (fastest for 0 <= x <= pi)
+//   tan : 0 <= x < pi/2, relative error < 1e-10
+// Otherwise the functions of the standard library are used.
+
+
+
+namespace GS {
+namespace TRM {
+namespace FastMath {
+
+#ifdef GS_TRM_FAST_MATH
+
+namespace Detail {
+
+// sin(x) for 0 <= x <= pi/4 (Taylor series up to x^11).
+inline
+double
+sinQuarter(double x)
+{
+	const double x2 = x * x;
+	return x * (1.0 + x2 * (-1.0 / 6.0 + x2 * (1.0 / 120.0 + x2 * (-1.0 / 5040.0
+			+ x2 * (1.0 / 362880.0 + x2 * (-1.0 / 39916800.0))))));
+}
+
+// cos(x) for 0 <= x <= pi/4 (Taylor series up to x^12).
+inline
+double
+cosQuarter(double x)
+{
+	const double x2 = x * x;
+	return 1.0 + x2 * (-1.0 / 2.0 + x2 * (1.0 / 24.0 + x2 * (-1.0 / 720.0 + x2 * (1.0 / 40320.0
+			+ x2 * (-1.0 / 3628800.0 + x2 * (1.0 / 479001600.0))))));
+}
+
+} /* namespace Detail */
+
+// Returns 2^x.
+inline
+double
+exp2(double x)
+{
+	/*  x = n + f, -0.5 <= f <= 0.5  */
+	const double n = std::floor(x + 0.5);
+	const double f = (x - n) * M_LN2;
+
+	/*  e^f (TAYLOR SERIES UP TO f^8)  */
+	const double p = 1.0 + f * (1.0 + f * (1.0 / 2.0 + f * (1.0 / 6.0 + f * (1.0 / 24.0 + f * (1.0 / 120.0
+			+ f * (1.0 / 720.0 + f * (1.0 / 5040.0 + f * (1.0 / 40320.0))))))));
+
+	/*  2^n, BUILT FROM THE EXPONENT BITS  */
+	const std::int64_t bits = (static_cast<std::int64_t>(n) + 1023) << 52;
+	double scale;
+	std::memcpy(&scale, &bits, sizeof scale);
+	return p * scale;
+}
+
+inline
+double
+cos(double x)
+{
+	/*  REDUCE TO 0 - PI  */
+	x = std::fabs(x);
+	if (x > M_PI) {
+		x = std::fmod(x, 2.0 * M_PI);
+		if (x > M_PI) {
+			x = (2.0 * M_PI) - x;
+		}
+	}
+
+	double sign = 1.0;
+	if (x > M_PI_2) {
+		x = M_PI - x;
+		sign = -1.0;
+	}
+	if (x <= M_PI_4) {
+		return sign * Detail::cosQuarter(x);
+	} else {
+		return sign * Detail::sinQuarter(M_PI_2 - x);
+	}
+}
+
+inline
+double
+tan(double x)
+{
+	if (x <= M_PI_4) {
+		return Detail::sinQuarter(x) / Detail::cosQuarter(x);
+	} else {
+		const double y = M_PI_2 - x;
+		return Detail::cosQuarter(y) / Detail::sinQuarter(y);
+	}
+}
+
+#else
+
+inline double exp2(double x) { return std::pow(2.0, x); }
+inline double cos(double x) { return std::cos(x); }
+inline double tan(double x) { return std::tan(x); }
+
+#endif
+
+// Returns 10^(x / 20).
+inline
+double
+decibelToAmplitude(double x)
+{
+#ifdef GS_TRM_FAST_MATH
+	return exp2(x * (M_LN10 / (20.0 * M_LN2)));
+#else
+	return std::pow(10.0, x / 20.0);
+#endif
+}
+
+} /* namespace FastMath */
+} /* namespace TRM */
+} /* namespace GS */
+
+#endif /* TRM_FAST_MATH_H_ */
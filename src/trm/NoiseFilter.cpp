@@ -25,27 +25,35 @@
 namespace GS {
 namespace TRM {
 
-NoiseFilter::NoiseFilter() : noiseX_(0.0)
+template<typename FloatType>
+NoiseFilter<FloatType>::NoiseFilter() : noiseX_(0.0)
 {
 }
 
-NoiseFilter::~NoiseFilter()
+template<typename FloatType>
+NoiseFilter<FloatType>::~NoiseFilter()
 {
 }
 
+template<typename FloatType>
 void
-NoiseFilter::reset()
+NoiseFilter<FloatType>::reset()
 {
 	noiseX_ = 0.0;
 }
 
-double
-NoiseFilter::filter(double input)
+template<typename FloatType>
+FloatType
+NoiseFilter<FloatType>::filter(FloatType input)
 {
-	double output = input + noiseX_;
+	FloatType output = input + noiseX_;
 	noiseX_ = input;
 	return output;
 }
 
+// Explicit instantiation.
+template class NoiseFilter<float>;
+template class NoiseFilter<double>;
+
 } /* namespace TRM */
 } /* namespace GS */
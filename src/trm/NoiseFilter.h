@@ -27,18 +27,19 @@ namespace GS {
 namespace TRM {
 
 // One-zero lowpass filter.
+template<typename FloatType>
 class NoiseFilter {
 public:
 	NoiseFilter();
 	~NoiseFilter();
 
 	void reset();
-	double filter(double input);
+	FloatType filter(FloatType input);
 private:
 	NoiseFilter(const NoiseFilter&) = delete;
 	NoiseFilter& operator=(const NoiseFilter&) = delete;
 
-	double noiseX_;
+	FloatType noiseX_;
 };
 
 } /* namespace TRM */
@@ -0,0 +1,266 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+#include "ParallelTube.h"
+
+#include <algorithm> /* max, min */
+
+#include "Log.h"
+
+
+
+namespace GS {
+namespace TRM {
+
+ParallelTube::ParallelTube(unsigned int numThreads)
+		: numThreads_(std::max(1U, numThreads))
+		, threadTubeList_(numThreads_)
+		, generation_(0)
+		, numBusyThreads_(0)
+		, stopThreads_(false)
+		, input_(nullptr)
+		, nextSegment_(0)
+{
+}
+
+ParallelTube::~ParallelTube()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopThreads_ = true;
+	}
+	startCondition_.notify_all();
+	for (std::thread& t : threadList_) {
+		t.join();
+	}
+}
+
+void
+ParallelTube::synthesizeToFile(const ControlFrameBuffer& input, const std::vector<std::size_t>& splitFrames, const char* outputFile)
+{
+	synthesize(input, splitFrames, nullptr);
+	tube_.writeOutputToFile(outputFile);
+}
+
+void
+ParallelTube::synthesizeToBuffer(const ControlFrameBuffer& input, const std::vector<std::size_t>& splitFrames, std::vector<float>& outputBuffer)
+{
+	synthesize(input, splitFrames, &outputBuffer);
+	tube_.writeOutputToBuffer(outputBuffer);
+}
+
+/*******************************************************************************
+ * Synthesizes the segments in the threads, and sends the joined signal to
+ * the sample rate converter of tube_.
+ */
+void
+ParallelTube::synthesize(const ControlFrameBuffer& input, const std::vector<std::size_t>& splitFrames, std::vector<float>* outputBuffer)
+{
+	tube_.reset();
+	tube_.loadInputHeader(input.header());
+	tube_.initializeSynthesizer();
+	tube_.prepareOutput(input.size(), outputBuffer);
+
+	createSegments(input.size(), splitFrames);
+	LOG_DEBUG("\nNumber of segments: " << segmentList_.size());
+
+	/*  EACH THREAD TAKES THE NEXT SEGMENT, USING ITS OWN TUBE  */
+	input_ = &input;
+	nextSegment_ = 0;
+	if (segmentList_.size() > 1) {
+		startThreads();
+	}
+	const bool useThreads = segmentList_.size() > 1 && !threadList_.empty();
+	if (useThreads) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			numBusyThreads_ = threadList_.size();
+			++generation_;
+		}
+		startCondition_.notify_all();
+	}
+	synthesizeSegments(0);
+	if (useThreads) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		doneCondition_.wait(lock, [this] { return numBusyThreads_ == 0; });
+	}
+	input_ = nullptr;
+
+	for (const Segment& segment : segmentList_) {
+		if (segment.error) {
+			std::exception_ptr error = segment.error;
+			segmentList_.clear();
+			std::rethrow_exception(error);
+		}
+	}
+
+	joinSegments();
+	segmentList_.clear();
+}
+
+/*******************************************************************************
+ * Creates the worker threads, if they have not been created yet. If a thread
+ * cannot be created, the synthesis continues with the threads that have
+ * been created.
+ */
+void
+ParallelTube::startThreads()
+{
+	if (!threadList_.empty()) {
+		return;
+	}
+	try {
+		for (unsigned int i = 1; i < numThreads_; ++i) {
+			threadList_.push_back(std::thread(&ParallelTube::threadLoop, this, i));
+		}
+	} catch (...) {
+	}
+}
+
+/*******************************************************************************
+ * Body of a worker thread. Waits for each new input, and synthesizes
+ * segments until there are no more segments.
+ */
+void
+ParallelTube::threadLoop(unsigned int threadIndex)
+{
+	unsigned int generation = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			startCondition_.wait(lock, [&] { return stopThreads_ || generation_ != generation; });
+			if (stopThreads_) return;
+			generation = generation_;
+		}
+
+		synthesizeSegments(threadIndex);
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (--numBusyThreads_ == 0) {
+			doneCondition_.notify_one();
+		}
+	}
+}
+
+/*******************************************************************************
+ * Takes the next segment of input_ until there are no more segments. The
+ * errors are stored in the segments.
+ */
+void
+ParallelTube::synthesizeSegments(unsigned int threadIndex)
+{
+	std::unique_ptr<Tube>& tube = threadTubeList_[threadIndex];
+	std::size_t i;
+	while ((i = nextSegment_++) < segmentList_.size()) {
+		Segment& segment = segmentList_[i];
+		try {
+			if (!tube) {
+				tube.reset(new Tube());
+			}
+			synthesizeSegment(*tube, *input_, segment);
+		} catch (...) {
+			segment.error = std::current_exception();
+		}
+	}
+}
+
+/*******************************************************************************
+ * Divides the control periods 1 - inputSize in segments. The control period
+ * n is interpolated between the input tables n - 1 and n, so a segment that
+ * begins at the table f begins at the control period f + 1.
+ */
+void
+ParallelTube::createSegments(std::size_t inputSize, const std::vector<std::size_t>& splitFrames)
+{
+	segmentList_.clear();
+
+	std::size_t firstPos = 1;
+	auto addSegment = [&](std::size_t lastPos) {
+		segmentList_.push_back(Segment());
+		Segment& segment = segmentList_.back();
+		segment.firstPos = firstPos;
+		segment.lastPos  = lastPos;
+		segment.beginPos = firstPos > WARM_UP_PERIODS ? firstPos - WARM_UP_PERIODS : 1;
+		segment.endPos   = lastPos + CROSSFADE_PERIODS;
+	};
+
+	for (std::size_t frame : splitFrames) {
+		std::size_t pos = frame + 1;
+		if (pos < firstPos + CROSSFADE_PERIODS || pos + CROSSFADE_PERIODS > inputSize + 1) {
+			continue;
+		}
+		addSegment(pos - 1);
+		firstPos = pos;
+	}
+	addSegment(inputSize);
+
+	/*  THE LAST SEGMENT IS NOT CROSSFADED  */
+	segmentList_.back().endPos = inputSize;
+}
+
+void
+ParallelTube::synthesizeSegment(Tube& tube, const ControlFrameBuffer& input, Segment& segment)
+{
+	tube.reset();
+	tube.loadInputHeader(input.header());
+	tube.initializeSynthesizer();
+
+	segment.samples.clear();
+	segment.samples.reserve((segment.endPos + 1 - segment.beginPos) * tube.controlPeriod_);
+	tube.segmentOutput_ = &segment.samples;
+
+	for (std::size_t pos = segment.beginPos; pos <= segment.endPos; ++pos) {
+		tube.synthesizeControlPeriod(input, pos);
+	}
+
+	tube.segmentOutput_ = nullptr;
+}
+
+/*******************************************************************************
+ * Sends the segments, without the warm-up, to the sample rate converter.
+ * The start of each segment is crossfaded linearly with the samples that
+ * the previous segment has synthesized after its end.
+ */
+void
+ParallelTube::joinSegments()
+{
+	const std::size_t periodSamples = tube_.controlPeriod_;
+	const std::size_t crossfadeSamples = CROSSFADE_PERIODS * periodSamples;
+
+	for (std::size_t k = 0; k < segmentList_.size(); ++k) {
+		Segment& segment = segmentList_[k];
+		Tube::SampleFloat* data = segment.samples.data() + (segment.firstPos - segment.beginPos) * periodSamples;
+		const std::size_t size = (segment.lastPos + 1 - segment.firstPos) * periodSamples;
+
+		if (k > 0) {
+			std::vector<Tube::SampleFloat>& prevSamples = segmentList_[k - 1].samples;
+			const Tube::SampleFloat* prevData = prevSamples.data() + prevSamples.size() - crossfadeSamples;
+			for (std::size_t i = 0; i < crossfadeSamples; ++i) {
+				Tube::SampleFloat weight = static_cast<Tube::SampleFloat>((i + 0.5) / crossfadeSamples);
+				data[i] = prevData[i] + (data[i] - prevData[i]) * weight;
+			}
+
+			/*  THE PREVIOUS SEGMENT IS NOT NEEDED ANYMORE  */
+			std::vector<Tube::SampleFloat>().swap(prevSamples);
+		}
+
+		tube_.srConv_->dataFill(data, size);
+	}
+}
+
+} /* namespace TRM */
+} /* namespace GS */
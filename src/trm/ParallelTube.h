@@ -0,0 +1,117 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+#ifndef TRM_PARALLEL_TUBE_H_
+#define TRM_PARALLEL_TUBE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef> /* std::size_t */
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ControlFrameBuffer.h"
+#include "Tube.h"
+
+
+
+namespace GS {
+namespace TRM {
+
+/*******************************************************************************
+ * Synthesizes one long input in segments, using several threads.
+ *
+ * The input is split at the given frames (e.g. at the silences between the
+ * chunks of a phonetic string), and each segment is synthesized by its own
+ * Tube, at the tube sample rate. The synthesis of a segment starts
+ * WARM_UP_PERIODS control periods before the segment, and these samples are
+ * discarded, so that the filters and the vocal tract have settled when the
+ * segment begins. The first CROSSFADE_PERIODS control periods of a segment
+ * are crossfaded with the continuation of the previous segment.
+ *
+ * The joined signal is converted to the output rate and normalized as a
+ * whole, like the output of Tube. The glottal source and the noise source
+ * restart in each segment, so the output is not identical to the output of
+ * Tube, but it does not depend on the number of threads. Without splits the
+ * output is identical.
+ *
+ * The calling thread synthesizes segments too. The other threads are created
+ * when the first input with more than one segment is synthesized, and wait
+ * for the next inputs until the object is destroyed.
+ */
+class ParallelTube {
+public:
+	enum {
+		WARM_UP_PERIODS   = 25, /*  100 ms at 250 Hz  */
+		CROSSFADE_PERIODS = 5   /*  20 ms at 250 Hz  */
+	};
+
+	explicit ParallelTube(unsigned int numThreads);
+	~ParallelTube();
+
+	// splitFrames contains the input tables where the segments begin, in
+	// increasing order. A split that would leave less than CROSSFADE_PERIODS
+	// control periods in a segment is ignored.
+	void synthesizeToFile(const ControlFrameBuffer& input, const std::vector<std::size_t>& splitFrames, const char* outputFile);
+	void synthesizeToBuffer(const ControlFrameBuffer& input, const std::vector<std::size_t>& splitFrames, std::vector<float>& outputBuffer);
+
+	unsigned int numThreads() const { return numThreads_; }
+private:
+	struct Segment {
+		std::size_t firstPos;  /*  first control period of the segment (1 - input size)  */
+		std::size_t lastPos;
+		std::size_t beginPos;  /*  first control period synthesized (with the warm-up)  */
+		std::size_t endPos;    /*  last control period synthesized (with the crossfade)  */
+		std::vector<Tube::SampleFloat> samples;
+		std::exception_ptr error;
+	};
+
+	ParallelTube(const ParallelTube&) = delete;
+	ParallelTube& operator=(const ParallelTube&) = delete;
+
+	void synthesize(const ControlFrameBuffer& input, const std::vector<std::size_t>& splitFrames, std::vector<float>* outputBuffer);
+	void startThreads();
+	void threadLoop(unsigned int threadIndex);
+	void synthesizeSegments(unsigned int threadIndex);
+	void createSegments(std::size_t inputSize, const std::vector<std::size_t>& splitFrames);
+	void synthesizeSegment(Tube& tube, const ControlFrameBuffer& input, Segment& segment);
+	void joinSegments();
+
+	unsigned int numThreads_;
+	std::vector<Segment> segmentList_;
+	std::vector<std::unique_ptr<Tube>> threadTubeList_; /*  created by each thread, and reused in the next inputs  */
+	Tube tube_;                          /*  converts and normalizes the joined signal  */
+
+	/*  WORKER THREADS (INDEX 1 - numThreads_ - 1)  */
+	std::vector<std::thread> threadList_;
+	std::mutex mutex_;
+	std::condition_variable startCondition_;
+	std::condition_variable doneCondition_;
+	unsigned int generation_;            /*  incremented for each input  */
+	unsigned int numBusyThreads_;
+	bool stopThreads_;
+	const ControlFrameBuffer* input_;    /*  input of the current generation  */
+	std::atomic<std::size_t> nextSegment_;
+};
+
+} /* namespace TRM */
+} /* namespace GS */
+
+#endif /* TRM_PARALLEL_TUBE_H_ */
@@ -25,33 +25,41 @@
 namespace GS {
 namespace TRM {
 
-RadiationFilter::RadiationFilter(double apertureCoeff)
+template<typename FloatType>
+RadiationFilter<FloatType>::RadiationFilter(double apertureCoeff)
 		: radiationX_(0.0)
 		, radiationY_(0.0)
 {
-	a20_ = apertureCoeff;
+	a20_ = static_cast<FloatType>(apertureCoeff);
 	a21_ = b21_ = -a20_;
 }
 
-RadiationFilter::~RadiationFilter()
+template<typename FloatType>
+RadiationFilter<FloatType>::~RadiationFilter()
 {
 }
 
+template<typename FloatType>
 void
-RadiationFilter::reset()
+RadiationFilter<FloatType>::reset()
 {
 	radiationX_ = 0.0;
 	radiationY_ = 0.0;
 }
 
-double
-RadiationFilter::filter(double input)
+template<typename FloatType>
+FloatType
+RadiationFilter<FloatType>::filter(FloatType input)
 {
-	double output = (a20_ * input) + (a21_ * radiationX_) - (b21_ * radiationY_);
+	FloatType output = (a20_ * input) + (a21_ * radiationX_) - (b21_ * radiationY_);
 	radiationX_ = input;
 	radiationY_ = output;
 	return output;
 }
 
+// Explicit instantiation.
+template class RadiationFilter<float>;
+template class RadiationFilter<double>;
+
 } /* namespace TRM */
 } /* namespace GS */
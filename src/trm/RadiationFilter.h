@@ -29,22 +29,23 @@ namespace TRM {
 // Is a variable, one-zero, one-pole, highpass filter,
 // whose cutoff point is determined by the aperture
 // coefficient.
+template<typename FloatType>
 class RadiationFilter {
 public:
 	RadiationFilter(double apertureCoeff);
 	~RadiationFilter();
 
 	void reset();
-	double filter(double input);
+	FloatType filter(FloatType input);
 private:
 	RadiationFilter(const RadiationFilter&) = delete;
 	RadiationFilter& operator=(const RadiationFilter&) = delete;
 
-	double a20_;
-	double a21_;
-	double b21_;
-	double radiationX_;
-	double radiationY_;
+	FloatType a20_;
+	FloatType a21_;
+	FloatType b21_;
+	FloatType radiationX_;
+	FloatType radiationY_;
 };
 
 } /* namespace TRM */
@@ -27,30 +27,38 @@
 namespace GS {
 namespace TRM {
 
-ReflectionFilter::ReflectionFilter(double apertureCoeff)
+template<typename FloatType>
+ReflectionFilter<FloatType>::ReflectionFilter(double apertureCoeff)
 		: reflectionY_(0.0)
 {
-	b11_ = -apertureCoeff;
-	a10_ = 1.0 - fabs(b11_);
+	b11_ = static_cast<FloatType>(-apertureCoeff);
+	a10_ = static_cast<FloatType>(1.0 - fabs(apertureCoeff));
 }
 
-ReflectionFilter::~ReflectionFilter()
+template<typename FloatType>
+ReflectionFilter<FloatType>::~ReflectionFilter()
 {
 }
 
+template<typename FloatType>
 void
-ReflectionFilter::reset()
+ReflectionFilter<FloatType>::reset()
 {
 	reflectionY_ = 0.0;
 }
 
-double
-ReflectionFilter::filter(double input)
+template<typename FloatType>
+FloatType
+ReflectionFilter<FloatType>::filter(FloatType input)
 {
-	double output = (a10_ * input) - (b11_ * reflectionY_);
+	FloatType output = (a10_ * input) - (b11_ * reflectionY_);
 	reflectionY_ = output;
 	return output;
 }
 
+// Explicit instantiation.
+template class ReflectionFilter<float>;
+template class ReflectionFilter<double>;
+
 } /* namespace TRM */
 } /* namespace GS */
@@ -28,20 +28,21 @@ namespace TRM {
 
 // Is a variable, one-pole lowpass filter, whose cutoff
 // is determined by the aperture coefficient.
+template<typename FloatType>
 class ReflectionFilter {
 public:
 	ReflectionFilter(double apertureCoeff);
 	~ReflectionFilter();
 
 	void reset();
-	double filter(double input);
+	FloatType filter(FloatType input);
 private:
 	ReflectionFilter(const ReflectionFilter&) = delete;
 	ReflectionFilter& operator=(const ReflectionFilter&) = delete;
 
-	double a10_;
-	double b11_;
-	double reflectionY_;
+	FloatType a10_;
+	FloatType b11_;
+	FloatType reflectionY_;
 };
 
 } /* namespace TRM */
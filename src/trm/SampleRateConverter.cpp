@@ -20,73 +20,75 @@
 
 #include "SampleRateConverter.h"
 
+#include <algorithm> /* max, min */
 #include <cmath>
+#include <cstring> /* memcpy, memmove */
+
 
-#define BETA                      5.658        /*  kaiser window parameters  */
 #define IzeroEPSILON              1E-21
 
-/*  SAMPLE RATE CONVERSION CONSTANTS  */
-#define ZERO_CROSSINGS            13                 /*  SRC CUTOFF FRQ      */
-#define LP_CUTOFF                 (11.0/13.0)        /*  (0.846 OF NYQUIST)  */
-#define FILTER_LENGTH             (ZERO_CROSSINGS * L_RANGE)
+#define BUFFER_SIZE               1024
+
 
-//#define N_BITS                    16
-#define L_BITS                    8
-#define L_RANGE                   256                  /*  must be 2^L_BITS  */
-#define M_BITS                    8
-#define M_RANGE                   256                  /*  must be 2^M_BITS  */
-#define FRACTION_BITS             (L_BITS + M_BITS)
-#define FRACTION_RANGE            65536         /*  must be 2^FRACTION_BITS  */
-#define FILTER_LIMIT              (FILTER_LENGTH - 1)
 
-#define N_MASK                    0xFFFF0000
-#define L_MASK                    0x0000FF00
-#define M_MASK                    0x000000FF
-#define FRACTION_MASK             0x0000FFFF
+namespace {
 
-#define nValue(x)                 (((x) & N_MASK) >> FRACTION_BITS)
-#define lValue(x)                 (((x) & L_MASK) >> M_BITS)
-#define mValue(x)                 ((x) & M_MASK)
-#define fractionValue(x)          ((x) & FRACTION_MASK)
+struct FilterParameters {
+	unsigned int zeroCrossings;
+	double cutoff;                    /*  fraction of the nyquist frequency  */
+	double beta;                      /*  kaiser window parameter  */
+};
 
-#define BUFFER_SIZE               1024                 /*  ring buffer size  */
+const FilterParameters filterParameters[] = {
+	{  6, 0.75,         4.5   }, /*  QUALITY_FAST  */
+	{ 13, 11.0 / 13.0,  5.658 }, /*  QUALITY_DEFAULT  */
+	{ 32, 0.9,          8.0   }  /*  QUALITY_HIGH  */
+};
 
+long
+greatestCommonDivisor(long a, long b)
+{
+	while (b != 0) {
+		long t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
 
+} /* namespace */
 
 namespace GS {
 namespace TRM {
 
-SampleRateConverter::SampleRateConverter(int sampleRate, float outputRate, std::vector<float>& outputData)
+template<typename FloatType>
+SampleRateConverter<FloatType>::SampleRateConverter(int sampleRate, float outputRate, std::vector<float>& outputData, Quality quality)
 		: sampleRateRatio_(0.0)
-		, fillPtr_(0)
-		, emptyPtr_(0)
-		, padSize_(0)
-		, fillSize_(0)
-		, timeRegisterIncrement_(0)
-		, filterIncrement_(0)
+		, numPhases_(0)
 		, phaseIncrement_(0)
-		, timeRegister_(0)
-		, fillCounter_(0)
+		, halfLength_(0)
+		, numTaps_(0)
+		, phase_(0)
+		, emptyPos_(0)
+		, fillPos_(0)
 		, maximumSampleValue_(0.0)
 		, numberSamples_(0)
-		, h_(FILTER_LENGTH)
-		, deltaH_(FILTER_LENGTH)
-		, buffer_(BUFFER_SIZE)
-		, outputData_(outputData)
+		, outputGain_(1.0f)
+		, outputData_(&outputData)
 {
 	initializeConversion(sampleRate, outputRate);
+	initializeFilter(quality);
+	initializeBuffer();
 }
-
-SampleRateConverter::~SampleRateConverter()
+template<typename FloatType>
+SampleRateConverter<FloatType>::~SampleRateConverter()
 {
 }
 
+template<typename FloatType>
 void
-SampleRateConverter::reset()
+SampleRateConverter<FloatType>::reset()
 {
-	emptyPtr_ = 0;
-	timeRegister_ = 0;
-	fillCounter_ = 0;
 	maximumSampleValue_ = 0.0;
 	numberSamples_ = 0;
 	initializeBuffer();
@@ -96,40 +98,31 @@ SampleRateConverter::reset()
 *
 *  function:  initializeConversion
 *
-*  purpose:   Initializes all the sample rate conversion functions.
+*  purpose:   Calculates the number of phases and the time between
+*             the output samples.
 *
 ******************************************************************************/
+template<typename FloatType>
 void
-SampleRateConverter::initializeConversion(int sampleRate, float outputRate)
+SampleRateConverter<FloatType>::initializeConversion(int sampleRate, float outputRate)
 {
-	/*  INITIALIZE FILTER IMPULSE RESPONSE  */
-	initializeFilter();
-
 	/*  CALCULATE SAMPLE RATE RATIO  */
 	sampleRateRatio_ = (double) outputRate / (double) sampleRate;
 
-	/*  CALCULATE TIME REGISTER INCREMENT  */
-	timeRegisterIncrement_ =
-			(int) rint(pow(2.0, FRACTION_BITS) / sampleRateRatio_);
+	/*  REDUCE THE RATIO TO THE LOWEST TERMS  */
+	long outputRateInt = std::lround(outputRate);
+	long divisor = greatestCommonDivisor(outputRateInt, sampleRate);
+	long l = outputRateInt / divisor;
+	long m = sampleRate / divisor;
 
-	/*  CALCULATE ROUNDED SAMPLE RATE RATIO  */
-	double roundedSampleRateRatio =
-			pow(2.0, FRACTION_BITS) / (double) timeRegisterIncrement_;
-
-	/*  CALCULATE PHASE OR FILTER INCREMENT  */
-	if (sampleRateRatio_ >= 1.0) {
-		filterIncrement_ = L_RANGE;
+	if (std::fabs(outputRate - outputRateInt) < 1.0e-3 && l <= MAX_PHASES) {
+		/*  EXACT RATIO  */
+		numPhases_ = l;
+		phaseIncrement_ = m;
 	} else {
-		phaseIncrement_ = (unsigned int) rint(sampleRateRatio_ * (double) FRACTION_RANGE);
+		numPhases_ = MAX_PHASES;
+		phaseIncrement_ = static_cast<unsigned int>(std::lround(MAX_PHASES / sampleRateRatio_));
 	}
-
-	/*  CALCULATE PAD SIZE  */
-	padSize_ = (sampleRateRatio_ >= 1.0) ?
-				ZERO_CROSSINGS :
-				(int) ((float) ZERO_CROSSINGS / roundedSampleRateRatio) + 1;
-
-	/*  INITIALIZE THE RING BUFFER  */
-	initializeBuffer();
 }
 
 /******************************************************************************
@@ -140,8 +133,9 @@ SampleRateConverter::initializeConversion(int sampleRate, float outputRate)
 *             the first kind, order 0, as a double.
 *
 ******************************************************************************/
+template<typename FloatType>
 double
-SampleRateConverter::Izero(double x)
+SampleRateConverter<FloatType>::Izero(double x)
 {
 	double sum, u, halfx, temp;
 	int n;
@@ -164,81 +158,96 @@ SampleRateConverter::Izero(double x)
 *
 * function:  initializeBuffer
 *
-*  purpose:  Initializes the ring buffer used for sample rate
-*            conversion.
+*  purpose:  Initializes the buffer used for sample rate conversion.
+*            The first output sample is centered on the first input
+*            sample, so the delay does not depend on the quality.
 *
 ******************************************************************************/
+template<typename FloatType>
 void
-SampleRateConverter::initializeBuffer()
+SampleRateConverter<FloatType>::initializeBuffer()
 {
-	/*  FILL THE RING BUFFER WITH ALL ZEROS  */
-	for (int i = 0; i < BUFFER_SIZE; i++) {
-		buffer_[i] = 0.0;
-	}
+	/*  FILL THE BUFFER WITH ALL ZEROS  */
+	buffer_.assign(std::max<std::size_t>(BUFFER_SIZE, 4 * numTaps_) + BLOCK_SIZE, 0.0);
 
-	/*  INITIALIZE FILL POINTER  */
-	fillPtr_ = padSize_;
-
-	/*  CALCULATE FILL SIZE  */
-	fillSize_ = BUFFER_SIZE - (2 * padSize_);
+	phase_ = 0;
+	emptyPos_ = 0;
+	fillPos_ = halfLength_ - 1;
 }
 
 /******************************************************************************
 *
 *  function:  initializeFilter
 *
-*  purpose:   Initializes filter impulse response and impulse delta
-*             values.
+*  purpose:   Calculates the filter impulse response for each phase.
+*             When downsampling, the cutoff frequency and the amplitude
+*             are scaled by the sample rate ratio, so the DC gain
+*             stays 1.
 *
 ******************************************************************************/
+template<typename FloatType>
 void
-SampleRateConverter::initializeFilter()
+SampleRateConverter<FloatType>::initializeFilter(Quality quality)
 {
-	/*  INITIALIZE THE FILTER IMPULSE RESPONSE  */
-	h_[0] = LP_CUTOFF;
-	double x = M_PI / (double) L_RANGE;
-	for (int i = 1; i < FILTER_LENGTH; i++) {
-		double y = (double) i * x;
-		h_[i] = sin(y * LP_CUTOFF) / y;
-	}
-
-	/*  APPLY A KAISER WINDOW TO THE IMPULSE RESPONSE  */
-	double IBeta = 1.0 / Izero(BETA);
-	for (int i = 0; i < FILTER_LENGTH; i++) {
-		double temp = (double) i / FILTER_LENGTH;
-		h_[i] *= Izero(BETA * sqrt(1.0 - (temp * temp))) * IBeta;
-	}
+	const FilterParameters& param = filterParameters[quality];
+	const double scale = std::min(sampleRateRatio_, 1.0);
+
+	halfLength_ = static_cast<unsigned int>(std::ceil(param.zeroCrossings / scale));
+	numTaps_ = (2 * halfLength_ + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+	h_.assign(numPhases_ * numTaps_, 0.0);
+
+	const double IBeta = 1.0 / Izero(param.beta);
+	for (unsigned int phase = 0; phase < numPhases_; ++phase) {
+		FloatType* h = &h_[phase * numTaps_];
+		for (unsigned int i = 0; i < 2 * halfLength_; ++i) {
+			/*  DISTANCE FROM THE CENTER, IN ZERO CROSSINGS OF THE UNSCALED FILTER  */
+			double x = ((double) i - halfLength_ + 1.0 - (double) phase / numPhases_) * scale;
+			double temp = x / param.zeroCrossings;
+			if (temp <= -1.0 || temp >= 1.0) {
+				continue;
+			}
 
-	/*  INITIALIZE THE FILTER IMPULSE RESPONSE DELTA VALUES  */
-	for (int i = 0; i < FILTER_LIMIT; i++) {
-		deltaH_[i] = h_[i + 1] - h_[i];
+			/*  IMPULSE RESPONSE WITH A KAISER WINDOW  */
+			double y = M_PI * x;
+			double impulse = ((y == 0.0) ? param.cutoff : sin(y * param.cutoff) / y) * scale;
+			h[i] = static_cast<FloatType>(impulse * Izero(param.beta * sqrt(1.0 - (temp * temp))) * IBeta);
+		}
 	}
-	deltaH_[FILTER_LIMIT] = 0.0 - h_[FILTER_LIMIT];
 }
 
 /******************************************************************************
 *
 *  function:  dataFill
 *
-*  purpose:   Fills the ring buffer with a single sample, increments
-*             the counters and pointers, and empties the buffer when
-*             full.
+*  purpose:   Puts a single sample into the buffer, and empties the
+*             buffer when full.
 *
 ******************************************************************************/
+template<typename FloatType>
 void
-SampleRateConverter::dataFill(double data)
+SampleRateConverter<FloatType>::dataFill(FloatType data)
 {
-	/*  PUT THE DATA INTO THE RING BUFFER  */
-	buffer_[fillPtr_] = data;
+	buffer_[fillPos_] = data;
 
-	/*  INCREMENT THE FILL POINTER, MODULO THE BUFFER SIZE  */
-	srIncrement(&fillPtr_, BUFFER_SIZE);
-
-	/*  INCREMENT THE COUNTER, AND EMPTY THE BUFFER IF FULL  */
-	if (++fillCounter_ >= fillSize_) {
+	/*  THE LAST BLOCK_SIZE ELEMENTS ARE ONLY READ (WITH ZERO COEFFICIENTS)  */
+	if (++fillPos_ == buffer_.size() - BLOCK_SIZE) {
 		dataEmpty();
-		/* RESET THE FILL COUNTER  */
-		fillCounter_ = 0;
+	}
+}
+
+template<typename FloatType>
+void
+SampleRateConverter<FloatType>::dataFill(const FloatType* data, std::size_t size)
+{
+	while (size > 0) {
+		std::size_t n = std::min(size, buffer_.size() - BLOCK_SIZE - fillPos_);
+		memcpy(&buffer_[fillPos_], data, n * sizeof(FloatType));
+		data += n;
+		size -= n;
+		fillPos_ += n;
+		if (fillPos_ == buffer_.size() - BLOCK_SIZE) {
+			dataEmpty();
+		}
 	}
 }
 
@@ -247,204 +256,87 @@ SampleRateConverter::dataFill(double data)
 *  function:  dataEmpty
 *
 *  purpose:   Converts available portion of the input signal to the
-*             new sampling rate, and outputs the samples to the
-*             sound struct.
+*             new sampling rate, and stores the samples in the
+*             output vector. The samples that are still needed are
+*             moved to the start of the buffer.
 *
 ******************************************************************************/
+template<typename FloatType>
 void
-SampleRateConverter::dataEmpty()
+SampleRateConverter<FloatType>::dataEmpty()
 {
-	/*  CALCULATE END POINTER  */
-	int endPtr = fillPtr_ - padSize_;
-
-	/*  ADJUST THE END POINTER, IF LESS THAN ZERO  */
-	if (endPtr < 0) {
-		endPtr += BUFFER_SIZE;
-	}
-
-	/*  ADJUST THE ENDPOINT, IF LESS THEN THE EMPTY POINTER  */
-	if (endPtr < emptyPtr_) {
-		endPtr += BUFFER_SIZE;
-	}
-
-	/*  UPSAMPLE LOOP (SLIGHTLY MORE EFFICIENT THAN DOWNSAMPLING)  */
-	if (sampleRateRatio_ >= 1.0) {
-		while (emptyPtr_ < endPtr) {
-			/*  RESET ACCUMULATOR TO ZERO  */
-			double output = 0.0;
-
-			/*  CALCULATE INTERPOLATION VALUE (STATIC WHEN UPSAMPLING)  */
-			double interpolation = (double) mValue(timeRegister_) / (double) M_RANGE;
-
-			/*  COMPUTE THE LEFT SIDE OF THE FILTER CONVOLUTION  */
-			int index = emptyPtr_;
-			for (int filterIndex = lValue(timeRegister_);
-					filterIndex < FILTER_LENGTH;
-					srDecrement(&index,BUFFER_SIZE), filterIndex += filterIncrement_) {
-				output += (buffer_[index] *
-						(h_[filterIndex] + (deltaH_[filterIndex] * interpolation)));
-			}
-
-			/*  ADJUST VALUES FOR RIGHT SIDE CALCULATION  */
-			timeRegister_ = ~timeRegister_;
-			interpolation = (double) mValue(timeRegister_) / (double) M_RANGE;
-
-			/*  COMPUTE THE RIGHT SIDE OF THE FILTER CONVOLUTION  */
-			index = emptyPtr_;
-			srIncrement(&index,BUFFER_SIZE);
-			for (int filterIndex = lValue(timeRegister_);
-					filterIndex < FILTER_LENGTH;
-					srIncrement(&index,BUFFER_SIZE), filterIndex += filterIncrement_) {
-				output += (buffer_[index] *
-						(h_[filterIndex] + (deltaH_[filterIndex] * interpolation)));
-			}
-
-			/*  RECORD MAXIMUM SAMPLE VALUE  */
-			double absoluteSampleValue = fabs(output);
-			if (absoluteSampleValue > maximumSampleValue_) {
-				maximumSampleValue_ = absoluteSampleValue;
-			}
-
-			/*  INCREMENT SAMPLE NUMBER  */
-			numberSamples_++;
-
-			/*  SAVE THE SAMPLE  */
-			outputData_.push_back(static_cast<float>(output));
+	const std::size_t filterSpan = 2 * halfLength_;
 
-			/*  CHANGE TIME REGISTER BACK TO ORIGINAL FORM  */
-			timeRegister_ = ~timeRegister_;
+	while (emptyPos_ + filterSpan <= fillPos_) {
+		double output = dotProduct(&buffer_[emptyPos_], &h_[phase_ * numTaps_], numTaps_);
 
-			/*  INCREMENT THE TIME REGISTER  */
-			timeRegister_ += timeRegisterIncrement_;
-
-			/*  INCREMENT THE EMPTY POINTER, ADJUSTING IT AND END POINTER  */
-			emptyPtr_ += nValue(timeRegister_);
-
-			if (emptyPtr_ >= BUFFER_SIZE) {
-				emptyPtr_ -= BUFFER_SIZE;
-				endPtr -= BUFFER_SIZE;
-			}
-
-			/*  CLEAR N PART OF TIME REGISTER  */
-			timeRegister_ &= (~N_MASK);
+		/*  RECORD MAXIMUM SAMPLE VALUE  */
+		double absoluteSampleValue = fabs(output);
+		if (absoluteSampleValue > maximumSampleValue_) {
+			maximumSampleValue_ = absoluteSampleValue;
 		}
-	} else {
-		/*  DOWNSAMPLING CONVERSION LOOP  */
-
-		while (emptyPtr_ < endPtr) {
-
-			/*  RESET ACCUMULATOR TO ZERO  */
-			double output = 0.0;
-
-			/*  COMPUTE P PRIME  */
-			unsigned int phaseIndex = (unsigned int) rint(
-						((double) fractionValue(timeRegister_)) * sampleRateRatio_);
-
-			/*  COMPUTE THE LEFT SIDE OF THE FILTER CONVOLUTION  */
-			int index = emptyPtr_;
-			unsigned int impulseIndex;
-			while ((impulseIndex = (phaseIndex >> M_BITS)) < FILTER_LENGTH) {
-				double impulse = h_[impulseIndex] + (deltaH_[impulseIndex] *
-						(((double) mValue(phaseIndex)) / (double) M_RANGE));
-				output += (buffer_[index] * impulse);
-				srDecrement(&index, BUFFER_SIZE);
-				phaseIndex += phaseIncrement_;
-			}
-
-			/*  COMPUTE P PRIME, ADJUSTED FOR RIGHT SIDE  */
-			phaseIndex = (unsigned int) rint(
-						((double) fractionValue(~timeRegister_)) * sampleRateRatio_);
-
-			/*  COMPUTE THE RIGHT SIDE OF THE FILTER CONVOLUTION  */
-			index = emptyPtr_;
-			srIncrement(&index, BUFFER_SIZE);
-			while ((impulseIndex = (phaseIndex >> M_BITS)) < FILTER_LENGTH) {
-				double impulse = h_[impulseIndex] + (deltaH_[impulseIndex] *
-						(((double) mValue(phaseIndex)) / (double) M_RANGE));
-				output += (buffer_[index] * impulse);
-				srIncrement(&index, BUFFER_SIZE);
-				phaseIndex += phaseIncrement_;
-			}
-
-			/*  RECORD MAXIMUM SAMPLE VALUE  */
-			double absoluteSampleValue = fabs(output);
-			if (absoluteSampleValue > maximumSampleValue_) {
-				maximumSampleValue_ = absoluteSampleValue;
-			}
 
-			/*  INCREMENT SAMPLE NUMBER  */
-			numberSamples_++;
+		/*  INCREMENT SAMPLE NUMBER  */
+		numberSamples_++;
 
-			/*  SAVE THE SAMPLE  */
-			outputData_.push_back(static_cast<float>(output));
+		/*  SAVE THE SAMPLE  */
+		outputData_->push_back(static_cast<float>(output) * outputGain_);
 
-			/*  INCREMENT THE TIME REGISTER  */
-			timeRegister_ += timeRegisterIncrement_;
-
-			/*  INCREMENT THE EMPTY POINTER, ADJUSTING IT AND END POINTER  */
-			emptyPtr_ += nValue(timeRegister_);
-			if (emptyPtr_ >= BUFFER_SIZE) {
-				emptyPtr_ -= BUFFER_SIZE;
-				endPtr -= BUFFER_SIZE;
-			}
-
-			/*  CLEAR N PART OF TIME REGISTER  */
-			timeRegister_ &= (~N_MASK);
-		}
+		/*  INCREMENT THE TIME  */
+		phase_ += phaseIncrement_;
+		emptyPos_ += phase_ / numPhases_;
+		phase_ %= numPhases_;
 	}
-}
 
-/******************************************************************************
-*
-*  function:  srIncrement
-*
-*  purpose:   Increments the pointer, keeping it within the range
-*             0 to (modulus-1).
-*
-******************************************************************************/
-void
-SampleRateConverter::srIncrement(int *pointer, int modulus)
-{
-	if (++(*pointer) >= modulus) {
-		(*pointer) -= modulus;
+	/*  MOVE THE REMAINING SAMPLES TO THE START OF THE BUFFER  */
+	std::size_t shift = std::min(emptyPos_, fillPos_);
+	if (shift > 0) {
+		memmove(&buffer_[0], &buffer_[shift], (fillPos_ - shift) * sizeof(FloatType));
+		emptyPos_ -= shift;
+		fillPos_ -= shift;
 	}
 }
 
 /******************************************************************************
 *
-*  function:  srDecrement
+*  function:  flushBuffer
 *
-*  purpose:   Decrements the pointer, keeping it within the range
-*             0 to (modulus-1).
+*  purpose:   Pads the buffer with zero samples, and flushes it by
+*             converting the remaining samples.
 *
 ******************************************************************************/
+template<typename FloatType>
 void
-SampleRateConverter::srDecrement(int *pointer, int modulus)
+SampleRateConverter<FloatType>::flushBuffer()
 {
-	if (--(*pointer) < 0) {
-		(*pointer) += modulus;
+	/*  PAD END OF BUFFER WITH ZEROS  */
+	for (unsigned int i = 0; i < halfLength_; i++) {
+		dataFill(0.0);
 	}
+
+	/*  FLUSH UP TO THE LAST INPUT SAMPLE  */
+	dataEmpty();
 }
 
 /******************************************************************************
 *
-*  function:  flushBuffer
+*  function:  maximumOutputSamples
 *
-*  purpose:   Pads the buffer with zero samples, and flushes it by
-*             converting the remaining samples.
+*  purpose:   Returns the maximum number of output samples that will be
+*             produced (including the flush) from numInputSamples input
+*             samples. Used to reserve the output vector.
 *
 ******************************************************************************/
-void
-SampleRateConverter::flushBuffer()
+template<typename FloatType>
+std::size_t
+SampleRateConverter<FloatType>::maximumOutputSamples(std::size_t numInputSamples) const
 {
-	/*  PAD END OF RING BUFFER WITH ZEROS  */
-	for (int i = 0; i < padSize_ * 2; i++) {
-		dataFill(0.0);
-	}
-
-	/*  FLUSH UP TO FILL POINTER - PADSIZE  */
-	dataEmpty();
+	return (numInputSamples * numPhases_ + phaseIncrement_ - 1) / phaseIncrement_ + 1;
 }
 
+// Explicit instantiation.
+template class SampleRateConverter<float>;
+template class SampleRateConverter<double>;
+
 } /* namespace TRM */
 } /* namespace GS */
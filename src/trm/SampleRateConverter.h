@@ -21,55 +21,99 @@
 #ifndef TRM_SAMPLE_RATE_CONVERTER_H_
 #define TRM_SAMPLE_RATE_CONVERTER_H_
 
+#include <cstddef> /* std::size_t */
 #include <vector>
 
+#include "Simd.h"
+
 
 
 namespace GS {
 namespace TRM {
 
-class SampleRateConverter {
+// Constants that do not depend on the sample type.
+class SampleRateConverterBase {
+public:
+	enum Quality {
+		QUALITY_FAST    = 0, /*  6 zero crossings  */
+		QUALITY_DEFAULT = 1, /*  13 zero crossings (the filter of the original converter)  */
+		QUALITY_HIGH    = 2  /*  32 zero crossings  */
+	};
+	enum {
+		MAX_PHASES = 1024
+	};
+	enum {
+		MIN_OUTPUT_RATE = 8000,  /*  Hz  */
+		MAX_OUTPUT_RATE = 96000  /*  Hz  */
+	};
+};
+
+/*******************************************************************************
+ * Polyphase sample rate converter.
+ *
+ * The Kaiser-windowed sinc filter is precomputed for each phase of the
+ * ratio between the output and the input rates (reduced to the lowest
+ * terms). If the ratio has more than MAX_PHASES phases, the nearest of
+ * MAX_PHASES phases is used.
+ *
+ * The filter and the input samples are stored as FloatType.
+ *
+ * The output samples are appended to a vector owned by the caller, which
+ * may be replaced between utterances (see setOutput). They are multiplied
+ * by the output gain, but maximumSampleValue() is the maximum absolute
+ * value before the gain.
+ */
+template<typename FloatType>
+class SampleRateConverter : public SampleRateConverterBase {
 public:
-	SampleRateConverter(int sampleRate, float outputRate, std::vector<float>& outputData);
+	SampleRateConverter(int sampleRate, float outputRate, std::vector<float>& outputData, Quality quality = QUALITY_DEFAULT);
 	~SampleRateConverter();
 
 	void reset();
-	void dataFill(double data);
+	void dataFill(FloatType data);
+	void dataFill(const FloatType* data, std::size_t size);
 	void dataEmpty();
 	void flushBuffer();
 
+	void setOutput(std::vector<float>& outputData) { outputData_ = &outputData; }
+	const std::vector<float>* output() const { return outputData_; }
+	void setOutputGain(float gain) { outputGain_ = gain; }
+	std::size_t maximumOutputSamples(std::size_t numInputSamples) const;
+
 	double maximumSampleValue() const { return maximumSampleValue_; }
 	long numberSamples() const { return numberSamples_; }
+	unsigned int numberPhases() const { return numPhases_; }
+	unsigned int filterLength() const { return numTaps_; }
 private:
+	enum {
+		BLOCK_SIZE = DotProductBlock<FloatType>::SIZE
+	};
+
 	SampleRateConverter(const SampleRateConverter&) = delete;
 	SampleRateConverter& operator=(const SampleRateConverter&) = delete;
 
 	void initializeConversion(int sampleRate, float outputRate);
 	void initializeBuffer();
-	void initializeFilter();
+	void initializeFilter(Quality quality);
 
 	static double Izero(double x);
-	static void srIncrement(int *pointer, int modulus);
-	static void srDecrement(int *pointer, int modulus);
 
 	double sampleRateRatio_;
-	int fillPtr_;
-	int emptyPtr_;
-	int padSize_;
-	int fillSize_;
-	unsigned int timeRegisterIncrement_;
-	unsigned int filterIncrement_;
-	unsigned int phaseIncrement_;
-	unsigned int timeRegister_;
-	int fillCounter_;
+	unsigned int numPhases_;
+	unsigned int phaseIncrement_;        /*  time between output samples, in 1/numPhases_ input samples  */
+	unsigned int halfLength_;            /*  filter taps on each side of the center  */
+	unsigned int numTaps_;               /*  2 * halfLength_, rounded up to the block size of dotProduct  */
+	unsigned int phase_;
+	std::size_t emptyPos_;               /*  first buffer sample used by the next output sample  */
+	std::size_t fillPos_;
 
 	double maximumSampleValue_;
 	long numberSamples_;
 
-	std::vector<double> h_;
-	std::vector<double> deltaH_;
-	std::vector<double> buffer_;
-	std::vector<float>& outputData_;
+	std::vector<FloatType> h_;           /*  numPhases_ x numTaps_  */
+	std::vector<FloatType> buffer_;
+	float outputGain_;
+	std::vector<float>* outputData_;
 };
 
 } /* namespace TRM */
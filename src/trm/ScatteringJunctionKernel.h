@@ -0,0 +1,213 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+#ifndef TRM_SCATTERING_JUNCTION_KERNEL_H_
+#define TRM_SCATTERING_JUNCTION_KERNEL_H_
+
+#include <cstring> /* memset */
+
+#include "Simd.h"
+
+
+
+namespace GS {
+namespace TRM {
+
+/*******************************************************************************
+ * Waves of the oropharynx and nasal tubes, stored as a struct of arrays.
+ *
+ * Sections 0-9 are the oropharynx (S1-S10) and sections 10-15 are the
+ * nasal cavity (N1-N6). Junction i connects sections i and i + 1.
+ *
+ * update() calculates all the two-way junctions at the same time, using
+ * SSE2/AVX lanes if available. The caller must then overwrite the values
+ * written by the junctions that are not two-way junctions:
+ * 3 (S4-S5, three-way junction with the nasal cavity), 9 (S10-N1) and 15.
+ * Junctions without a coefficient must have coefficient 0 (pure delay).
+ */
+template<typename FloatType>
+class ScatteringJunctionKernel {
+public:
+	enum {
+		NASAL_SECTION_OFFSET = 10,
+		NUM_SECTIONS = 16,
+		// Room for the writes of the last group of lanes.
+		ARRAY_SIZE = NUM_SECTIONS + 8
+	};
+
+	ScatteringJunctionKernel() { reset(); }
+
+	void reset();
+
+	// Swaps the current and the previous waves.
+	void swap() { current_ ^= 1; }
+	void update(FloatType dampingFactor, FloatType frication);
+
+	FloatType& coefficient(int junction) { return coeff_[junction]; }
+	FloatType& fricationTap(int junction) { return fricationTap_[junction]; }
+
+	FloatType& top(int section) { return top_[current_][section]; }
+	FloatType& bottom(int section) { return bottom_[current_][section]; }
+	FloatType prevTop(int section) const { return top_[current_ ^ 1][section]; }
+	FloatType prevBottom(int section) const { return bottom_[current_ ^ 1][section]; }
+private:
+	unsigned int current_;
+	FloatType top_[2][ARRAY_SIZE];
+	FloatType bottom_[2][ARRAY_SIZE];
+	FloatType coeff_[ARRAY_SIZE];
+	FloatType fricationTap_[ARRAY_SIZE];
+};
+
+
+
+template<typename FloatType>
+void
+ScatteringJunctionKernel<FloatType>::reset()
+{
+	current_ = 0;
+	memset(top_,          0, sizeof(top_));
+	memset(bottom_,       0, sizeof(bottom_));
+	memset(coeff_,        0, sizeof(coeff_));
+	memset(fricationTap_, 0, sizeof(fricationTap_));
+}
+
+/*******************************************************************************
+ * Calculates the two-way scattering junctions.
+ *
+ * For each junction i:
+ *     delta = coeff[i] * (prevTop[i] - prevBottom[i + 1])
+ *     top[i + 1] = (prevTop[i] + delta) * dampingFactor + fricationTap[i] * frication
+ *     bottom[i] = (prevBottom[i + 1] + delta) * dampingFactor
+ */
+template<typename FloatType>
+void
+ScatteringJunctionKernel<FloatType>::update(FloatType dampingFactor, FloatType frication)
+{
+	const FloatType* prevTop    = top_[current_ ^ 1];
+	const FloatType* prevBottom = bottom_[current_ ^ 1] + 1;
+	FloatType* top    = top_[current_] + 1;
+	FloatType* bottom = bottom_[current_];
+
+	for (int i = 0; i < NUM_SECTIONS; ++i) {
+		const FloatType delta = coeff_[i] * (prevTop[i] - prevBottom[i]);
+		top[i]    = ((prevTop[i] + delta) * dampingFactor) + (fricationTap_[i] * frication);
+		bottom[i] = (prevBottom[i] + delta) * dampingFactor;
+	}
+}
+
+#if defined(GS_TRM_AVX)
+
+template<>
+inline
+void
+ScatteringJunctionKernel<double>::update(double dampingFactor, double frication)
+{
+	const double* prevTop    = top_[current_ ^ 1];
+	const double* prevBottom = bottom_[current_ ^ 1] + 1;
+	double* top    = top_[current_] + 1;
+	double* bottom = bottom_[current_];
+	const __m256d damping = _mm256_set1_pd(dampingFactor);
+	const __m256d fric    = _mm256_set1_pd(frication);
+
+	for (int i = 0; i < NUM_SECTIONS; i += 4) {
+		const __m256d t = _mm256_loadu_pd(prevTop + i);
+		const __m256d b = _mm256_loadu_pd(prevBottom + i);
+		const __m256d delta = _mm256_mul_pd(_mm256_loadu_pd(coeff_ + i), _mm256_sub_pd(t, b));
+		_mm256_storeu_pd(top + i, _mm256_add_pd(
+					_mm256_mul_pd(_mm256_add_pd(t, delta), damping),
+					_mm256_mul_pd(_mm256_loadu_pd(fricationTap_ + i), fric)));
+		_mm256_storeu_pd(bottom + i, _mm256_mul_pd(_mm256_add_pd(b, delta), damping));
+	}
+}
+
+template<>
+inline
+void
+ScatteringJunctionKernel<float>::update(float dampingFactor, float frication)
+{
+	const float* prevTop    = top_[current_ ^ 1];
+	const float* prevBottom = bottom_[current_ ^ 1] + 1;
+	float* top    = top_[current_] + 1;
+	float* bottom = bottom_[current_];
+	const __m256 damping = _mm256_set1_ps(dampingFactor);
+	const __m256 fric    = _mm256_set1_ps(frication);
+
+	for (int i = 0; i < NUM_SECTIONS; i += 8) {
+		const __m256 t = _mm256_loadu_ps(prevTop + i);
+		const __m256 b = _mm256_loadu_ps(prevBottom + i);
+		const __m256 delta = _mm256_mul_ps(_mm256_loadu_ps(coeff_ + i), _mm256_sub_ps(t, b));
+		_mm256_storeu_ps(top + i, _mm256_add_ps(
+					_mm256_mul_ps(_mm256_add_ps(t, delta), damping),
+					_mm256_mul_ps(_mm256_loadu_ps(fricationTap_ + i), fric)));
+		_mm256_storeu_ps(bottom + i, _mm256_mul_ps(_mm256_add_ps(b, delta), damping));
+	}
+}
+
+#elif defined(GS_TRM_SSE2)
+
+template<>
+inline
+void
+ScatteringJunctionKernel<double>::update(double dampingFactor, double frication)
+{
+	const double* prevTop    = top_[current_ ^ 1];
+	const double* prevBottom = bottom_[current_ ^ 1] + 1;
+	double* top    = top_[current_] + 1;
+	double* bottom = bottom_[current_];
+	const __m128d damping = _mm_set1_pd(dampingFactor);
+	const __m128d fric    = _mm_set1_pd(frication);
+
+	for (int i = 0; i < NUM_SECTIONS; i += 2) {
+		const __m128d t = _mm_loadu_pd(prevTop + i);
+		const __m128d b = _mm_loadu_pd(prevBottom + i);
+		const __m128d delta = _mm_mul_pd(_mm_loadu_pd(coeff_ + i), _mm_sub_pd(t, b));
+		_mm_storeu_pd(top + i, _mm_add_pd(
+					_mm_mul_pd(_mm_add_pd(t, delta), damping),
+					_mm_mul_pd(_mm_loadu_pd(fricationTap_ + i), fric)));
+		_mm_storeu_pd(bottom + i, _mm_mul_pd(_mm_add_pd(b, delta), damping));
+	}
+}
+
+template<>
+inline
+void
+ScatteringJunctionKernel<float>::update(float dampingFactor, float frication)
+{
+	const float* prevTop    = top_[current_ ^ 1];
+	const float* prevBottom = bottom_[current_ ^ 1] + 1;
+	float* top    = top_[current_] + 1;
+	float* bottom = bottom_[current_];
+	const __m128 damping = _mm_set1_ps(dampingFactor);
+	const __m128 fric    = _mm_set1_ps(frication);
+
+	for (int i = 0; i < NUM_SECTIONS; i += 4) {
+		const __m128 t = _mm_loadu_ps(prevTop + i);
+		const __m128 b = _mm_loadu_ps(prevBottom + i);
+		const __m128 delta = _mm_mul_ps(_mm_loadu_ps(coeff_ + i), _mm_sub_ps(t, b));
+		_mm_storeu_ps(top + i, _mm_add_ps(
+					_mm_mul_ps(_mm_add_ps(t, delta), damping),
+					_mm_mul_ps(_mm_loadu_ps(fricationTap_ + i), fric)));
+		_mm_storeu_ps(bottom + i, _mm_mul_ps(_mm_add_ps(b, delta), damping));
+	}
+}
+
+#endif
+
+} /* namespace TRM */
+} /* namespace GS */
+
+#endif /* TRM_SCATTERING_JUNCTION_KERNEL_H_ */
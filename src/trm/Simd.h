@@ -0,0 +1,121 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+#ifndef TRM_SIMD_H_
+#define TRM_SIMD_H_
+
+// Defines GS_TRM_AVX or GS_TRM_SSE2 if the instructions are enabled by the
+// compiler flags, unless GS_TRM_NO_SIMD is defined.
+#ifndef GS_TRM_NO_SIMD
+# if defined(__AVX__)
+#  include <immintrin.h>
+#  define GS_TRM_AVX 1
+# elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define GS_TRM_SSE2 1
+# endif
+#endif
+
+
+
+namespace GS {
+namespace TRM {
+
+// The arrays passed to dotProduct() are processed in blocks of SIZE elements.
+template<typename FloatType>
+struct DotProductBlock {
+	enum {
+		SIZE = 32 / sizeof(FloatType)
+	};
+};
+
+/*******************************************************************************
+ * Returns the sum of x[i] * h[i]. n must be a multiple of 4.
+ */
+inline
+double
+dotProduct(const double* x, const double* h, unsigned int n)
+{
+#if defined(GS_TRM_AVX)
+	__m256d sum = _mm256_setzero_pd();
+	for (unsigned int i = 0; i < n; i += 4) {
+		sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(h + i)));
+	}
+	__m128d sum2 = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+	return _mm_cvtsd_f64(_mm_add_sd(sum2, _mm_unpackhi_pd(sum2, sum2)));
+#elif defined(GS_TRM_SSE2)
+	__m128d sum0 = _mm_setzero_pd();
+	__m128d sum1 = _mm_setzero_pd();
+	for (unsigned int i = 0; i < n; i += 4) {
+		sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(x + i    ), _mm_loadu_pd(h + i    )));
+		sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(h + i + 2)));
+	}
+	__m128d sum2 = _mm_add_pd(sum0, sum1);
+	return _mm_cvtsd_f64(_mm_add_sd(sum2, _mm_unpackhi_pd(sum2, sum2)));
+#else
+	double sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+	for (unsigned int i = 0; i < n; i += 4) {
+		sum0 += x[i    ] * h[i    ];
+		sum1 += x[i + 1] * h[i + 1];
+		sum2 += x[i + 2] * h[i + 2];
+		sum3 += x[i + 3] * h[i + 3];
+	}
+	return (sum0 + sum2) + (sum1 + sum3);
+#endif
+}
+
+/*******************************************************************************
+ * Returns the sum of x[i] * h[i]. n must be a multiple of 8.
+ */
+inline
+float
+dotProduct(const float* x, const float* h, unsigned int n)
+{
+#if defined(GS_TRM_AVX)
+	__m256 sum = _mm256_setzero_ps();
+	for (unsigned int i = 0; i < n; i += 8) {
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(h + i)));
+	}
+	__m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+	__m128 sum2 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+	return _mm_cvtss_f32(_mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, 1)));
+#elif defined(GS_TRM_SSE2)
+	__m128 sum0 = _mm_setzero_ps();
+	__m128 sum1 = _mm_setzero_ps();
+	for (unsigned int i = 0; i < n; i += 8) {
+		sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(x + i    ), _mm_loadu_ps(h + i    )));
+		sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(x + i + 4), _mm_loadu_ps(h + i + 4)));
+	}
+	__m128 sum4 = _mm_add_ps(sum0, sum1);
+	__m128 sum2 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+	return _mm_cvtss_f32(_mm_add_ss(sum2, _mm_shuffle_ps(sum2, sum2, 1)));
+#else
+	float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+	for (unsigned int i = 0; i < n; i += 4) {
+		sum0 += x[i    ] * h[i    ];
+		sum1 += x[i + 1] * h[i + 1];
+		sum2 += x[i + 2] * h[i + 2];
+		sum3 += x[i + 3] * h[i + 3];
+	}
+	return (sum0 + sum2) + (sum1 + sum3);
+#endif
+}
+
+} /* namespace TRM */
+} /* namespace GS */
+
+#endif /* TRM_SIMD_H_ */
@@ -44,6 +44,9 @@ Configuration::Configuration()
 		, throatVol(0.0)
 		, modulation(0)
 		, mixOffset(0.0)
+		, coefficientUpdatePeriod(1)
+		, sampleRateConverterQuality(SampleRateConverterBase::QUALITY_DEFAULT)
+		, glottalSourceOscillator(WavetableGlottalSourceBase::OSCILLATOR_OVERSAMPLING)
 		, glottalPulseTp(0.0)
 		, glottalPulseTnMin(0.0)
 		, glottalPulseTnMax(0.0)
@@ -66,7 +69,8 @@ Configuration::load(const std::string& configFilePath, const std::string& voiceF
 	KeyValueFileReader reader(configFilePath);
 	KeyValueFileReader voiceReader(voiceFilePath);
 
-	outputRate    = reader.value<double>("output_rate");
+	outputRate    = reader.value<double>("output_rate",
+				SampleRateConverterBase::MIN_OUTPUT_RATE, SampleRateConverterBase::MAX_OUTPUT_RATE);
 	volume        = reader.value<double>("volume");
 	channels      = reader.value<int>("channels");
 	balance       = reader.value<double>("balance");
@@ -82,6 +86,17 @@ Configuration::load(const std::string& configFilePath, const std::string& voiceF
 	throatVol     = reader.value<double>("throat_volume");
 	modulation    = reader.value<int>("noise_modulation");
 	mixOffset     = reader.value<double>("mix_offset");
+	if (reader.hasKey("coefficient_update_period")) {
+		coefficientUpdatePeriod = reader.value<int>("coefficient_update_period", 1, 256);
+	}
+	if (reader.hasKey("sample_rate_converter_quality")) {
+		sampleRateConverterQuality = reader.value<int>("sample_rate_converter_quality",
+						SampleRateConverterBase::QUALITY_FAST, SampleRateConverterBase::QUALITY_HIGH);
+	}
+	if (reader.hasKey("glottal_source_oscillator")) {
+		glottalSourceOscillator = reader.value<int>("glottal_source_oscillator",
+						WavetableGlottalSourceBase::OSCILLATOR_OVERSAMPLING, WavetableGlottalSourceBase::OSCILLATOR_BAND_LIMITED);
+	}
 
 	const double globalRadiusCoef     = voiceReader.value<double>("global_radius_coef");
 	const double globalNoseRadiusCoef = voiceReader.value<double>("global_nose_radius_coef");
@@ -35,7 +35,7 @@ struct Configuration {
 
 	void load(const std::string& configFilePath, const std::string& voiceFilePath);
 
-	double outputRate;                   /*  output sample rate (22.05, 44.1)  */
+	double outputRate;                   /*  output sample rate (8000 - 96000 Hz)  */
 
 	double volume;                       /*  master volume (0 - 60 dB)  */
 	int    channels;                     /*  # of sound output channels (1, 2)  */
@@ -56,6 +56,10 @@ struct Configuration {
 	int    modulation;                   /*  pulse mod. of noise (0=OFF, 1=ON)  */
 	double mixOffset;                    /*  noise crossmix offset (30 - 60 dB)  */
 
+	int    coefficientUpdatePeriod;      /*  samples between updates of the coefficients (1 = every sample)  */
+	int    sampleRateConverterQuality;   /*  SampleRateConverterBase::Quality  */
+	int    glottalSourceOscillator;      /*  WavetableGlottalSourceBase::Oscillator  */
+
 	// Parameters that depend on the voice.
 	double glottalPulseTp;               /*  % glottal pulse rise time  */
 	double glottalPulseTnMin;            /*  % glottal pulse fall time minimum  */
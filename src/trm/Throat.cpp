@@ -25,24 +25,28 @@
 namespace GS {
 namespace TRM {
 
-Throat::Throat(double sampleRate, double throatCutoff, double throatGain)
-		: throatGain_(throatGain)
+template<typename FloatType>
+Throat<FloatType>::Throat(double sampleRate, double throatCutoff, double throatGain)
+		: throatGain_(static_cast<FloatType>(throatGain))
 		, throatY_(0.0)
 {
 	// Initializes the throat lowpass filter coefficients
 	// according to the throatCutoff value, and also the
 	// throatGain, according to the throatVol value.
 
-	ta0_ = (throatCutoff * 2.0) / sampleRate;
-	tb1_ = 1.0 - ta0_;
+	const double ta0 = (throatCutoff * 2.0) / sampleRate;
+	ta0_ = static_cast<FloatType>(ta0);
+	tb1_ = static_cast<FloatType>(1.0 - ta0);
 }
 
-Throat::~Throat()
+template<typename FloatType>
+Throat<FloatType>::~Throat()
 {
 }
 
+template<typename FloatType>
 void
-Throat::reset()
+Throat<FloatType>::reset()
 {
 	throatY_ = 0.0;
 }
@@ -57,13 +61,18 @@ Throat::reset()
 *             second term, since tb1 has reversed sign.
 *
 ******************************************************************************/
-double
-Throat::process(double input)
+template<typename FloatType>
+FloatType
+Throat<FloatType>::process(FloatType input)
 {
-	double output = (ta0_ * input) + (tb1_ * throatY_);
+	FloatType output = (ta0_ * input) + (tb1_ * throatY_);
 	throatY_ = output;
 	return output * throatGain_;
 }
 
+// Explicit instantiation.
+template class Throat<float>;
+template class Throat<double>;
+
 } /* namespace TRM */
 } /* namespace GS */
@@ -26,21 +26,22 @@
 namespace GS {
 namespace TRM {
 
+template<typename FloatType>
 class Throat {
 public:
 	Throat(double sampleRate, double throatCutoff, double throatGain);
 	~Throat();
 
 	void reset();
-	double process(double input);
+	FloatType process(FloatType input);
 private:
 	Throat(const Throat&) = delete;
 	Throat& operator=(const Throat&) = delete;
 
-	double tb1_;
-	double ta0_;
-	double throatGain_;
-	double throatY_;
+	FloatType tb1_;
+	FloatType ta0_;
+	FloatType throatGain_;
+	FloatType throatY_;
 };
 
 } /* namespace TRM */
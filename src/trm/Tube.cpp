@@ -43,6 +43,7 @@
 #include <utility> /* move */
 
 #include "Exception.h"
+#include "FastMath.h"
 #include "Log.h"
 #include "Text.h"
 #include "WAVEFileWriter.h"
@@ -50,8 +51,8 @@
 /*  COMPILE SO THAT INTERPOLATION NOT DONE FOR SOME CONTROL RATE PARAMETERS  */
 //#define MATCH_DSP                 1
 
-#define INPUT_VECTOR_RESERVE 128
 #define OUTPUT_VECTOR_RESERVE 1024
+#define OUTPUT_BLOCK_SIZE 1024
 
 #define GLOTTAL_SOURCE_PULSE 0
 #define GLOTTAL_SOURCE_SINE 1
@@ -72,10 +73,6 @@
 /*  FINAL OUTPUT SCALING, SO THAT .SND FILES APPROX. MATCH DSP OUTPUT  */
 #define OUTPUT_SCALE              0.95
 
-/*  BI-DIRECTIONAL TRANSMISSION LINE POINTERS  */
-#define TOP                       0
-#define BOTTOM                    1
-
 //#define OUTPUT_SRATE_LOW          22050.0
 //#define OUTPUT_SRATE_HIGH         44100.0
 
@@ -84,11 +81,14 @@
 namespace GS {
 namespace TRM {
 
+static_assert(static_cast<int>(ControlFrameBuffer::NUM_PARAMETERS) == Tube::PARAM_VELUM + 1, "Wrong number of parameters in ControlFrameBuffer.");
+static_assert(static_cast<int>(ControlFrameBuffer::NUM_NOSE_SECTIONS) == Tube::TOTAL_NASAL_SECTIONS, "Wrong number of nose sections in ControlFrameBuffer.");
+
 Tube::Tube()
 {
 	reset();
 
-	inputData_.reserve(INPUT_VECTOR_RESERVE);
+	memset(&componentParameters_, 0, sizeof(ComponentParameters));
 	outputData_.reserve(OUTPUT_VECTOR_RESERVE);
 }
 
@@ -120,28 +120,43 @@ Tube::reset()
 	throatVol_        = 0.0;
 	modulation_       = 0;
 	mixOffset_        = 0.0;
+	coefficientUpdatePeriod_ = 1;
+	sampleRateConverterQuality_ = SampleRateConverterBase::QUALITY_DEFAULT;
+	glottalSourceOscillator_ = WavetableGlottalSourceBase::OSCILLATOR_OVERSAMPLING;
 	controlPeriod_    = 0;
 	sampleRate_       = 0;
 	actualTubeLength_ = 0.0;
-	memset(&oropharynx_[0][0][0], 0, sizeof(double) * TOTAL_SECTIONS * 2 * 2);
+	junctions_.reset();
 	memset(oropharynxCoeff_,      0, sizeof(double) * TOTAL_COEFFICIENTS);
-	memset(&nasal_[0][0][0],      0, sizeof(double) * TOTAL_NASAL_SECTIONS * 2 * 2);
 	memset(nasalCoeff_,           0, sizeof(double) * TOTAL_NASAL_COEFFICIENTS);
 	memset(alpha_,                0, sizeof(double) * TOTAL_ALPHA_COEFFICIENTS);
-	currentPtr_ = 1;
-	prevPtr_    = 0;
 	memset(fricationTap_, 0, sizeof(double) * TOTAL_FRIC_COEFFICIENTS);
 	dampingFactor_     = 0.0;
 	crossmixFactor_    = 0.0;
 	breathinessFactor_ = 0.0;
 	prevGlotAmplitude_ = -1.0;
-	inputData_.resize(0);
+	coefficientUpdateCount_ = 0;
+	glotFrequency_     = 0.0;
+	glotAmplitude_     = 0.0;
+	aspAmplitude_      = 0.0;
+	wavetableAmplitude_ = 0.0;
+	coefficientTargetValid_ = false;
+	memset(coefficient_,       0, sizeof(double) * TOTAL_INTERPOLATED_COEFFICIENTS);
+	memset(coefficientDelta_,  0, sizeof(double) * TOTAL_INTERPOLATED_COEFFICIENTS);
+	memset(coefficientTarget_, 0, sizeof(double) * TOTAL_INTERPOLATED_COEFFICIENTS);
 	memset(&currentData_, 0, sizeof(CurrentData));
 	memset(&singleInput_, 0, sizeof(InputData));
 	outputDataPos_ = 0;
 	outputData_.resize(0);
-
-	if (srConv_) srConv_->reset();
+	controlPos_ = 0;
+	streamOutputPos_ = 0;
+	segmentOutput_ = nullptr;
+
+	if (srConv_) {
+		srConv_->setOutput(outputData_);
+		srConv_->setOutputGain(1.0f);
+		srConv_->reset();
+	}
 	if (mouthRadiationFilter_) mouthRadiationFilter_->reset();
 	if (mouthReflectionFilter_) mouthReflectionFilter_->reset();
 	if (nasalRadiationFilter_) nasalRadiationFilter_->reset();
@@ -157,29 +172,164 @@ Tube::reset()
 void
 Tube::synthesizeToFile(std::istream& inputStream, const char* outputFile)
 {
-	if (!outputData_.empty()) {
+	ControlFrameBuffer input;
+	input.read(inputStream);
+	synthesizeToFile(input, outputFile);
+}
+
+void
+Tube::synthesizeToBuffer(std::istream& inputStream, std::vector<float>& outputBuffer)
+{
+	ControlFrameBuffer input;
+	input.read(inputStream);
+	synthesizeToBuffer(input, outputBuffer);
+}
+
+void
+Tube::synthesizeToFile(const ControlFrameBuffer& input, const char* outputFile)
+{
+	if (srConv_) {
 		reset();
 	}
-	parseInputStream(inputStream);
+	loadInputHeader(input.header());
 	initializeSynthesizer();
+	prepareOutput(input.size(), nullptr);
 #if 0
 	if (Log::debugEnabled) {
-		printInfo(inputFile);
+		printInfo(inputFile, input);
 	}
 #endif
-	synthesizeForInputSequence();
+	synthesizeForInputSequence(input);
 	writeOutputToFile(outputFile);
 }
 
 void
-Tube::synthesizeToBuffer(std::istream& inputStream, std::vector<float>& outputBuffer)
+Tube::synthesizeToBuffer(const ControlFrameBuffer& input, std::vector<float>& outputBuffer)
 {
-	if (!outputData_.empty()) {
+	if (srConv_) {
 		reset();
 	}
-	parseInputStream(inputStream);
+	loadInputHeader(input.header());
 	initializeSynthesizer();
-	synthesizeForInputSequence();
+	prepareOutput(input.size(), &outputBuffer);
+	synthesizeForInputSequence(input);
+	writeOutputToBuffer(outputBuffer);
+}
+
+/*******************************************************************************
+ * Starts a streaming synthesis.
+ *
+ * The samples are sent to the callback in blocks, as soon as they are
+ * synthesized. Because the whole utterance is not available, the output
+ * can not be normalized by the maximum sample value. With
+ * STREAM_GAIN_FIXED the scale is calculated using referencePeak, and the
+ * samples may clip. With STREAM_GAIN_LOOK_AHEAD the output is delayed by
+ * lookAhead sample frames, and the scale is calculated using the maximum
+ * of referencePeak and the absolute values of all the samples synthesized
+ * so far. The scale never increases, and the samples do not clip.
+ */
+void
+Tube::beginStream(const ControlFrameBuffer::Header& header, const StreamParameters& parameters, StreamCallback callback)
+{
+	if (parameters.blockSize == 0) {
+		THROW_EXCEPTION(InvalidParameterException, "Invalid stream block size: " << parameters.blockSize << '.');
+	}
+	if (parameters.referencePeak <= 0.0) {
+		THROW_EXCEPTION(InvalidParameterException, "Invalid stream reference peak: " << parameters.referencePeak << '.');
+	}
+
+	reset();
+	loadInputHeader(header);
+	initializeSynthesizer();
+
+	streamParameters_ = parameters;
+	streamCallback_ = callback;
+	controlPos_ = 1;
+	streamOutputPos_ = 0;
+
+	/*  WITH A FIXED MONO GAIN THE CONVERTER OUTPUT IS SENT WITHOUT A COPY  */
+	if (streamGainFused()) {
+		srConv_->setOutputGain(calculateMonoScale(streamParameters_.referencePeak));
+	}
+}
+
+/*******************************************************************************
+ * Synthesizes all the input tables that have a successor in the input.
+ */
+void
+Tube::synthesizeStream(const ControlFrameBuffer& input)
+{
+	if (!streamCallback_) {
+		THROW_EXCEPTION(InvalidStateException, "The stream has not been started.");
+	}
+
+	for (std::size_t size = input.size(); controlPos_ < size; ++controlPos_) {
+		synthesizeControlPeriod(input, controlPos_);
+	}
+	writeOutputToStream(false);
+}
+
+/*******************************************************************************
+ * Synthesizes the remaining input tables and sends all the pending samples.
+ */
+void
+Tube::endStream(const ControlFrameBuffer& input)
+{
+	if (!streamCallback_) {
+		THROW_EXCEPTION(InvalidStateException, "The stream has not been started.");
+	}
+
+	for (std::size_t size = input.size(); controlPos_ <= size; ++controlPos_) {
+		synthesizeControlPeriod(input, controlPos_);
+	}
+
+	/*  BE SURE TO FLUSH SRC BUFFER  */
+	srConv_->flushBuffer();
+
+	LOG_DEBUG("\nNumber of samples: " << srConv_->numberSamples() <<
+			"\nMaximum sample value: " << srConv_->maximumSampleValue());
+
+	writeOutputToStream(true);
+
+	streamCallback_ = nullptr;
+}
+
+void
+Tube::beginSynthesis(const ControlFrameBuffer::Header& header, std::vector<float>* outputBuffer)
+{
+	reset();
+	loadInputHeader(header);
+	initializeSynthesizer();
+	prepareOutput(0, outputBuffer);
+	controlPos_ = 1;
+}
+
+/*******************************************************************************
+ * Synthesizes all the input tables that have a successor in the input.
+ */
+void
+Tube::synthesizeFrames(const ControlFrameBuffer& input)
+{
+	for (std::size_t size = input.size(); controlPos_ < size; ++controlPos_) {
+		synthesizeControlPeriod(input, controlPos_);
+	}
+}
+
+void
+Tube::finishToFile(const ControlFrameBuffer& input, const char* outputFile)
+{
+	for (std::size_t size = input.size(); controlPos_ <= size; ++controlPos_) {
+		synthesizeControlPeriod(input, controlPos_);
+	}
+	writeOutputToFile(outputFile);
+}
+
+void
+Tube::finishToBuffer(const ControlFrameBuffer& input, std::vector<float>& outputBuffer)
+{
+	for (std::size_t size = input.size(); controlPos_ <= size; ++controlPos_) {
+		synthesizeControlPeriod(input, controlPos_);
+	}
 	writeOutputToBuffer(outputBuffer);
 }
 
@@ -191,7 +341,7 @@ Tube::synthesizeToBuffer(std::istream& inputStream, std::vector<float>& outputBu
 *
 ******************************************************************************/
 void
-Tube::printInfo(const char* inputFile)
+Tube::printInfo(const char* inputFile, const ControlFrameBuffer& input)
 {
 	/*  PRINT INPUT FILE NAME  */
 	printf("input file:\t\t%s\n\n", inputFile);
@@ -252,7 +402,7 @@ Tube::printInfo(const char* inputFile)
 #endif
 
 	/*  ECHO TABLE VALUES  */
-	printf("\n%-ld control rate input tables:\n\n", inputData_.size() - 1);
+	printf("\n%-ld control rate input tables:\n\n", input.size());
 
 	/*  HEADER  */
 	printf("glPitch");
@@ -268,220 +418,64 @@ Tube::printInfo(const char* inputFile)
 	printf("\tvelum\n");
 
 	/*  ACTUAL VALUES  */
-	for (int i = 0; i < static_cast<int>(inputData_.size()) - 1; ++i) {
-		printf("%.2f"  , inputData_[i]->glotPitch);
-		printf("\t%.2f", inputData_[i]->glotVol);
-		printf("\t%.2f", inputData_[i]->aspVol);
-		printf("\t%.2f", inputData_[i]->fricVol);
-		printf("\t%.2f", inputData_[i]->fricPos);
-		printf("\t%.2f", inputData_[i]->fricCF);
-		printf("\t%.2f", inputData_[i]->fricBW);
-		for (int j = 0; j < TOTAL_REGIONS; ++j) {
-			printf("\t%.2f", inputData_[i]->radius[j]);
+	for (std::size_t i = 0, size = input.size(); i < size; ++i) {
+		printf("%.2f", input.value(PARAM_GLOT_PITCH, i));
+		for (int j = PARAM_GLOT_VOL; j <= PARAM_VELUM; ++j) {
+			printf("\t%.2f", input.value(j, i));
 		}
-		printf("\t%.2f\n", inputData_[i]->velum);
+		printf("\n");
 	}
 	printf("\n");
 }
 
 /******************************************************************************
 *
-*  function:  parseInputStream
+*  function:  loadInputHeader
 *
-*  purpose:   Parses the input stream and assigns values to global
+*  purpose:   Assigns the utterance parameters to the member
 *             variables.
 *
 ******************************************************************************/
 void
-Tube::parseInputStream(std::istream& in)
+Tube::loadInputHeader(const ControlFrameBuffer::Header& header)
 {
-	std::string line;
-
-	/*  GET THE OUTPUT SAMPLE RATE  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read output sample rate.");
-	} else {
-		outputRate_ = Text::parseString<float>(line);
-	}
-
-	/*  GET THE INPUT CONTROL RATE  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read input control rate.");
-	} else {
-		controlRate_ = Text::parseString<float>(line);
-	}
-
-	/*  GET THE MASTER VOLUME  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read master volume.");
-	} else {
-		volume_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE NUMBER OF SOUND OUTPUT CHANNELS  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read number of sound output channels.");
-	} else {
-		channels_ = Text::parseString<int>(line);
-	}
-
-	/*  GET THE STEREO BALANCE  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read stereo balance.");
-	} else {
-		balance_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE GLOTTAL SOURCE WAVEFORM TYPE  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read glottal source waveform type.");
-	} else {
-		waveform_ = Text::parseString<int>(line);
-	}
-
-	/*  GET THE GLOTTAL PULSE RISE TIME (tp)  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read glottal pulse rise time (tp).");
-	} else {
-		tp_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE GLOTTAL PULSE FALL TIME MINIMUM (tnMin)  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read glottal pulse fall time minimum (tnMin).");
-	} else {
-		tnMin_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE GLOTTAL PULSE FALL TIME MAXIMUM (tnMax)  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read glottal pulse fall time maximum (tnMax).");
-	} else {
-		tnMax_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE GLOTTAL SOURCE BREATHINESS  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read glottal source breathiness.");
-	} else {
-		breathiness_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE NOMINAL TUBE LENGTH  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read nominal tube length.");
-	} else {
-		length_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE TUBE TEMPERATURE  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read tube temperature.");
-	} else {
-		temperature_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE JUNCTION LOSS FACTOR  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read junction loss factor.");
-	} else {
-		lossFactor_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE APERTURE SCALING RADIUS  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read aperture scaling radius.");
-	} else {
-		apertureRadius_ = Text::parseString<double>(line);
-	}
+	outputRate_     = header.outputRate;
+	controlRate_    = header.controlRate;
+	volume_         = header.volume;
+	channels_       = header.channels;
+	balance_        = header.balance;
+	waveform_       = header.waveform;
+	tp_             = header.tp;
+	tnMin_          = header.tnMin;
+	tnMax_          = header.tnMax;
+	breathiness_    = header.breathiness;
+	length_         = header.length;
+	temperature_    = header.temperature;
+	lossFactor_     = header.lossFactor;
+	apertureRadius_ = header.apertureRadius;
+	mouthCoef_      = header.mouthCoef;
+	noseCoef_       = header.noseCoef;
 
-	/*  GET THE MOUTH APERTURE COEFFICIENT  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read mouth aperture coefficient.");
-	} else {
-		mouthCoef_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE NOSE APERTURE COEFFICIENT  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read nose aperture coefficient.");
-	} else {
-		noseCoef_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE NOSE RADII  */
 	noseRadius_[0] = 0.0;
 	for (int i = 1; i < TOTAL_NASAL_SECTIONS; i++) {
-		if (!std::getline(in, line)) {
-			THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read nose radius " << i << '.');
-		} else {
-			noseRadius_[i] = std::max(Text::parseString<double>(line), GS_TRM_TUBE_MIN_RADIUS);
-		}
+		noseRadius_[i] = std::max(header.noseRadius[i], GS_TRM_TUBE_MIN_RADIUS);
 	}
 
-	/*  GET THE THROAT LOWPASS FREQUENCY CUTOFF  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read throat lowpass filter cutoff.");
-	} else {
-		throatCutoff_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE THROAT VOLUME  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read throat volume.");
-	} else {
-		throatVol_ = Text::parseString<double>(line);
+	throatCutoff_   = header.throatCutoff;
+	throatVol_      = header.throatVol;
+	modulation_     = header.modulation;
+	mixOffset_      = header.mixOffset;
+	coefficientUpdatePeriod_ = std::max(header.coefficientUpdatePeriod, 1);
+	if (outputRate_ < SampleRateConverterBase::MIN_OUTPUT_RATE || outputRate_ > SampleRateConverterBase::MAX_OUTPUT_RATE) {
+		THROW_EXCEPTION(TRMException, "Invalid output sample rate: " << outputRate_ << '.');
 	}
-
-	/*  GET THE PULSE MODULATION OF NOISE FLAG  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read pulse modulation of noise flag.");
-	} else {
-		modulation_ = Text::parseString<int>(line);
+	sampleRateConverterQuality_ = header.sampleRateConverterQuality;
+	if (sampleRateConverterQuality_ < SampleRateConverterBase::QUALITY_FAST || sampleRateConverterQuality_ > SampleRateConverterBase::QUALITY_HIGH) {
+		THROW_EXCEPTION(TRMException, "Invalid sample rate converter quality: " << sampleRateConverterQuality_ << '.');
 	}
-
-	/*  GET THE NOISE CROSSMIX OFFSET  */
-	if (!std::getline(in, line)) {
-		THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read noise crossmix offset.");
-	} else {
-		mixOffset_ = Text::parseString<double>(line);
-	}
-
-	/*  GET THE INPUT TABLE VALUES  */
-	unsigned int paramNumber = 0;
-	while (std::getline(in, line)) {
-		std::istringstream lineStream(line);
-		std::unique_ptr<InputData> data(new InputData());
-
-		/*  GET EACH PARAMETER  */
-		lineStream >>
-			data->glotPitch >>
-			data->glotVol >>
-			data->aspVol >>
-			data->fricVol >>
-			data->fricPos >>
-			data->fricCF >>
-			data->fricBW;
-		for (int i = 0; i < TOTAL_REGIONS; i++) {
-			double radius;
-			lineStream >> radius;
-			data->radius[i] = std::max(radius, GS_TRM_TUBE_MIN_RADIUS);
-		}
-		lineStream >> data->velum;
-
-		if (!lineStream) {
-			THROW_EXCEPTION(TRMException, "Error in tube input parsing: Could not read parameters (number " << paramNumber << ").");
-		}
-
-		inputData_.push_back(std::move(data));
-		++paramNumber;
-	}
-
-	/*  DOUBLE UP THE LAST INPUT TABLE, TO HELP INTERPOLATION CALCULATIONS  */
-	if (!inputData_.empty()) {
-		std::unique_ptr<InputData> lastData(new InputData());
-		*lastData = *inputData_.back();
-		inputData_.push_back(std::move(lastData));
+	glottalSourceOscillator_ = header.glottalSourceOscillator;
+	if (glottalSourceOscillator_ < WavetableGlottalSourceBase::OSCILLATOR_OVERSAMPLING || glottalSourceOscillator_ > WavetableGlottalSourceBase::OSCILLATOR_BAND_LIMITED) {
+		THROW_EXCEPTION(TRMException, "Invalid glottal source oscillator: " << glottalSourceOscillator_ << '.');
 	}
 }
 
@@ -504,7 +498,9 @@ Tube::speedOfSound(double temperature)
 *  function:  initializeSynthesizer
 *
 *  purpose:   Initializes all variables so that the synthesis can
-*             be run.
+*             be run. The components that depend only on parameters
+*             that have not changed since the previous call are reset
+*             instead of created again.
 *
 ******************************************************************************/
 void
@@ -532,39 +528,114 @@ Tube::initializeSynthesizer()
 	/*  CALCULATE THE DAMPING FACTOR  */
 	dampingFactor_ = (1.0 - (lossFactor_ / 100.0));
 
+	coefficientUpdateCount_ = 0;
+	coefficientTargetValid_ = false;
+
+	/*  THE COMPONENTS OF THE PREVIOUS UTTERANCE ARE REUSED IF THEIR PARAMETERS HAVE NOT CHANGED  */
+	const ComponentParameters prev = componentParameters_;
+	const bool componentsValid = prev.sampleRate != 0;
+	const bool sameSampleRate = componentsValid && sampleRate_ == prev.sampleRate;
+
+	/*  THE PARAMETERS ARE VALID ONLY AFTER ALL THE COMPONENTS HAVE BEEN CREATED  */
+	componentParameters_.sampleRate = 0;
+
 	/*  INITIALIZE THE WAVE TABLE  */
-	glottalSource_.reset(new WavetableGlottalSource(
-				waveform_ == GLOTTAL_SOURCE_PULSE ?
-					WavetableGlottalSource::TYPE_PULSE :
-					WavetableGlottalSource::TYPE_SINE,
-				sampleRate_,
-				tp_, tnMin_, tnMax_));
+	if (sameSampleRate && waveform_ == prev.waveform && tp_ == prev.tp && tnMin_ == prev.tnMin && tnMax_ == prev.tnMax &&
+			glottalSourceOscillator_ == prev.glottalSourceOscillator) {
+		glottalSource_->reset();
+	} else {
+		glottalSource_.reset(new WavetableGlottalSource<SampleFloat>(
+					waveform_ == GLOTTAL_SOURCE_PULSE ?
+						WavetableGlottalSourceBase::TYPE_PULSE :
+						WavetableGlottalSourceBase::TYPE_SINE,
+					sampleRate_,
+					tp_, tnMin_, tnMax_,
+					static_cast<WavetableGlottalSourceBase::Oscillator>(glottalSourceOscillator_)));
+	}
 
 	/*  INITIALIZE REFLECTION AND RADIATION FILTER COEFFICIENTS FOR MOUTH  */
-	double mouthApertureCoeff = (nyquist - mouthCoef_) / nyquist;
-	mouthRadiationFilter_.reset(new RadiationFilter(mouthApertureCoeff));
-	mouthReflectionFilter_.reset(new ReflectionFilter(mouthApertureCoeff));
+	if (sameSampleRate && mouthCoef_ == prev.mouthCoef) {
+		mouthRadiationFilter_->reset();
+		mouthReflectionFilter_->reset();
+	} else {
+		double mouthApertureCoeff = (nyquist - mouthCoef_) / nyquist;
+		mouthRadiationFilter_.reset(new RadiationFilter<SampleFloat>(mouthApertureCoeff));
+		mouthReflectionFilter_.reset(new ReflectionFilter<SampleFloat>(mouthApertureCoeff));
+	}
 
 	/*  INITIALIZE REFLECTION AND RADIATION FILTER COEFFICIENTS FOR NOSE  */
-	double nasalApertureCoeff = (nyquist - noseCoef_) / nyquist;
-	nasalRadiationFilter_.reset(new RadiationFilter(nasalApertureCoeff));
-	nasalReflectionFilter_.reset(new ReflectionFilter(nasalApertureCoeff));
+	if (sameSampleRate && noseCoef_ == prev.noseCoef) {
+		nasalRadiationFilter_->reset();
+		nasalReflectionFilter_->reset();
+	} else {
+		double nasalApertureCoeff = (nyquist - noseCoef_) / nyquist;
+		nasalRadiationFilter_.reset(new RadiationFilter<SampleFloat>(nasalApertureCoeff));
+		nasalReflectionFilter_.reset(new ReflectionFilter<SampleFloat>(nasalApertureCoeff));
+	}
 
 	/*  INITIALIZE NASAL CAVITY FIXED SCATTERING COEFFICIENTS  */
 	initializeNasalCavity();
 
 	/*  INITIALIZE THE THROAT LOWPASS FILTER  */
-	throat_.reset(new Throat(sampleRate_, throatCutoff_, amplitude(throatVol_)));
+	if (sameSampleRate && throatCutoff_ == prev.throatCutoff && throatVol_ == prev.throatVol) {
+		throat_->reset();
+	} else {
+		throat_.reset(new Throat<SampleFloat>(sampleRate_, throatCutoff_, amplitude(throatVol_)));
+	}
 
 	/*  INITIALIZE THE SAMPLE RATE CONVERSION ROUTINES  */
-	srConv_.reset(new SampleRateConverter(sampleRate_, outputRate_, outputData_));
+	if (sameSampleRate && outputRate_ == prev.outputRate && sampleRateConverterQuality_ == prev.sampleRateConverterQuality) {
+		srConv_->setOutput(outputData_);
+		srConv_->setOutputGain(1.0f);
+		srConv_->reset();
+	} else {
+		srConv_.reset(new SampleRateConverter<SampleFloat>(sampleRate_, outputRate_, outputData_,
+					static_cast<SampleRateConverterBase::Quality>(sampleRateConverterQuality_)));
+	}
 
 	/*  INITIALIZE THE OUTPUT VECTOR  */
 	outputData_.clear();
 
-	bandpassFilter_.reset(new BandpassFilter());
-	noiseFilter_.reset(new NoiseFilter());
-	noiseSource_.reset(new NoiseSource());
+	if (componentsValid) {
+		bandpassFilter_->reset();
+		noiseFilter_->reset();
+		noiseSource_->reset();
+	} else {
+		bandpassFilter_.reset(new BandpassFilter<SampleFloat>());
+		noiseFilter_.reset(new NoiseFilter<SampleFloat>());
+		noiseSource_.reset(new NoiseSource());
+	}
+
+	componentParameters_.sampleRate                 = sampleRate_;
+	componentParameters_.outputRate                 = outputRate_;
+	componentParameters_.sampleRateConverterQuality = sampleRateConverterQuality_;
+	componentParameters_.waveform                   = waveform_;
+	componentParameters_.tp                         = tp_;
+	componentParameters_.tnMin                      = tnMin_;
+	componentParameters_.tnMax                      = tnMax_;
+	componentParameters_.glottalSourceOscillator    = glottalSourceOscillator_;
+	componentParameters_.mouthCoef                  = mouthCoef_;
+	componentParameters_.noseCoef                   = noseCoef_;
+	componentParameters_.throatCutoff               = throatCutoff_;
+	componentParameters_.throatVol                  = throatVol_;
+}
+
+/*******************************************************************************
+ * Selects the vector that receives the output samples, and reserves space
+ * for all the samples of an input with inputSize tables, so that the
+ * vector is not reallocated during the synthesis.
+ *
+ * If outputBuffer is not null, the sample rate converter writes directly
+ * to it, and writeOutputToBuffer scales the samples in place. Otherwise
+ * the samples are stored in outputData_.
+ */
+void
+Tube::prepareOutput(std::size_t inputSize, std::vector<float>* outputBuffer)
+{
+	std::vector<float>& output = outputBuffer ? *outputBuffer : outputData_;
+	output.clear();
+	output.reserve(srConv_->maximumOutputSamples(inputSize * controlPeriod_) * (outputBuffer ? channels_ : 1));
+	srConv_->setOutput(output);
 }
 
 void
@@ -581,20 +652,34 @@ Tube::initializeInputFilters(double period)
 *
 ******************************************************************************/
 void
-Tube::synthesizeForInputSequence()
+Tube::synthesizeForInputSequence(const ControlFrameBuffer& input)
 {
 	/*  CONTROL RATE LOOP  */
-	for (int i = 1, size = inputData_.size(); i < size; i++) {
-		/*  SET CONTROL RATE PARAMETERS FROM INPUT TABLES  */
-		setControlRateParameters(i);
-
-		/*  SAMPLE RATE LOOP  */
-		for (int j = 0; j < controlPeriod_; j++) {
-			synthesize();
+	for (std::size_t i = 1, size = input.size(); i <= size; i++) {
+		synthesizeControlPeriod(input, i);
+	}
+}
 
-			/*  DO SAMPLE RATE INTERPOLATION OF CONTROL PARAMETERS  */
-			sampleRateInterpolation();
+void
+Tube::synthesizeControlPeriod(const ControlFrameBuffer& input, std::size_t pos)
+{
+	/*  SET CONTROL RATE PARAMETERS FROM INPUT TABLES  */
+	setControlRateParameters(input, pos);
+
+	/*  SAMPLE RATE LOOP  */
+	for (int j = 0; j < controlPeriod_; j++) {
+		/*  UPDATE OR INTERPOLATE THE COEFFICIENTS  */
+		if (coefficientUpdateCount_ <= 0) {
+			updateCoefficients(std::min(coefficientUpdatePeriod_, controlPeriod_ - j));
+		} else {
+			interpolateCoefficients();
 		}
+		--coefficientUpdateCount_;
+
+		synthesize();
+
+		/*  DO SAMPLE RATE INTERPOLATION OF CONTROL PARAMETERS  */
+		sampleRateInterpolation();
 	}
 }
 
@@ -624,43 +709,173 @@ Tube::synthesizeForSingleInput(int numIterations)
 		currentData_.radius[7] = inputFilters_->radius7Filter.filter(  singleInput_.radius[7]);
 		currentData_.velum     = inputFilters_->velumFilter.filter(    singleInput_.velum);
 
+		updateCoefficients(1);
 		synthesize();
 	}
 }
 
+/******************************************************************************
+*
+*  function:  calculateCoefficients
+*
+*  purpose:   Converts the current parameters and calculates the
+*             coefficients.
+*
+******************************************************************************/
 void
-Tube::synthesize()
+Tube::calculateCoefficients()
 {
-	/*  CONVERT PARAMETERS HERE  */
-	double f0 = frequency(currentData_.glotPitch);
-	double ax = amplitude(currentData_.glotVol);
-	double ah1 = amplitude(currentData_.aspVol);
+	glotFrequency_ = frequency(currentData_.glotPitch);
+	glotAmplitude_ = amplitude(currentData_.glotVol);
+	aspAmplitude_  = amplitude(currentData_.aspVol);
 	calculateTubeCoefficients();
 	setFricationTaps();
 	bandpassFilter_->update(sampleRate_, currentData_.fricBW, currentData_.fricCF);
+}
+
+void
+Tube::getCoefficients(double* coef) const
+{
+	*coef++ = glotFrequency_;
+	*coef++ = glotAmplitude_;
+	*coef++ = aspAmplitude_;
+	for (int i = 0; i < TOTAL_COEFFICIENTS; i++) {
+		*coef++ = oropharynxCoeff_[i];
+	}
+	*coef++ = nasalCoeff_[NC1];
+	for (int i = 0; i < TOTAL_ALPHA_COEFFICIENTS; i++) {
+		*coef++ = alpha_[i];
+	}
+	for (int i = 0; i < TOTAL_FRIC_COEFFICIENTS; i++) {
+		*coef++ = fricationTap_[i];
+	}
+	bandpassFilter_->getCoefficients(coef);
+}
+
+void
+Tube::setCoefficients(const double* coef)
+{
+	glotFrequency_ = *coef++;
+	glotAmplitude_ = *coef++;
+	aspAmplitude_  = *coef++;
+	for (int i = 0; i < TOTAL_COEFFICIENTS; i++) {
+		oropharynxCoeff_[i] = *coef++;
+	}
+	nasalCoeff_[NC1] = *coef++;
+	for (int i = 0; i < TOTAL_ALPHA_COEFFICIENTS; i++) {
+		alpha_[i] = *coef++;
+	}
+	for (int i = 0; i < TOTAL_FRIC_COEFFICIENTS; i++) {
+		fricationTap_[i] = *coef++;
+	}
+	bandpassFilter_->setCoefficients(coef);
+	setJunctionCoefficients();
+}
+
+/******************************************************************************
+*
+*  function:  updateCoefficients
+*
+*  purpose:   Calculates the coefficients that will be used in the
+*             next numSamples samples. If numSamples > 1, the
+*             coefficients are calculated for the end of the block,
+*             and are linearly interpolated by interpolateCoefficients.
+*
+******************************************************************************/
+void
+Tube::updateCoefficients(int numSamples)
+{
+	coefficientUpdateCount_ = numSamples;
+
+	if (numSamples == 1) {
+		calculateCoefficients();
+		setJunctionCoefficients();
+		wavetableAmplitude_ = glotAmplitude_;
+		coefficientTargetValid_ = false;
+		return;
+	}
+
+	/*  COEFFICIENTS AT THE START OF THE BLOCK  */
+	if (coefficientTargetValid_) {
+		for (int i = 0; i < TOTAL_INTERPOLATED_COEFFICIENTS; i++) {
+			coefficient_[i] = coefficientTarget_[i];
+		}
+	} else {
+		calculateCoefficients();
+		getCoefficients(coefficient_);
+	}
+
+	/*  COEFFICIENTS AT THE END OF THE BLOCK  */
+	const CurrentData savedData = currentData_;
+	currentData_.glotPitch += currentData_.glotPitchDelta * numSamples;
+	currentData_.glotVol   += currentData_.glotVolDelta   * numSamples;
+	currentData_.aspVol    += currentData_.aspVolDelta    * numSamples;
+	currentData_.fricVol   += currentData_.fricVolDelta   * numSamples;
+	currentData_.fricPos   += currentData_.fricPosDelta   * numSamples;
+	currentData_.fricCF    += currentData_.fricCFDelta    * numSamples;
+	currentData_.fricBW    += currentData_.fricBWDelta    * numSamples;
+	for (int i = 0; i < TOTAL_REGIONS; i++) {
+		currentData_.radius[i] += currentData_.radiusDelta[i] * numSamples;
+	}
+	currentData_.velum     += currentData_.velumDelta     * numSamples;
+	calculateCoefficients();
+	getCoefficients(coefficientTarget_);
+	currentData_ = savedData;
+	coefficientTargetValid_ = true;
+
+	const double scale = 1.0 / numSamples;
+	/*  THE FREQUENCY IS AN EXPONENTIAL FUNCTION OF THE PITCH, AND IS INTERPOLATED  */
+	/*  WITH A CONSTANT RATIO (ERRORS IN THE FREQUENCY ACCUMULATE IN THE PHASE)  */
+	coefficientDelta_[0] = pow(coefficientTarget_[0] / coefficient_[0], scale);
+	for (int i = 1; i < TOTAL_INTERPOLATED_COEFFICIENTS; i++) {
+		coefficientDelta_[i] = (coefficientTarget_[i] - coefficient_[i]) * scale;
+	}
+	setCoefficients(coefficient_);
+
+	/*  THE WAVETABLE IS UPDATED ONLY ONCE PER BLOCK  */
+	wavetableAmplitude_ = glotAmplitude_;
+}
+
+void
+Tube::interpolateCoefficients()
+{
+	coefficient_[0] *= coefficientDelta_[0];
+	for (int i = 1; i < TOTAL_INTERPOLATED_COEFFICIENTS; i++) {
+		coefficient_[i] += coefficientDelta_[i];
+	}
+	setCoefficients(coefficient_);
+}
+
+void
+Tube::synthesize()
+{
+	/*  PARAMETERS CONVERTED IN updateCoefficients  */
+	const double f0 = glotFrequency_;
+	const double ax = glotAmplitude_;
+	const double ah1 = aspAmplitude_;
 
 	/*  DO SYNTHESIS HERE  */
 	/*  CREATE LOW-PASS FILTERED NOISE  */
-	double lpNoise = noiseFilter_->filter(noiseSource_->getSample());
+	SampleFloat lpNoise = noiseFilter_->filter(static_cast<SampleFloat>(noiseSource_->getSample()));
 
 	/*  UPDATE THE SHAPE OF THE GLOTTAL PULSE, IF NECESSARY  */
 	if (waveform_ == GLOTTAL_SOURCE_PULSE) {
-		if (ax != prevGlotAmplitude_) {
-			glottalSource_->updateWavetable(ax);
+		if (wavetableAmplitude_ != prevGlotAmplitude_) {
+			glottalSource_->updateWavetable(wavetableAmplitude_);
 		}
 	}
 
 	/*  CREATE GLOTTAL PULSE (OR SINE TONE)  */
-	double pulse = glottalSource_->getSample(f0);
+	SampleFloat pulse = glottalSource_->getSample(f0);
 
 	/*  CREATE PULSED NOISE  */
-	double pulsedNoise = lpNoise * pulse;
+	SampleFloat pulsedNoise = lpNoise * pulse;
 
 	/*  CREATE NOISY GLOTTAL PULSE  */
 	pulse = ax * ((pulse * (1.0 - breathinessFactor_)) +
 			(pulsedNoise * breathinessFactor_));
 
-	double signal;
+	SampleFloat signal;
 	/*  CROSS-MIX PURE NOISE WITH PULSED NOISE  */
 	if (modulation_) {
 		double crossmix = ax * crossmixFactor_;
@@ -679,9 +894,13 @@ Tube::synthesize()
 	signal += throat_->process(pulse * VT_SCALE);
 
 	/*  OUTPUT SAMPLE HERE  */
-	srConv_->dataFill(signal);
+	if (segmentOutput_) {
+		segmentOutput_->push_back(signal);
+	} else {
+		srConv_->dataFill(signal);
+	}
 
-	prevGlotAmplitude_ = ax;
+	prevGlotAmplitude_ = wavetableAmplitude_;
 }
 
 /******************************************************************************
@@ -693,67 +912,75 @@ Tube::synthesize()
 *
 ******************************************************************************/
 void
-Tube::setControlRateParameters(int pos)
+Tube::setControlRateParameters(const ControlFrameBuffer& input, std::size_t pos)
 {
 	double controlFreq = 1.0 / controlPeriod_;
 
+	/*  THE COEFFICIENTS ARE UPDATED IN THE FIRST SAMPLE  */
+	coefficientUpdateCount_ = 0;
+	coefficientTargetValid_ = false;
+
+	/*  THE LAST INPUT TABLE IS DOUBLED UP, TO HELP INTERPOLATION CALCULATIONS  */
+	std::size_t prevPos = pos - 1;
+	std::size_t nextPos = std::min(pos, input.size() - 1);
+
 	/*  GLOTTAL PITCH  */
-	currentData_.glotPitch = inputData_[pos - 1]->glotPitch;
-	currentData_.glotPitchDelta = (inputData_[pos]->glotPitch - currentData_.glotPitch) * controlFreq;
+	currentData_.glotPitch = input.value(PARAM_GLOT_PITCH, prevPos);
+	currentData_.glotPitchDelta = (input.value(PARAM_GLOT_PITCH, nextPos) - currentData_.glotPitch) * controlFreq;
 
 	/*  GLOTTAL VOLUME  */
-	currentData_.glotVol = inputData_[pos - 1]->glotVol;
-	currentData_.glotVolDelta = (inputData_[pos]->glotVol - currentData_.glotVol) * controlFreq;
+	currentData_.glotVol = input.value(PARAM_GLOT_VOL, prevPos);
+	currentData_.glotVolDelta = (input.value(PARAM_GLOT_VOL, nextPos) - currentData_.glotVol) * controlFreq;
 
 	/*  ASPIRATION VOLUME  */
-	currentData_.aspVol = inputData_[pos - 1]->aspVol;
+	currentData_.aspVol = input.value(PARAM_ASP_VOL, prevPos);
 #if MATCH_DSP
 	currentData_.aspVolDelta = 0.0;
 #else
-	currentData_.aspVolDelta = (inputData_[pos]->aspVol - currentData_.aspVol) * controlFreq;
+	currentData_.aspVolDelta = (input.value(PARAM_ASP_VOL, nextPos) - currentData_.aspVol) * controlFreq;
 #endif
 
 	/*  FRICATION VOLUME  */
-	currentData_.fricVol = inputData_[pos - 1]->fricVol;
+	currentData_.fricVol = input.value(PARAM_FRIC_VOL, prevPos);
 #if MATCH_DSP
 	currentData_.fricVolDelta = 0.0;
 #else
-	currentData_.fricVolDelta = (inputData_[pos]->fricVol - currentData_.fricVol) * controlFreq;
+	currentData_.fricVolDelta = (input.value(PARAM_FRIC_VOL, nextPos) - currentData_.fricVol) * controlFreq;
 #endif
 
 	/*  FRICATION POSITION  */
-	currentData_.fricPos = inputData_[pos - 1]->fricPos;
+	currentData_.fricPos = input.value(PARAM_FRIC_POS, prevPos);
 #if MATCH_DSP
 	currentData_.fricPosDelta = 0.0;
 #else
-	currentData_.fricPosDelta = (inputData_[pos]->fricPos - currentData_.fricPos) * controlFreq;
+	currentData_.fricPosDelta = (input.value(PARAM_FRIC_POS, nextPos) - currentData_.fricPos) * controlFreq;
 #endif
 
 	/*  FRICATION CENTER FREQUENCY  */
-	currentData_.fricCF = inputData_[pos - 1]->fricCF;
+	currentData_.fricCF = input.value(PARAM_FRIC_CF, prevPos);
 #if MATCH_DSP
 	currentData_.fricCFDelta = 0.0;
 #else
-	currentData_.fricCFDelta = (inputData_[pos]->fricCF - currentData_.fricCF) * controlFreq;
+	currentData_.fricCFDelta = (input.value(PARAM_FRIC_CF, nextPos) - currentData_.fricCF) * controlFreq;
 #endif
 
 	/*  FRICATION BANDWIDTH  */
-	currentData_.fricBW = inputData_[pos - 1]->fricBW;
+	currentData_.fricBW = input.value(PARAM_FRIC_BW, prevPos);
 #if MATCH_DSP
 	currentData_.fricBWDelta = 0.0;
 #else
-	currentData_.fricBWDelta = (inputData_[pos]->fricBW - currentData_.fricBW) * controlFreq;
+	currentData_.fricBWDelta = (input.value(PARAM_FRIC_BW, nextPos) - currentData_.fricBW) * controlFreq;
 #endif
 
 	/*  TUBE REGION RADII  */
 	for (int i = 0; i < TOTAL_REGIONS; i++) {
-		currentData_.radius[i] = inputData_[pos - 1]->radius[i];
-		currentData_.radiusDelta[i] = (inputData_[pos]->radius[i] - currentData_.radius[i]) * controlFreq;
+		currentData_.radius[i] = std::max<double>(input.value(PARAM_R1 + i, prevPos), GS_TRM_TUBE_MIN_RADIUS);
+		currentData_.radiusDelta[i] = (std::max<double>(input.value(PARAM_R1 + i, nextPos), GS_TRM_TUBE_MIN_RADIUS) - currentData_.radius[i]) * controlFreq;
 	}
 
 	/*  VELUM RADIUS  */
-	currentData_.velum = inputData_[pos - 1]->velum;
-	currentData_.velumDelta = (inputData_[pos]->velum - currentData_.velum) * controlFreq;
+	currentData_.velum = input.value(PARAM_VELUM, prevPos);
+	currentData_.velumDelta = (input.value(PARAM_VELUM, nextPos) - currentData_.velum) * controlFreq;
 }
 
 /******************************************************************************
@@ -889,6 +1116,41 @@ Tube::setFricationTaps()
 #endif
 }
 
+/******************************************************************************
+*
+*  function:  setJunctionCoefficients
+*
+*  purpose:   Copies the scattering coefficients and the frication
+*             taps to the two-way junctions of the vocal tract.
+*
+******************************************************************************/
+void
+Tube::setJunctionCoefficients()
+{
+	const int nasalOffset = ScatteringJunctionKernel<VocalTractFloat>::NASAL_SECTION_OFFSET;
+	ScatteringJunctionKernel<VocalTractFloat>& j = junctions_;
+
+	/*  S1-S2, S2-S3, S3-S4  */
+	j.coefficient(S1) = oropharynxCoeff_[C1];
+	j.coefficient(S2) = oropharynxCoeff_[C2];
+	j.coefficient(S3) = oropharynxCoeff_[C3];
+	j.fricationTap(S2) = fricationTap_[FC1];
+	j.fricationTap(S3) = fricationTap_[FC2];
+	/*  S5-S6, S6-S7 (PURE DELAY WITH DAMPING)  */
+	j.coefficient(S5) = oropharynxCoeff_[C4];
+	j.fricationTap(S5) = fricationTap_[FC4];
+	j.fricationTap(S6) = fricationTap_[FC5];
+	/*  S7-S8, S8-S9, S9-S10  */
+	for (int i = S7, k = C5, m = FC6; i < S10; i++, k++, m++) {
+		j.coefficient(i) = oropharynxCoeff_[k];
+		j.fricationTap(i) = fricationTap_[m];
+	}
+	/*  NASAL CAVITY  */
+	for (int i = N1; i < N6; i++) {
+		j.coefficient(nasalOffset + i) = nasalCoeff_[i];
+	}
+}
+
 /******************************************************************************
 *
 *  function:  vocalTract
@@ -898,109 +1160,52 @@ Tube::setFricationTaps()
 *             cavities.  Also injects frication appropriately.
 *
 ******************************************************************************/
-double
-Tube::vocalTract(double input, double frication)
+Tube::SampleFloat
+Tube::vocalTract(SampleFloat input, SampleFloat frication)
 {
-	int i, j, k;
-	double delta, output, junctionPressure;
+	/*  SWAP CURRENT AND PREVIOUS WAVES  */
+	junctions_.swap();
 
-	/*  INCREMENT CURRENT AND PREVIOUS POINTERS  */
-	if (++currentPtr_ > 1) {
-		currentPtr_ = 0;
-	}
-	if (++prevPtr_ > 1) {
-		prevPtr_ = 0;
-	}
+	/*  CALCULATE THE TWO-WAY SCATTERING JUNCTIONS  */
+	junctions_.update(dampingFactor_, frication);
+
+	const int nasalOffset = ScatteringJunctionKernel<VocalTractFloat>::NASAL_SECTION_OFFSET;
+	ScatteringJunctionKernel<VocalTractFloat>& j = junctions_;
+	SampleFloat output;
+	double junctionPressure;
 
 	/*  UPDATE OROPHARYNX  */
 	/*  INPUT TO TOP OF TUBE  */
-	oropharynx_[S1][TOP][currentPtr_] =
-			(oropharynx_[S1][BOTTOM][prevPtr_] * dampingFactor_) + input;
-
-	/*  CALCULATE THE SCATTERING JUNCTIONS FOR S1-S2  */
-	delta = oropharynxCoeff_[C1] *
-			(oropharynx_[S1][TOP][prevPtr_] - oropharynx_[S2][BOTTOM][prevPtr_]);
-	oropharynx_[S2][TOP][currentPtr_] =
-			(oropharynx_[S1][TOP][prevPtr_] + delta) * dampingFactor_;
-	oropharynx_[S1][BOTTOM][currentPtr_] =
-			(oropharynx_[S2][BOTTOM][prevPtr_] + delta) * dampingFactor_;
-
-	/*  CALCULATE THE SCATTERING JUNCTIONS FOR S2-S3 AND S3-S4  */
-	for (i = S2, j = C2, k = FC1; i < S4; i++, j++, k++) {
-		delta = oropharynxCoeff_[j] *
-				(oropharynx_[i][TOP][prevPtr_] - oropharynx_[i + 1][BOTTOM][prevPtr_]);
-		oropharynx_[i + 1][TOP][currentPtr_] =
-				((oropharynx_[i][TOP][prevPtr_] + delta) * dampingFactor_) +
-				(fricationTap_[k] * frication);
-		oropharynx_[i][BOTTOM][currentPtr_] =
-				(oropharynx_[i + 1][BOTTOM][prevPtr_] + delta) * dampingFactor_;
-	}
+	j.top(S1) = (j.prevBottom(S1) * dampingFactor_) + input;
 
 	/*  UPDATE 3-WAY JUNCTION BETWEEN THE MIDDLE OF R4 AND NASAL CAVITY  */
-	junctionPressure = (alpha_[LEFT] * oropharynx_[S4][TOP][prevPtr_])+
-			(alpha_[RIGHT] * oropharynx_[S5][BOTTOM][prevPtr_]) +
-			(alpha_[UPPER] * nasal_[VELUM][BOTTOM][prevPtr_]);
-	oropharynx_[S4][BOTTOM][currentPtr_] =
-			(junctionPressure - oropharynx_[S4][TOP][prevPtr_]) * dampingFactor_;
-	oropharynx_[S5][TOP][currentPtr_] =
-			((junctionPressure - oropharynx_[S5][BOTTOM][prevPtr_]) * dampingFactor_)
+	junctionPressure = (alpha_[LEFT] * j.prevTop(S4))+
+			(alpha_[RIGHT] * j.prevBottom(S5)) +
+			(alpha_[UPPER] * j.prevBottom(nasalOffset + VELUM));
+	j.bottom(S4) =
+			(junctionPressure - j.prevTop(S4)) * dampingFactor_;
+	j.top(S5) =
+			((junctionPressure - j.prevBottom(S5)) * dampingFactor_)
 			+ (fricationTap_[FC3] * frication);
-	nasal_[VELUM][TOP][currentPtr_] =
-			(junctionPressure - nasal_[VELUM][BOTTOM][prevPtr_]) * dampingFactor_;
-
-	/*  CALCULATE JUNCTION BETWEEN R4 AND R5 (S5-S6)  */
-	delta = oropharynxCoeff_[C4] *
-			(oropharynx_[S5][TOP][prevPtr_] - oropharynx_[S6][BOTTOM][prevPtr_]);
-	oropharynx_[S6][TOP][currentPtr_] =
-			((oropharynx_[S5][TOP][prevPtr_] + delta) * dampingFactor_) +
-			(fricationTap_[FC4] * frication);
-	oropharynx_[S5][BOTTOM][currentPtr_] =
-			(oropharynx_[S6][BOTTOM][prevPtr_] + delta) * dampingFactor_;
-
-	/*  CALCULATE JUNCTION INSIDE R5 (S6-S7) (PURE DELAY WITH DAMPING)  */
-	oropharynx_[S7][TOP][currentPtr_] =
-			(oropharynx_[S6][TOP][prevPtr_] * dampingFactor_) +
-			(fricationTap_[FC5] * frication);
-	oropharynx_[S6][BOTTOM][currentPtr_] =
-			oropharynx_[S7][BOTTOM][prevPtr_] * dampingFactor_;
-
-	/*  CALCULATE LAST 3 INTERNAL JUNCTIONS (S7-S8, S8-S9, S9-S10)  */
-	for (i = S7, j = C5, k = FC6; i < S10; i++, j++, k++) {
-		delta = oropharynxCoeff_[j] *
-				(oropharynx_[i][TOP][prevPtr_] - oropharynx_[i + 1][BOTTOM][prevPtr_]);
-		oropharynx_[i + 1][TOP][currentPtr_] =
-				((oropharynx_[i][TOP][prevPtr_] + delta) * dampingFactor_) +
-				(fricationTap_[k] * frication);
-		oropharynx_[i][BOTTOM][currentPtr_] =
-				(oropharynx_[i + 1][BOTTOM][prevPtr_] + delta) * dampingFactor_;
-	}
+	j.top(nasalOffset + VELUM) =
+			(junctionPressure - j.prevBottom(nasalOffset + VELUM)) * dampingFactor_;
 
 	/*  REFLECTED SIGNAL AT MOUTH GOES THROUGH A LOWPASS FILTER  */
-	oropharynx_[S10][BOTTOM][currentPtr_] =  dampingFactor_ *
+	j.bottom(S10) =  dampingFactor_ *
 			mouthReflectionFilter_->filter(oropharynxCoeff_[C8] *
-							oropharynx_[S10][TOP][prevPtr_]);
+							j.prevTop(S10));
 
 	/*  OUTPUT FROM MOUTH GOES THROUGH A HIGHPASS FILTER  */
 	output = mouthRadiationFilter_->filter((1.0 + oropharynxCoeff_[C8]) *
-						oropharynx_[S10][TOP][prevPtr_]);
-
-	/*  UPDATE NASAL CAVITY  */
-	for (i = VELUM, j = NC1; i < N6; i++, j++) {
-		delta = nasalCoeff_[j] *
-				(nasal_[i][TOP][prevPtr_] - nasal_[i + 1][BOTTOM][prevPtr_]);
-		nasal_[i+1][TOP][currentPtr_] =
-				(nasal_[i][TOP][prevPtr_] + delta) * dampingFactor_;
-		nasal_[i][BOTTOM][currentPtr_] =
-				(nasal_[i + 1][BOTTOM][prevPtr_] + delta) * dampingFactor_;
-	}
+						j.prevTop(S10));
 
 	/*  REFLECTED SIGNAL AT NOSE GOES THROUGH A LOWPASS FILTER  */
-	nasal_[N6][BOTTOM][currentPtr_] = dampingFactor_ *
-			nasalReflectionFilter_->filter(nasalCoeff_[NC6] * nasal_[N6][TOP][prevPtr_]);
+	j.bottom(nasalOffset + N6) = dampingFactor_ *
+			nasalReflectionFilter_->filter(nasalCoeff_[NC6] * j.prevTop(nasalOffset + N6));
 
 	/*  OUTPUT FROM NOSE GOES THROUGH A HIGHPASS FILTER  */
 	output += nasalRadiationFilter_->filter((1.0 + nasalCoeff_[NC6]) *
-						nasal_[N6][TOP][prevPtr_]);
+						j.prevTop(nasalOffset + N6));
 	/*  RETURN SUMMED OUTPUT FROM MOUTH AND NOSE  */
 	return output;
 }
@@ -1026,20 +1231,45 @@ Tube::writeOutputToFile(const char* outputFile)
 
 	WAVEFileWriter fileWriter(outputFile, channels_, srConv_->numberSamples(), outputRate_);
 
+	/*  SCALE THE SAMPLES IN BLOCKS, AND WRITE EACH BLOCK WITH ONE CALL  */
+	float block[2 * OUTPUT_BLOCK_SIZE];
+	const float* data = outputData_.data();
+	std::size_t available = srConv_->numberSamples();
 	if (channels_ == 1) {
-		float scale = calculateMonoScale();
-		for (unsigned int i = 0, end = srConv_->numberSamples(); i < end; ++i) {
-			fileWriter.writeSample(outputData_[i] * scale);
+		float scale = calculateMonoScale(srConv_->maximumSampleValue());
+		while (available > 0) {
+			std::size_t n = std::min<std::size_t>(available, OUTPUT_BLOCK_SIZE);
+			for (std::size_t i = 0; i < n; ++i) {
+				block[i] = data[i] * scale;
+			}
+			fileWriter.writeSamples(block, n);
+			data += n;
+			available -= n;
 		}
 	} else {
 		float leftScale, rightScale;
-		calculateStereoScale(leftScale, rightScale);
-		for (unsigned int i = 0, end = srConv_->numberSamples(); i < end; ++i) {
-			fileWriter.writeStereoSamples(outputData_[i] * leftScale, outputData_[i] * rightScale);
+		calculateStereoScale(srConv_->maximumSampleValue(), leftScale, rightScale);
+		while (available > 0) {
+			std::size_t n = std::min<std::size_t>(available, OUTPUT_BLOCK_SIZE);
+			for (std::size_t i = 0; i < n; ++i) {
+				block[i * 2    ] = data[i] * leftScale;
+				block[i * 2 + 1] = data[i] * rightScale;
+			}
+			fileWriter.writeSamples(block, n * 2);
+			data += n;
+			available -= n;
 		}
 	}
 }
 
+/*******************************************************************************
+ * Scales the output samples and stores them in outputBuffer.
+ *
+ * If the samples have been written directly to outputBuffer (see
+ * prepareOutput), they are scaled in place. The stereo samples are
+ * interleaved from the end of the buffer, so that each mono sample is read
+ * before it is overwritten.
+ */
 void
 Tube::writeOutputToBuffer(std::vector<float>& outputBuffer)
 {
@@ -1049,38 +1279,100 @@ Tube::writeOutputToBuffer(std::vector<float>& outputBuffer)
 	LOG_DEBUG("\nNumber of samples: " << srConv_->numberSamples() <<
 			"\nMaximum sample value: " << srConv_->maximumSampleValue());
 
-	outputBuffer.resize(srConv_->numberSamples() * channels_);
+	const std::size_t numberSamples = srConv_->numberSamples();
+	if (srConv_->output() != &outputBuffer) {
+		outputBuffer.assign(outputData_.begin(), outputData_.begin() + numberSamples);
+	}
+	srConv_->setOutput(outputData_);
 
 	if (channels_ == 1) {
-		float scale = calculateMonoScale();
-		for (unsigned int i = 0, end = srConv_->numberSamples(); i < end; ++i) {
-			outputBuffer[i] = outputData_[i] * scale;
+		float scale = calculateMonoScale(srConv_->maximumSampleValue());
+		for (std::size_t i = 0; i < numberSamples; ++i) {
+			outputBuffer[i] *= scale;
 		}
 	} else {
 		float leftScale, rightScale;
-		calculateStereoScale(leftScale, rightScale);
-		for (unsigned int i = 0, end = srConv_->numberSamples(); i < end; ++i) {
-			unsigned int baseIndex = i * 2;
-			outputBuffer[baseIndex    ] = outputData_[i] * leftScale;
-			outputBuffer[baseIndex + 1] = outputData_[i] * rightScale;
+		calculateStereoScale(srConv_->maximumSampleValue(), leftScale, rightScale);
+		outputBuffer.resize(numberSamples * 2);
+		for (std::size_t i = numberSamples; i-- > 0; ) {
+			float sample = outputBuffer[i];
+			outputBuffer[i * 2    ] = sample * leftScale;
+			outputBuffer[i * 2 + 1] = sample * rightScale;
+		}
+	}
+}
+
+/*******************************************************************************
+ * Sends the synthesized samples to the stream callback, in blocks.
+ *
+ * If flush is false, only complete blocks are sent, and with
+ * STREAM_GAIN_LOOK_AHEAD the last lookAhead samples are kept.
+ */
+void
+Tube::writeOutputToStream(bool flush)
+{
+	std::size_t available = outputData_.size() - streamOutputPos_;
+	if (!flush && streamParameters_.gainMode == STREAM_GAIN_LOOK_AHEAD) {
+		if (available <= streamParameters_.lookAhead) {
+			return;
+		}
+		available -= streamParameters_.lookAhead;
+	}
+
+	while (available >= streamParameters_.blockSize || (flush && available > 0)) {
+		std::size_t numFrames = std::min<std::size_t>(available, streamParameters_.blockSize);
+		if (streamGainFused()) {
+			/*  ALREADY SCALED BY THE SAMPLE RATE CONVERTER  */
+			streamCallback_(&outputData_[streamOutputPos_], numFrames);
+			streamOutputPos_ += numFrames;
+			available -= numFrames;
+			continue;
 		}
+		double peak = streamParameters_.referencePeak;
+		if (streamParameters_.gainMode == STREAM_GAIN_LOOK_AHEAD) {
+			peak = std::max(peak, srConv_->maximumSampleValue());
+		}
+
+		const float* data = &outputData_[streamOutputPos_];
+		streamBlock_.resize(numFrames * channels_);
+		if (channels_ == 1) {
+			float scale = calculateMonoScale(peak);
+			for (std::size_t i = 0; i < numFrames; ++i) {
+				streamBlock_[i] = data[i] * scale;
+			}
+		} else {
+			float leftScale, rightScale;
+			calculateStereoScale(peak, leftScale, rightScale);
+			for (std::size_t i = 0; i < numFrames; ++i) {
+				streamBlock_[i * 2    ] = data[i] * leftScale;
+				streamBlock_[i * 2 + 1] = data[i] * rightScale;
+			}
+		}
+		streamCallback_(&streamBlock_[0], numFrames);
+
+		streamOutputPos_ += numFrames;
+		available -= numFrames;
 	}
+
+	/*  DISCARD THE SAMPLES THAT HAVE BEEN SENT  */
+	outputData_.erase(outputData_.begin(), outputData_.begin() + streamOutputPos_);
+	streamOutputPos_ = 0;
 }
 
 float
-Tube::calculateMonoScale()
+Tube::calculateMonoScale(double maximumSampleValue)
 {
-	float scale = static_cast<float>((OUTPUT_SCALE / srConv_->maximumSampleValue()) * amplitude(volume_));
+	float scale = static_cast<float>((OUTPUT_SCALE / maximumSampleValue) * amplitude(volume_));
 	LOG_DEBUG("\nScale: " << scale << '\n');
 	return scale;
 }
 
 void
-Tube::calculateStereoScale(float& leftScale, float& rightScale)
+Tube::calculateStereoScale(double maximumSampleValue, float& leftScale, float& rightScale)
 {
 	leftScale = static_cast<float>(-((balance_ / 2.0) - 0.5));
 	rightScale = static_cast<float>(((balance_ / 2.0) + 0.5));
-	float newMax = static_cast<float>(srConv_->maximumSampleValue() * (balance_ > 0.0 ? rightScale : leftScale));
+	float newMax = static_cast<float>(maximumSampleValue * (balance_ > 0.0 ? rightScale : leftScale));
 	float scale = static_cast<float>((OUTPUT_SCALE / newMax) * amplitude(volume_));
 	leftScale  *= scale;
 	rightScale *= scale;
@@ -1111,7 +1403,7 @@ Tube::amplitude(double decibelLevel)
 	}
 
 	/*  ELSE RETURN INVERSE LOG VALUE  */
-	return pow(10.0, decibelLevel / 20.0);
+	return FastMath::decibelToAmplitude(decibelLevel);
 }
 
 /******************************************************************************
@@ -1125,7 +1417,7 @@ Tube::amplitude(double decibelLevel)
 double
 Tube::frequency(double pitch)
 {
-	return PITCH_BASE * pow(2.0, (pitch + PITCH_OFFSET) / 12.0);
+	return PITCH_BASE * FastMath::exp2((pitch + PITCH_OFFSET) / 12.0);
 }
 
 void
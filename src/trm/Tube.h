@@ -22,23 +22,30 @@
 #define TRM_TUBE_H_
 
 #include <algorithm> /* max, min */
+#include <cstddef> /* std::size_t */
+#include <functional>
 #include <istream>
 #include <memory>
 #include <vector>
 
 #include "BandpassFilter.h"
+#include "ControlFrameBuffer.h"
 #include "MovingAverageFilter.h"
 #include "NoiseFilter.h"
 #include "NoiseSource.h"
 #include "RadiationFilter.h"
 #include "ReflectionFilter.h"
 #include "SampleRateConverter.h"
+#include "ScatteringJunctionKernel.h"
 #include "Throat.h"
 #include "VocalTractModelParameterValue.h"
 #include "WavetableGlottalSource.h"
 
 #define GS_TRM_TUBE_MIN_RADIUS (0.001)
 
+/*  TYPICAL MAXIMUM ABSOLUTE SAMPLE VALUE BEFORE SCALING (VOLUME = 60 dB)  */
+#define GS_TRM_TUBE_DEFAULT_STREAM_REFERENCE_PEAK (0.0007)
+
 
 
 namespace GS {
@@ -85,17 +92,54 @@ public:
 		PARAM_VELUM      = 15
 	};
 
+	enum StreamGainMode {
+		STREAM_GAIN_FIXED,     /*  the scale is calculated from referencePeak only  */
+		STREAM_GAIN_LOOK_AHEAD /*  the scale is reduced if the samples exceed referencePeak  */
+	};
+	struct StreamParameters {
+		StreamGainMode gainMode;
+		double referencePeak;   /*  expected maximum absolute sample value before scaling  */
+		unsigned int blockSize; /*  sample frames per callback (the last block may be shorter)  */
+		unsigned int lookAhead; /*  output delay in sample frames (STREAM_GAIN_LOOK_AHEAD only)  */
+		StreamParameters()
+			: gainMode(STREAM_GAIN_LOOK_AHEAD)
+			, referencePeak(GS_TRM_TUBE_DEFAULT_STREAM_REFERENCE_PEAK)
+			, blockSize(512)
+			, lookAhead(4096) {}
+	};
+	// The samples are interleaved if there are two channels.
+	typedef std::function<void (const float* samples, std::size_t numFrames)> StreamCallback;
+
 	Tube();
 	~Tube();
 
 	void synthesizeToFile(std::istream& inputStream, const char* outputFile);
 	void synthesizeToBuffer(std::istream& inputStream, std::vector<float>& outputBuffer);
+	void synthesizeToFile(const ControlFrameBuffer& input, const char* outputFile);
+	void synthesizeToBuffer(const ControlFrameBuffer& input, std::vector<float>& outputBuffer);
+
+	// Streaming synthesis. The frames may be appended to the input between the
+	// calls to synthesizeStream. The last frame is only used by endStream.
+	void beginStream(const ControlFrameBuffer::Header& header, const StreamParameters& parameters, StreamCallback callback);
+	void synthesizeStream(const ControlFrameBuffer& input);
+	void endStream(const ControlFrameBuffer& input);
+
+	// Incremental synthesis, for inputs that are generated while the tube is
+	// running. The frames may be appended to the input between the calls to
+	// synthesizeFrames. The last frame is only used by finishToFile or
+	// finishToBuffer, which normalize the output like synthesizeToFile and
+	// synthesizeToBuffer. If outputBuffer is not null, it must be the buffer
+	// that will be passed to finishToBuffer.
+	void beginSynthesis(const ControlFrameBuffer::Header& header, std::vector<float>* outputBuffer = nullptr);
+	void synthesizeFrames(const ControlFrameBuffer& input);
+	void finishToFile(const ControlFrameBuffer& input, const char* outputFile);
+	void finishToBuffer(const ControlFrameBuffer& input, std::vector<float>& outputBuffer);
 
 	template<typename T> void loadConfigurationForInteractiveExecution(const T& config);
 	void initializeSynthesizer();
 	void initializeInputFilters(double period);
 	void loadSingleInput(const VocalTractModelParameterValue pv);
-	void synthesizeForInputSequence();
+	void synthesizeForInputSequence(const ControlFrameBuffer& input);
 	void synthesizeForSingleInput(int numIterations);
 
 	std::vector<float>& outputData() { return outputData_; }
@@ -109,6 +153,19 @@ public:
 	float outputRate() const { return outputRate_; }
 	unsigned int numChannels() const { return channels_; }
 private:
+	friend class ParallelTube;
+
+#ifdef GS_TRM_FLOAT_SYNTHESIS
+	typedef float SampleFloat;           /*  samples and state of the filters  */
+#else
+	typedef double SampleFloat;
+#endif
+#if defined(GS_TRM_FLOAT_VOCAL_TRACT) || defined(GS_TRM_FLOAT_SYNTHESIS)
+	typedef float VocalTractFloat;
+#else
+	typedef double VocalTractFloat;
+#endif
+
 	enum {
 		VELUM = N1
 	};
@@ -162,6 +219,9 @@ private:
 		FC8 = 7, /*  S10  */
 		TOTAL_FRIC_COEFFICIENTS = 8
 	};
+	enum { /*  COEFFICIENTS INTERPOLATED BETWEEN UPDATES  */
+		TOTAL_INTERPOLATED_COEFFICIENTS = 3 + TOTAL_COEFFICIENTS + 1 + TOTAL_ALPHA_COEFFICIENTS + TOTAL_FRIC_COEFFICIENTS + 3
+	};
 
 	struct InputData {
 		double glotPitch;
@@ -251,29 +311,55 @@ private:
 		}
 	};
 
+	/*  PARAMETERS OF THE COMPONENTS CREATED BY initializeSynthesizer  */
+	struct ComponentParameters {
+		int    sampleRate;
+		float  outputRate;
+		int    sampleRateConverterQuality;
+		int    waveform;
+		double tp;
+		double tnMin;
+		double tnMax;
+		int    glottalSourceOscillator;
+		double mouthCoef;
+		double noseCoef;
+		double throatCutoff;
+		double throatVol;
+	};
+
 	Tube(const Tube&) = delete;
 	Tube& operator=(const Tube&) = delete;
 
 	void reset();
 	void calculateTubeCoefficients();
 	void initializeNasalCavity();
-	void printInfo(const char* inputFile);
-	void parseInputStream(std::istream& in);
+	void printInfo(const char* inputFile, const ControlFrameBuffer& input);
+	void loadInputHeader(const ControlFrameBuffer::Header& header);
 	void sampleRateInterpolation();
-	void setControlRateParameters(int pos);
+	void calculateCoefficients();
+	void getCoefficients(double* coef) const;
+	void setCoefficients(const double* coef);
+	void updateCoefficients(int numSamples);
+	void interpolateCoefficients();
+	void setControlRateParameters(const ControlFrameBuffer& input, std::size_t pos);
 	void setFricationTaps();
-	double vocalTract(double input, double frication);
+	void setJunctionCoefficients();
+	SampleFloat vocalTract(SampleFloat input, SampleFloat frication);
+	void prepareOutput(std::size_t inputSize, std::vector<float>* outputBuffer);
 	void writeOutputToFile(const char* outputFile);
 	void writeOutputToBuffer(std::vector<float>& outputBuffer);
+	void writeOutputToStream(bool flush);
+	bool streamGainFused() const { return streamParameters_.gainMode == STREAM_GAIN_FIXED && channels_ == 1; }
 	void synthesize();
-	float calculateMonoScale();
-	void calculateStereoScale(float& leftScale, float& rightScale);
+	void synthesizeControlPeriod(const ControlFrameBuffer& input, std::size_t pos);
+	float calculateMonoScale(double maximumSampleValue);
+	void calculateStereoScale(double maximumSampleValue, float& leftScale, float& rightScale);
 
 	static double amplitude(double decibelLevel);
 	static double frequency(double pitch);
 	static double speedOfSound(double temperature);
 
-	float  outputRate_;                  /*  output sample rate (22.05, 44.1)  */
+	float  outputRate_;                  /*  output sample rate (8000 - 96000 Hz)  */
 	float  controlRate_;                 /*  1.0-1000.0 input tables/second (Hz)  */
 
 	double volume_;                      /*  master volume (0 - 60 dB)  */
@@ -302,21 +388,21 @@ private:
 	int    modulation_;                  /*  pulse mod. of noise (0=OFF, 1=ON)  */
 	double mixOffset_;                   /*  noise crossmix offset (30 - 60 dB)  */
 
+	int    coefficientUpdatePeriod_;     /*  samples between updates of the coefficients  */
+	int    sampleRateConverterQuality_;
+	int    glottalSourceOscillator_;
+
 	/*  DERIVED VALUES  */
 	int    controlPeriod_;
 	int    sampleRate_;
 	double actualTubeLength_;            /*  actual length in cm  */
 
 	/*  MEMORY FOR TUBE AND TUBE COEFFICIENTS  */
-	double oropharynx_[TOTAL_SECTIONS][2][2];
+	ScatteringJunctionKernel<VocalTractFloat> junctions_;
 	double oropharynxCoeff_[TOTAL_COEFFICIENTS];
-
-	double nasal_[TOTAL_NASAL_SECTIONS][2][2];
 	double nasalCoeff_[TOTAL_NASAL_COEFFICIENTS];
 
 	double alpha_[TOTAL_ALPHA_COEFFICIENTS];
-	int currentPtr_;
-	int prevPtr_;
 
 	/*  MEMORY FOR FRICATION TAPS  */
 	double fricationTap_[TOTAL_FRIC_COEFFICIENTS];
@@ -327,22 +413,43 @@ private:
 
 	double prevGlotAmplitude_;
 
-	std::vector<std::unique_ptr<InputData>> inputData_;
+	/*  COEFFICIENT UPDATE  */
+	int    coefficientUpdateCount_;      /*  samples until the next update  */
+	double glotFrequency_;
+	double glotAmplitude_;
+	double aspAmplitude_;
+	double wavetableAmplitude_;          /*  amplitude used to update the wavetable  */
+	bool   coefficientTargetValid_;
+	double coefficient_[TOTAL_INTERPOLATED_COEFFICIENTS];
+	double coefficientDelta_[TOTAL_INTERPOLATED_COEFFICIENTS];
+	double coefficientTarget_[TOTAL_INTERPOLATED_COEFFICIENTS];
+
 	CurrentData currentData_;
 	InputData singleInput_;
 	std::size_t outputDataPos_;
 	std::vector<float> outputData_;
-	std::unique_ptr<SampleRateConverter> srConv_;
-	std::unique_ptr<RadiationFilter> mouthRadiationFilter_;
-	std::unique_ptr<ReflectionFilter> mouthReflectionFilter_;
-	std::unique_ptr<RadiationFilter> nasalRadiationFilter_;
-	std::unique_ptr<ReflectionFilter> nasalReflectionFilter_;
-	std::unique_ptr<Throat> throat_;
-	std::unique_ptr<WavetableGlottalSource> glottalSource_;
-	std::unique_ptr<BandpassFilter> bandpassFilter_;
-	std::unique_ptr<NoiseFilter> noiseFilter_;
+	std::unique_ptr<SampleRateConverter<SampleFloat>> srConv_;
+	std::unique_ptr<RadiationFilter<SampleFloat>> mouthRadiationFilter_;
+	std::unique_ptr<ReflectionFilter<SampleFloat>> mouthReflectionFilter_;
+	std::unique_ptr<RadiationFilter<SampleFloat>> nasalRadiationFilter_;
+	std::unique_ptr<ReflectionFilter<SampleFloat>> nasalReflectionFilter_;
+	std::unique_ptr<Throat<SampleFloat>> throat_;
+	std::unique_ptr<WavetableGlottalSource<SampleFloat>> glottalSource_;
+	std::unique_ptr<BandpassFilter<SampleFloat>> bandpassFilter_;
+	std::unique_ptr<NoiseFilter<SampleFloat>> noiseFilter_;
 	std::unique_ptr<NoiseSource> noiseSource_;
 	std::unique_ptr<InputFilters> inputFilters_;
+	ComponentParameters componentParameters_; /*  the components are reused while these parameters do not change  */
+
+	/*  STREAMING AND INCREMENTAL SYNTHESIS  */
+	std::size_t controlPos_;             /*  next input table position  */
+	StreamParameters streamParameters_;
+	StreamCallback streamCallback_;
+	std::size_t streamOutputPos_;        /*  next sample in outputData_ to be sent  */
+	std::vector<float> streamBlock_;
+
+	/*  SEGMENTS OF ParallelTube  */
+	std::vector<SampleFloat>* segmentOutput_; /*  if not null, receives the samples at the tube sample rate, instead of srConv_  */
 };
 
 
@@ -379,6 +486,9 @@ Tube::loadConfigurationForInteractiveExecution(const T& config)
 	throatVol_    = config.throatVol;
 	modulation_   = config.modulation;
 	mixOffset_    = config.mixOffset;
+	coefficientUpdatePeriod_ = 1;
+	sampleRateConverterQuality_ = SampleRateConverterBase::QUALITY_DEFAULT;
+	glottalSourceOscillator_ = WavetableGlottalSourceBase::OSCILLATOR_OVERSAMPLING;
 }
 
 } /* namespace TRM */
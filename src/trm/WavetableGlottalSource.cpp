@@ -24,9 +24,6 @@
 
 #include "FIRFilter.h"
 
-/*  COMPILE WITH OVERSAMPLING OR PLAIN OSCILLATOR  */
-#define OVERSAMPLING_OSCILLATOR   1
-
 /*  GLOTTAL SOURCE OSCILLATOR TABLE VARIABLES  */
 #define TABLE_LENGTH              512
 #define TABLE_MODULUS             (TABLE_LENGTH-1)
@@ -36,15 +33,25 @@
 #define FIR_GAMMA                 .1
 #define FIR_CUTOFF                .00000001
 
+/*  BAND-LIMITED TABLES  */
+#define MAX_HARMONICS             (TABLE_LENGTH/2 - 1)
+#define LEVELS_PER_OCTAVE         4
+#define NUMBER_LEVELS             (8 * LEVELS_PER_OCTAVE + 1) /*  MAX_HARMONICS -> 1 harmonic  */
+#define BAND_LIMITED_CUTOFF       0.45 /*  fraction of the sample rate  */
+
 
 
 namespace GS {
 namespace TRM {
 
-WavetableGlottalSource::WavetableGlottalSource(
+template<typename FloatType>
+WavetableGlottalSource<FloatType>::WavetableGlottalSource(
 			Type type, double sampleRate,
-			double tp, double tnMin, double tnMax)
-		: wavetable_(TABLE_LENGTH)
+			double tp, double tnMin, double tnMax,
+			Oscillator oscillator)
+		: currentPulse_(0)
+		, level_(0)
+		, oscillator_(oscillator)
 {
 	// Calculates the initial glottal pulse and stores it
 	// in the wavetable, for use in the oscillator.
@@ -59,72 +66,185 @@ WavetableGlottalSource::WavetableGlottalSource(
 
 	/*  INITIALIZE THE WAVETABLE WITH EITHER A GLOTTAL PULSE OR SINE TONE  */
 	if (type == TYPE_PULSE) {
-		/*  CALCULATE RISE PORTION OF WAVE TABLE  */
-		for (int i = 0; i < tableDiv1_; i++) {
-			double x = (double) i / (double) tableDiv1_;
-			double x2 = x * x;
-			double x3 = x2 * x;
-			wavetable_[i] = (3.0 * x2) - (2.0 * x3);
-		}
-
-		/*  CALCULATE FALL PORTION OF WAVE TABLE  */
-		for (int i = tableDiv1_, j = 0; i < tableDiv2_; i++, j++) {
-			double x = (double) j / tnLength_;
-			wavetable_[i] = 1.0 - (x * x);
-		}
-
-		/*  SET CLOSED PORTION OF WAVE TABLE  */
-		for (int i = tableDiv2_; i < TABLE_LENGTH; i++) {
-			wavetable_[i] = 0.0;
-		}
+		pulse_.resize(static_cast<int>(tnDelta_) + 1);
+		calculatePulse(tableDiv2_, pulse_[0].table);
 	} else {
 		/*  SINE WAVE  */
+		pulse_.resize(1);
+		std::vector<FloatType>& table = pulse_[0].table;
+		table.resize(TABLE_LENGTH);
 		for (int i = 0; i < TABLE_LENGTH; i++) {
-			wavetable_[i] = sin(((double) i / (double) TABLE_LENGTH) * 2.0 * M_PI);
+			table[i] = (FloatType) sin(((double) i / (double) TABLE_LENGTH) * 2.0 * M_PI);
 		}
 	}
+	wavetable_ = &pulse_[0].table[0];
 
-#if OVERSAMPLING_OSCILLATOR
-	firFilter_.reset(new FIRFilter(FIR_BETA, FIR_GAMMA, FIR_CUTOFF));
-#endif
+	if (oscillator_ == OSCILLATOR_OVERSAMPLING) {
+		firFilter_.reset(new FIRFilter<FloatType>(FIR_BETA, FIR_GAMMA, FIR_CUTOFF));
+	} else {
+		/*  CALCULATE THE HIGHEST FREQUENCY OF EACH LEVEL  */
+		levelMaxFrequency_.resize(NUMBER_LEVELS);
+		for (int level = 0; level < NUMBER_LEVELS; level++) {
+			levelMaxFrequency_[level] = (BAND_LIMITED_CUTOFF * sampleRate) / numberHarmonics(level);
+		}
+	}
 }
-
-WavetableGlottalSource::~WavetableGlottalSource()
+template<typename FloatType>
+WavetableGlottalSource<FloatType>::~WavetableGlottalSource()
 {
 }
 
+template<typename FloatType>
 void
-WavetableGlottalSource::reset()
+WavetableGlottalSource<FloatType>::reset()
 {
 	currentPosition_ = 0;
-	firFilter_->reset();
+	currentPulse_ = 0;
+	wavetable_ = &pulse_[0].table[0];
+	level_ = 0;
+	if (firFilter_) firFilter_->reset();
+}
+
+/******************************************************************************
+*
+*  function:  calculatePulse
+*
+*  purpose:   Calculates the glottal pulse that closes at the
+*             given table position.
+*
+******************************************************************************/
+template<typename FloatType>
+void
+WavetableGlottalSource<FloatType>::calculatePulse(int closurePoint, std::vector<FloatType>& table) const
+{
+	table.resize(TABLE_LENGTH);
+
+	/*  CALCULATE RISE PORTION OF WAVE TABLE  */
+	for (int i = 0; i < tableDiv1_; i++) {
+		double x = (double) i / (double) tableDiv1_;
+		double x2 = x * x;
+		double x3 = x2 * x;
+		table[i] = (FloatType) ((3.0 * x2) - (2.0 * x3));
+	}
+
+	/*  CALCULATE FALL PORTION OF WAVE TABLE  */
+	double tnLength = closurePoint - tableDiv1_;
+	for (int i = tableDiv1_, j = 0; i < closurePoint; i++, j++) {
+		double x = (double) j / tnLength;
+		table[i] = (FloatType) (1.0 - (x * x));
+	}
+
+	/*  SET CLOSED PORTION OF WAVE TABLE  */
+	for (int i = closurePoint; i < TABLE_LENGTH; i++) {
+		table[i] = 0.0;
+	}
 }
 
 /******************************************************************************
 *
 *  function:  updateWavetable
 *
-*  purpose:   Rewrites the changeable part of the glottal pulse
-*             according to the amplitude.
+*  purpose:   Selects the glottal pulse according to the amplitude.
 *
 ******************************************************************************/
+template<typename FloatType>
 void
-WavetableGlottalSource::updateWavetable(double amplitude)
+WavetableGlottalSource<FloatType>::updateWavetable(double amplitude)
 {
 	/*  CALCULATE NEW CLOSURE POINT, BASED ON AMPLITUDE  */
-	double newDiv2 = tableDiv2_ - rint(amplitude * tnDelta_);
-	double invNewTnLength = 1.0 / (newDiv2 - tableDiv1_);
+	int shift = static_cast<int>(rint(amplitude * tnDelta_));
+	if (shift < 0) {
+		shift = 0;
+	} else if (shift > static_cast<int>(tnDelta_)) {
+		shift = static_cast<int>(tnDelta_);
+	}
 
-	/*  RECALCULATE THE FALLING PORTION OF THE GLOTTAL PULSE  */
-	double x = 0.0;
-	for (int i = tableDiv1_, end = static_cast<int>(newDiv2); i < end; ++i, x += invNewTnLength) {
-		wavetable_[i] = 1.0 - (x * x);
+	std::vector<FloatType>& table = pulse_[shift].table;
+	if (table.empty()) {
+		calculatePulse(tableDiv2_ - shift, table);
 	}
+	wavetable_ = &table[0];
+	currentPulse_ = shift;
+}
+
+/******************************************************************************
+*
+*  function:  numberHarmonics
+*
+*  purpose:   Returns the number of harmonics of the band-limited
+*             tables of the given level. The number is halved at
+*             every LEVELS_PER_OCTAVE levels.
+*
+******************************************************************************/
+template<typename FloatType>
+int
+WavetableGlottalSource<FloatType>::numberHarmonics(int level)
+{
+	int n = static_cast<int>(MAX_HARMONICS * pow(2.0, -level / static_cast<double>(LEVELS_PER_OCTAVE)));
+	return (n < 1) ? 1 : n;
+}
 
-	/*  FILL IN WITH CLOSED PORTION OF GLOTTAL PULSE  */
-	for (int i = static_cast<int>(newDiv2); i < tableDiv2_; i++) {
-		wavetable_[i] = 0.0;
+/******************************************************************************
+*
+*  function:  bandLimitedTable
+*
+*  purpose:   Returns the band-limited version of the current
+*             pulse for the given level. The table is calculated
+*             from the harmonics of the pulse when it is used for
+*             the first time.
+*
+******************************************************************************/
+template<typename FloatType>
+const FloatType*
+WavetableGlottalSource<FloatType>::bandLimitedTable(int level)
+{
+	Pulse& pulse = pulse_[currentPulse_];
+	if (pulse.bandLimitedTable.empty()) {
+		pulse.bandLimitedTable.resize(NUMBER_LEVELS);
+	}
+	std::vector<FloatType>& table = pulse.bandLimitedTable[level];
+	if (!table.empty()) {
+		return &table[0];
+	}
+
+	/*  sine(2 * pi * k / TABLE_LENGTH); cosine is sine shifted by TABLE_LENGTH / 4  */
+	std::vector<double> sineTable(TABLE_LENGTH);
+	for (int k = 0; k < TABLE_LENGTH; k++) {
+		sineTable[k] = sin(((double) k / (double) TABLE_LENGTH) * 2.0 * M_PI);
 	}
+
+	/*  CALCULATE THE HARMONICS OF THE PULSE (COSINE AND SINE COEFFICIENTS)  */
+	if (pulse.spectrum.empty()) {
+		pulse.spectrum.assign(2 * (MAX_HARMONICS + 1), 0.0);
+		for (int h = 0; h <= MAX_HARMONICS; h++) {
+			double a = 0.0, b = 0.0;
+			for (int i = 0; i < TABLE_LENGTH; i++) {
+				int k = (h * i) & TABLE_MODULUS;
+				a += pulse.table[i] * sineTable[(k + TABLE_LENGTH / 4) & TABLE_MODULUS];
+				b += pulse.table[i] * sineTable[k];
+			}
+			double scale = (h == 0) ? (1.0 / TABLE_LENGTH) : (2.0 / TABLE_LENGTH);
+			pulse.spectrum[2 * h]     = a * scale;
+			pulse.spectrum[2 * h + 1] = b * scale;
+		}
+	}
+
+	/*  SUM THE HARMONICS, WITH THE LANCZOS SIGMA FACTORS TO REDUCE THE RINGING  */
+	const int n = numberHarmonics(level);
+	std::vector<double> sum(TABLE_LENGTH, pulse.spectrum[0]);
+	for (int h = 1; h <= n; h++) {
+		double x = M_PI * h / (n + 1);
+		double sigma = sin(x) / x;
+		double a = pulse.spectrum[2 * h] * sigma;
+		double b = pulse.spectrum[2 * h + 1] * sigma;
+		for (int i = 0; i < TABLE_LENGTH; i++) {
+			int k = (h * i) & TABLE_MODULUS;
+			sum[i] += a * sineTable[(k + TABLE_LENGTH / 4) & TABLE_MODULUS] + b * sineTable[k];
+		}
+	}
+	table.assign(sum.begin(), sum.end());
+
+	return &table[0];
 }
 
 /******************************************************************************
@@ -135,26 +255,38 @@ WavetableGlottalSource::updateWavetable(double amplitude)
 *             the desired frequency.
 *
 ******************************************************************************/
+template<typename FloatType>
 void
-WavetableGlottalSource::incrementTablePosition(double frequency)
+WavetableGlottalSource<FloatType>::incrementTablePosition(double frequency)
 {
 	currentPosition_ = mod0(currentPosition_ + (frequency * basicIncrement_));
 }
 
+template<typename FloatType>
+FloatType
+WavetableGlottalSource<FloatType>::getSample(double frequency)
+{
+	if (oscillator_ == OSCILLATOR_OVERSAMPLING) {
+		return getOversampledSample(frequency);
+	} else {
+		return getBandLimitedSample(frequency);
+	}
+}
+
 /******************************************************************************
 *
-*  function:  oscillator
+*  function:  getOversampledSample
 *
 *  purpose:   Is a 2X oversampling interpolating wavetable
 *             oscillator.
 *
 ******************************************************************************/
-#if OVERSAMPLING_OSCILLATOR
-double
-WavetableGlottalSource::getSample(double frequency)  /*  2X OVERSAMPLING OSCILLATOR  */
+template<typename FloatType>
+FloatType
+WavetableGlottalSource<FloatType>::getOversampledSample(double frequency)
 {
 	int lowerPosition, upperPosition;
-	double interpolatedValue, output;
+	FloatType interpolatedValue, output;
 
 	for (int i = 0; i < 2; i++) {
 		/*  FIRST INCREMENT THE TABLE POSITION, DEPENDING ON FREQUENCY  */
@@ -166,7 +298,7 @@ WavetableGlottalSource::getSample(double frequency)  /*  2X OVERSAMPLING OSCILLA
 
 		/*  CALCULATE INTERPOLATED TABLE VALUE  */
 		interpolatedValue = wavetable_[lowerPosition] +
-					((currentPosition_ - lowerPosition) *
+					((FloatType) (currentPosition_ - lowerPosition) *
 					(wavetable_[upperPosition] - wavetable_[lowerPosition]));
 
 		/*  PUT VALUE THROUGH FIR FILTER  */
@@ -176,25 +308,41 @@ WavetableGlottalSource::getSample(double frequency)  /*  2X OVERSAMPLING OSCILLA
 	/*  SINCE WE DECIMATE, TAKE ONLY THE SECOND OUTPUT VALUE  */
 	return output;
 }
-#else
-double
-WavetableGlottalSource::getSample(double frequency)  /*  PLAIN OSCILLATOR  */
+
+/******************************************************************************
+*
+*  function:  getBandLimitedSample
+*
+*  purpose:   Is an interpolating wavetable oscillator, that reads
+*             the table with the most harmonics below the cutoff
+*             frequency.
+*
+******************************************************************************/
+template<typename FloatType>
+FloatType
+WavetableGlottalSource<FloatType>::getBandLimitedSample(double frequency)
 {
-	int lowerPosition, upperPosition;
+	/*  SELECT THE LEVEL, STARTING FROM THE PREVIOUS ONE  */
+	while (level_ < NUMBER_LEVELS - 1 && frequency > levelMaxFrequency_[level_]) {
+		level_++;
+	}
+	while (level_ > 0 && frequency <= levelMaxFrequency_[level_ - 1]) {
+		level_--;
+	}
+	const FloatType* table = bandLimitedTable(level_);
 
 	/*  FIRST INCREMENT THE TABLE POSITION, DEPENDING ON FREQUENCY  */
 	incrementTablePosition(frequency);
 
 	/*  FIND SURROUNDING INTEGER TABLE POSITIONS  */
-	lowerPosition = (int) currentPosition;
-	upperPosition = mod0(lowerPosition + 1);
+	int lowerPosition = static_cast<int>(currentPosition_);
+	int upperPosition = static_cast<int>(mod0(lowerPosition + 1));
 
 	/*  RETURN INTERPOLATED TABLE VALUE  */
-	return wavetable_[lowerPosition] +
-		((currentPosition - lowerPosition) *
-		(wavetable_[upperPosition] - wavetable_[lowerPosition]));
+	return table[lowerPosition] +
+		((FloatType) (currentPosition_ - lowerPosition) *
+		(table[upperPosition] - table[lowerPosition]));
 }
-#endif
 
 /******************************************************************************
 *
@@ -204,8 +352,9 @@ WavetableGlottalSource::getSample(double frequency)  /*  PLAIN OSCILLATOR  */
 *             range 0 -> TABLE_MODULUS.
 *
 ******************************************************************************/
+template<typename FloatType>
 double
-WavetableGlottalSource::mod0(double value)
+WavetableGlottalSource<FloatType>::mod0(double value)
 {
 	if (value > TABLE_MODULUS) {
 		value -= TABLE_LENGTH;
@@ -214,5 +363,9 @@ WavetableGlottalSource::mod0(double value)
 	return value;
 }
 
+// Explicit instantiation.
+template class WavetableGlottalSource<float>;
+template class WavetableGlottalSource<double>;
+
 } /* namespace TRM */
 } /* namespace GS */
@@ -29,29 +29,68 @@
 namespace GS {
 namespace TRM {
 
-class FIRFilter;
+template<typename FloatType> class FIRFilter;
 
-class WavetableGlottalSource {
+// Constants that do not depend on the sample type.
+class WavetableGlottalSourceBase {
 public:
 	enum Type { /*  WAVEFORM TYPES  */
 		TYPE_PULSE,
 		TYPE_SINE
 	};
+	enum Oscillator {
+		OSCILLATOR_OVERSAMPLING = 0,
+		OSCILLATOR_BAND_LIMITED = 1
+	};
+};
 
+/*******************************************************************************
+ * Wavetable oscillator for the glottal source.
+ *
+ * The closure point of the glottal pulse depends on the amplitude, quantized
+ * to whole table positions. The pulse table of each closure point is
+ * calculated when it is used for the first time, and kept for the following
+ * uses, so updateWavetable() only selects a table.
+ *
+ * OSCILLATOR_OVERSAMPLING reads the table at twice the sample rate, and
+ * decimates the result with a lowpass FIR filter. OSCILLATOR_BAND_LIMITED
+ * reads, at the sample rate, a version of the table that contains only the
+ * harmonics below the cutoff frequency for the current fundamental
+ * frequency. The band-limited tables are calculated when they are used for
+ * the first time.
+ *
+ * The tables and the FIR filter use FloatType. The table position is
+ * always stored in double precision.
+ */
+template<typename FloatType>
+class WavetableGlottalSource : public WavetableGlottalSourceBase {
+public:
 	WavetableGlottalSource(
 			Type type, double sampleRate,
-			double tp = 0.0, double tnMin = 0.0, double tnMax = 0.0);
+			double tp = 0.0, double tnMin = 0.0, double tnMax = 0.0,
+			Oscillator oscillator = OSCILLATOR_OVERSAMPLING);
 	~WavetableGlottalSource();
 
 	void reset();
-	double getSample(double frequency);
+	FloatType getSample(double frequency);
 	void updateWavetable(double amplitude);
 private:
+	struct Pulse {
+		std::vector<FloatType> table;
+		std::vector<double> spectrum;                          /*  cosine and sine coefficients of each harmonic  */
+		std::vector<std::vector<FloatType>> bandLimitedTable;  /*  indexed by level  */
+	};
+
 	WavetableGlottalSource(const WavetableGlottalSource&) = delete;
 	WavetableGlottalSource& operator=(const WavetableGlottalSource&) = delete;
 
 	void incrementTablePosition(double frequency);
+	void calculatePulse(int closurePoint, std::vector<FloatType>& table) const;
+	const FloatType* bandLimitedTable(int level);
+	FloatType getOversampledSample(double frequency);
+	FloatType getBandLimitedSample(double frequency);
 
+	static int numberHarmonics(int level);
 	static double mod0(double value);
 
 	int    tableDiv1_;
@@ -60,8 +99,13 @@ private:
 	double tnDelta_;
 	double basicIncrement_;
 	double currentPosition_;
-	std::vector<double> wavetable_;
-	std::unique_ptr<FIRFilter> firFilter_;
+	const FloatType* wavetable_;         /*  table of the current pulse  */
+	std::vector<Pulse> pulse_;           /*  cache, indexed by closure shift (0 - tnDelta_)  */
+	int currentPulse_;
+	int level_;                          /*  current band-limited level  */
+	Oscillator oscillator_;
+	std::vector<double> levelMaxFrequency_;
+	std::unique_ptr<FIRFilter<FloatType>> firFilter_;
 };
 
 } /* namespace TRM */
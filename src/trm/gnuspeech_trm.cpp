@@ -18,16 +18,235 @@
 // 2014-09
 // This file was copied from Gnuspeech and modified by Marcelo Y. Matuda.
 
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <vector>
 
+#include "ControlFrameBuffer.h"
 #include "global.h"
 #include "Log.h"
 #include "Tube.h"
 
 
 
+namespace {
+
+const double DEFAULT_MIN_SNR = 90.0; // dB
+
+void
+showUsage(const char* programName)
+{
+	std::cout << "\nGnuspeechSA TRM " << PROGRAM_VERSION << "\n\n";
+	std::cerr << "Usage: " << programName << " [-v] [-k period] [-q quality] [-g oscillator] trm_param_file.txt output_file.wav\n";
+	std::cerr << "       " << programName << " -b trm_param_file.txt\n";
+	std::cerr << "       " << programName << " -r trm_param_file.txt\n";
+	std::cerr << "       " << programName << " -d samples_file trm_param_file.txt\n";
+	std::cerr << "       " << programName << " -c samples_file [-s min_snr] trm_param_file.txt\n";
+	std::cout << "         -v : verbose\n";
+	std::cout << "         -k : samples between updates of the coefficients (default: 1)\n";
+	std::cout << "         -q : quality of the sample rate converter (0: fast, 1: default, 2: high)\n";
+	std::cout << "         -g : glottal source oscillator (0: oversampling, 1: band-limited)\n";
+	std::cout << "         -b : compare the quality and speed of coefficient update periods\n";
+	std::cout << "         -r : check that the stream level does not depend on the output sample rate\n";
+	std::cout << "         -d : write the samples of a stream with a fixed gain (32-bit float, little-endian)\n";
+	std::cout << "         -c : compare the samples with the samples written by -d (e.g. by a double precision build)\n";
+	std::cout << "         -s : minimum SNR in dB for -c (default: " << DEFAULT_MIN_SNR << ")\n" << std::endl;
+}
+
+/*******************************************************************************
+ * Synthesizes the input with several coefficient update periods, and compares
+ * the output with the output of period 1.
+ */
+void
+compareCoefficientUpdatePeriods(GS::TRM::ControlFrameBuffer& input)
+{
+	using namespace GS;
+	const int periodList[] = { 1, 2, 4, 8, 16, 32 };
+
+	std::vector<float> reference;
+	std::vector<float> output;
+	std::cout << "period  time (s)  speedup  SNR (dB)  max. error\n";
+	double referenceTime = 0.0;
+	for (int period : periodList) {
+		input.header().coefficientUpdatePeriod = period;
+
+		TRM::Tube trm;
+		auto t0 = std::chrono::steady_clock::now();
+		trm.synthesizeToBuffer(input, period == 1 ? reference : output);
+		auto t1 = std::chrono::steady_clock::now();
+		const double time = std::chrono::duration<double>(t1 - t0).count();
+
+		if (period == 1) {
+			referenceTime = time;
+			std::cout << std::setw(6) << period << std::fixed << std::setprecision(3)
+					<< std::setw(10) << time << std::setw(9) << 1.0
+					<< std::setw(10) << "-" << std::setw(12) << "-" << '\n';
+			continue;
+		}
+
+		double signalEnergy = 0.0;
+		double errorEnergy = 0.0;
+		double maxError = 0.0;
+		for (std::size_t i = 0, size = std::min(reference.size(), output.size()); i < size; ++i) {
+			const double error = output[i] - reference[i];
+			signalEnergy += reference[i] * reference[i];
+			errorEnergy += error * error;
+			maxError = std::max(maxError, std::abs(error));
+		}
+		const double snr = (errorEnergy > 0.0) ? 10.0 * std::log10(signalEnergy / errorEnergy) : INFINITY;
+		std::cout << std::setw(6) << period << std::fixed << std::setprecision(3)
+				<< std::setw(10) << time << std::setw(9) << referenceTime / time
+				<< std::setw(10) << std::setprecision(1) << snr
+				<< std::setw(12) << std::setprecision(5) << maxError << '\n';
+	}
+}
+
+/*******************************************************************************
+ * Synthesizes the input as a stream with a fixed gain. The output does not
+ * depend on the maximum sample value, unlike the normalized output.
+ */
+void
+synthesizeWithFixedGain(const GS::TRM::ControlFrameBuffer& input, std::vector<float>& output)
+{
+	using namespace GS;
+
+	TRM::Tube::StreamParameters parameters;
+	parameters.gainMode = TRM::Tube::STREAM_GAIN_FIXED;
+	output.clear();
+	TRM::Tube trm;
+	trm.beginStream(input.header(), parameters, [&](const float* samples, std::size_t numFrames) {
+		output.insert(output.end(), samples, samples + numFrames * trm.numChannels());
+	});
+	trm.synthesizeStream(input);
+	trm.endStream(input);
+}
+
+/*******************************************************************************
+ * Synthesizes the input as a stream with a fixed gain at several output sample
+ * rates, and compares the RMS level with the level at 44100 Hz.
+ *
+ * Returns false if a level differs by more than MAX_LEVEL_DIFFERENCE dB.
+ */
+bool
+compareOutputRates(GS::TRM::ControlFrameBuffer& input)
+{
+	using namespace GS;
+	const double MAX_LEVEL_DIFFERENCE = 0.1; // dB
+	const float rateList[] = { 44100.0f, 8000.0f, 16000.0f, 22050.0f };
+
+	std::vector<float> output;
+	bool ok = true;
+	double referenceLevel = 0.0;
+	std::cout << "rate (Hz)  RMS level (dB)  difference (dB)  clipped samples\n";
+	for (float rate : rateList) {
+		input.header().outputRate = rate;
+
+		synthesizeWithFixedGain(input, output);
+		double energy = 0.0;
+		std::size_t numClipped = 0;
+		for (float sample : output) {
+			energy += sample * sample;
+			if (std::abs(sample) >= 1.0f) ++numClipped;
+		}
+
+		const double level = (energy > 0.0) ? 10.0 * std::log10(energy / output.size()) : -INFINITY;
+		if (rate == rateList[0]) {
+			referenceLevel = level;
+		}
+		const double difference = level - referenceLevel;
+		if (!(std::abs(difference) <= MAX_LEVEL_DIFFERENCE)) {
+			ok = false;
+		}
+		std::cout << std::setw(9) << static_cast<int>(rate) << std::fixed << std::setprecision(2)
+				<< std::setw(16) << level << std::setw(17) << difference
+				<< std::setw(17) << numClipped << '\n';
+	}
+	if (!ok) {
+		std::cout << "The level differs by more than " << MAX_LEVEL_DIFFERENCE << " dB." << std::endl;
+	}
+	return ok;
+}
+
+/*******************************************************************************
+ * Writes the samples of a stream with a fixed gain to a file, as 32-bit
+ * little-endian floats.
+ */
+bool
+writeSamples(const GS::TRM::ControlFrameBuffer& input, const char* samplesFile)
+{
+	std::vector<float> output;
+	synthesizeWithFixedGain(input, output);
+
+	std::ofstream out(samplesFile, std::ios_base::out | std::ios_base::binary);
+	if (!out) {
+		std::cerr << "Could not open the file " << samplesFile << '.' << std::endl;
+		return false;
+	}
+	for (float sample : output) {
+		uint32_t value;
+		memcpy(&value, &sample, sizeof value);
+		const char bytes[4] = {
+			static_cast<char>(value), static_cast<char>(value >> 8),
+			static_cast<char>(value >> 16), static_cast<char>(value >> 24) };
+		out.write(bytes, 4);
+	}
+	return static_cast<bool>(out);
+}
+
+/*******************************************************************************
+ * Compares the samples of a stream with a fixed gain with the samples
+ * written by writeSamples, usually by a build with different options.
+ *
+ * Returns false if the SNR is below minSNR or the lengths differ.
+ */
+bool
+compareSamples(const GS::TRM::ControlFrameBuffer& input, const char* samplesFile, double minSNR)
+{
+	std::ifstream in(samplesFile, std::ios_base::in | std::ios_base::binary);
+	if (!in) {
+		std::cerr << "Could not open the file " << samplesFile << '.' << std::endl;
+		return false;
+	}
+	std::vector<float> reference;
+	unsigned char bytes[4];
+	while (in.read(reinterpret_cast<char*>(bytes), 4)) {
+		const uint32_t value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+		float sample;
+		memcpy(&sample, &value, sizeof sample);
+		reference.push_back(sample);
+	}
+
+	std::vector<float> output;
+	synthesizeWithFixedGain(input, output);
+	if (output.size() != reference.size()) {
+		std::cout << "The number of samples differs: " << output.size()
+				<< " (reference: " << reference.size() << ")." << std::endl;
+		return false;
+	}
+
+	double signalEnergy = 0.0;
+	double errorEnergy = 0.0;
+	double maxError = 0.0;
+	for (std::size_t i = 0; i < output.size(); ++i) {
+		const double error = output[i] - reference[i];
+		signalEnergy += reference[i] * reference[i];
+		errorEnergy += error * error;
+		maxError = std::max(maxError, std::abs(error));
+	}
+	const double snr = (errorEnergy > 0.0) ? 10.0 * std::log10(signalEnergy / errorEnergy) : INFINITY;
+	std::cout << std::fixed << std::setprecision(1) << "SNR: " << snr << " dB (minimum: " << minSNR
+			<< " dB), max. error: " << std::setprecision(7) << maxError << std::endl;
+	return snr >= minSNR;
+}
+
+} /* namespace */
+
 int
 main(int argc, char* argv[])
 {
@@ -35,19 +254,63 @@ main(int argc, char* argv[])
 
 	const char* inputFile = nullptr;
 	const char* outputFile = nullptr;
+	int coefficientUpdatePeriod = 1;
+	int sampleRateConverterQuality = TRM::SampleRateConverterBase::QUALITY_DEFAULT;
+	int glottalSourceOscillator = TRM::WavetableGlottalSourceBase::OSCILLATOR_OVERSAMPLING;
+	bool compare = false;
+	bool compareRates = false;
+	const char* dumpFile = nullptr;
+	const char* referenceFile = nullptr;
+	double minSNR = DEFAULT_MIN_SNR;
 
 	/*  PARSE THE COMMAND LINE  */
-	if (argc == 3) {
-		inputFile = argv[1];
-		outputFile = argv[2];
-	} else if ((argc == 4) && (strcmp("-v", argv[1]) == 0)) {
-		Log::debugEnabled = true;
-		inputFile = argv[2];
-		outputFile = argv[3];
+	int i = 1;
+	for ( ; i < argc && argv[i][0] == '-'; ++i) {
+		if (strcmp("-v", argv[i]) == 0) {
+			Log::debugEnabled = true;
+		} else if (strcmp("-b", argv[i]) == 0) {
+			compare = true;
+		} else if (strcmp("-r", argv[i]) == 0) {
+			compareRates = true;
+		} else if (strcmp("-d", argv[i]) == 0 && i + 1 < argc) {
+			dumpFile = argv[++i];
+		} else if (strcmp("-c", argv[i]) == 0 && i + 1 < argc) {
+			referenceFile = argv[++i];
+		} else if (strcmp("-s", argv[i]) == 0 && i + 1 < argc) {
+			minSNR = std::atof(argv[++i]);
+		} else if (strcmp("-k", argv[i]) == 0 && i + 1 < argc) {
+			coefficientUpdatePeriod = std::atoi(argv[++i]);
+			if (coefficientUpdatePeriod < 1) {
+				std::cerr << "Invalid coefficient update period: " << argv[i] << '.' << std::endl;
+				return 1;
+			}
+		} else if (strcmp("-q", argv[i]) == 0 && i + 1 < argc) {
+			sampleRateConverterQuality = std::atoi(argv[++i]);
+			if (sampleRateConverterQuality < TRM::SampleRateConverterBase::QUALITY_FAST ||
+					sampleRateConverterQuality > TRM::SampleRateConverterBase::QUALITY_HIGH) {
+				std::cerr << "Invalid sample rate converter quality: " << argv[i] << '.' << std::endl;
+				return 1;
+			}
+		} else if (strcmp("-g", argv[i]) == 0 && i + 1 < argc) {
+			glottalSourceOscillator = std::atoi(argv[++i]);
+			if (glottalSourceOscillator < TRM::WavetableGlottalSourceBase::OSCILLATOR_OVERSAMPLING ||
+					glottalSourceOscillator > TRM::WavetableGlottalSourceBase::OSCILLATOR_BAND_LIMITED) {
+				std::cerr << "Invalid glottal source oscillator: " << argv[i] << '.' << std::endl;
+				return 1;
+			}
+		} else {
+			showUsage(argv[0]);
+			return 1;
+		}
+	}
+	const bool singleInput = compare || compareRates || dumpFile || referenceFile;
+	if (singleInput && i == argc - 1) {
+		inputFile = argv[i];
+	} else if (!singleInput && i == argc - 2) {
+		inputFile = argv[i];
+		outputFile = argv[i + 1];
 	} else {
-		std::cout << "\nGnuspeechSA TRM " << PROGRAM_VERSION << "\n\n";
-		std::cerr << "Usage: " << argv[0] << " [-v] trm_param_file.txt output_file.wav\n";
-		std::cout << "         -v : verbose\n" << std::endl;
+		showUsage(argv[0]);
 		return 1;
 	}
 
@@ -57,8 +320,28 @@ main(int argc, char* argv[])
 		return 1;
 	}
 
+	TRM::ControlFrameBuffer input;
+	input.read(inputStream);
+
+	if (compare) {
+		compareCoefficientUpdatePeriods(input);
+		return 0;
+	}
+	if (compareRates) {
+		return compareOutputRates(input) ? 0 : 1;
+	}
+	if (dumpFile) {
+		return writeSamples(input, dumpFile) ? 0 : 1;
+	}
+	if (referenceFile) {
+		return compareSamples(input, referenceFile, minSNR) ? 0 : 1;
+	}
+
+	input.header().coefficientUpdatePeriod = coefficientUpdatePeriod;
+	input.header().sampleRateConverterQuality = sampleRateConverterQuality;
+	input.header().glottalSourceOscillator = glottalSourceOscillator;
 	TRM::Tube trm;
-	trm.synthesizeToFile(inputStream, outputFile);
+	trm.synthesizeToFile(input, outputFile);
 
 	LOG_DEBUG("\nWrote scaled samples to file: " << outputFile);
 
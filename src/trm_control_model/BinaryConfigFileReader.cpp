@@ -0,0 +1,362 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+#include "BinaryConfigFileReader.h"
+
+#include <cstring> /* memcmp, memcpy */
+#include <fstream>
+#include <utility> /* move */
+#include <vector>
+
+#include "Exception.h"
+#include "Model.h"
+
+
+
+namespace GS {
+namespace TRMControlModel {
+
+/*******************************************************************************
+ * Constructor.
+ */
+BinaryConfigFileReader::BinaryConfigFileReader(Model& model, const std::string& filePath)
+		: model_(model)
+		, filePath_(filePath)
+		, pos_(0)
+{
+}
+
+/*******************************************************************************
+ * Destructor.
+ */
+BinaryConfigFileReader::~BinaryConfigFileReader()
+{
+}
+
+/*******************************************************************************
+ * FNV-1a, 64 bits.
+ */
+std::uint64_t
+BinaryConfigFileReader::hash(const std::string& data)
+{
+	std::uint64_t h = 14695981039346656037ULL;
+	for (unsigned char c : data) {
+		h ^= c;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+bool
+BinaryConfigFileReader::loadModel(std::uint64_t sourceHash)
+{
+	{
+		std::ifstream in(filePath_.c_str(), std::ios_base::in | std::ios_base::binary);
+		if (!in) {
+			return false;
+		}
+		in.seekg(0, std::ios::end);
+		data_.resize(in.tellg());
+		in.seekg(0, std::ios::beg);
+		in.read(&data_[0], data_.size());
+		if (!in) {
+			return false;
+		}
+	}
+	pos_ = 0;
+
+	if (data_.size() < GS_TRM_CONTROL_MODEL_BINARY_CONFIG_MAGIC_SIZE + 4 + 8 ||
+			std::memcmp(readBytes(GS_TRM_CONTROL_MODEL_BINARY_CONFIG_MAGIC_SIZE),
+					GS_TRM_CONTROL_MODEL_BINARY_CONFIG_MAGIC,
+					GS_TRM_CONTROL_MODEL_BINARY_CONFIG_MAGIC_SIZE) != 0 ||
+			readUInt32() != GS_TRM_CONTROL_MODEL_BINARY_CONFIG_VERSION ||
+			readUInt64() != sourceHash) {
+		return false;
+	}
+
+	readCategories();
+	readParameters();
+	readSymbols();
+	readPostures();
+	readEquations();
+	readTransitions(false);
+	readTransitions(true);
+	readRules();
+
+	if (pos_ != data_.size()) {
+		THROW_EXCEPTION(TRMControlModelException, "Invalid data at the end of the file " << filePath_ << '.');
+	}
+
+	data_.clear();
+	return true;
+}
+
+const char*
+BinaryConfigFileReader::readBytes(std::size_t size)
+{
+	if (size > data_.size() - pos_) {
+		THROW_EXCEPTION(EndOfBufferException, "Unexpected end of the file " << filePath_ << '.');
+	}
+	const char* p = &data_[pos_];
+	pos_ += size;
+	return p;
+}
+
+std::uint32_t
+BinaryConfigFileReader::readUInt32()
+{
+	const unsigned char* p = reinterpret_cast<const unsigned char*>(readBytes(4));
+	return  static_cast<std::uint32_t>(p[0])
+		| (static_cast<std::uint32_t>(p[1]) << 8)
+		| (static_cast<std::uint32_t>(p[2]) << 16)
+		| (static_cast<std::uint32_t>(p[3]) << 24);
+}
+
+std::uint64_t
+BinaryConfigFileReader::readUInt64()
+{
+	std::uint64_t low = readUInt32();
+	std::uint64_t high = readUInt32();
+	return low | (high << 32);
+}
+
+float
+BinaryConfigFileReader::readFloat()
+{
+	std::uint32_t i = readUInt32();
+	float f;
+	std::memcpy(&f, &i, sizeof f);
+	return f;
+}
+
+bool
+BinaryConfigFileReader::readBool()
+{
+	return *readBytes(1) != 0;
+}
+
+std::string
+BinaryConfigFileReader::readString()
+{
+	std::uint32_t size = readUInt32();
+	return std::string(readBytes(size), size);
+}
+
+std::shared_ptr<Equation>
+BinaryConfigFileReader::readEquationRef()
+{
+	std::uint32_t groupIndex = readUInt32();
+	std::uint32_t index = readUInt32();
+	if (groupIndex == GS_TRM_CONTROL_MODEL_BINARY_CONFIG_NULL_INDEX) {
+		return std::shared_ptr<Equation>();
+	}
+	const auto& groupList = model_.equationGroupList();
+	if (groupIndex >= groupList.size() || index >= groupList[groupIndex].equationList.size()) {
+		THROW_EXCEPTION(TRMControlModelException, "Invalid equation index in the file " << filePath_ << '.');
+	}
+	return groupList[groupIndex].equationList[index];
+}
+
+std::shared_ptr<Transition>
+BinaryConfigFileReader::readTransitionRef(bool special)
+{
+	std::uint32_t groupIndex = readUInt32();
+	std::uint32_t index = readUInt32();
+	if (groupIndex == GS_TRM_CONTROL_MODEL_BINARY_CONFIG_NULL_INDEX) {
+		return std::shared_ptr<Transition>();
+	}
+	const auto& groupList = special ? model_.specialTransitionGroupList() : model_.transitionGroupList();
+	if (groupIndex >= groupList.size() || index >= groupList[groupIndex].transitionList.size()) {
+		THROW_EXCEPTION(TRMControlModelException, "Invalid transition index in the file " << filePath_ << '.');
+	}
+	return groupList[groupIndex].transitionList[index];
+}
+
+void
+BinaryConfigFileReader::readCategories()
+{
+	for (std::uint32_t i = 0, size = readUInt32(); i < size; ++i) {
+		std::shared_ptr<Category> newCategory(new Category(readString()));
+		newCategory->setComment(readString());
+		model_.categoryList().push_back(newCategory);
+	}
+}
+
+void
+BinaryConfigFileReader::readParameters()
+{
+	for (std::uint32_t i = 0, size = readUInt32(); i < size; ++i) {
+		std::string name   = readString();
+		float minimum      = readFloat();
+		float maximum      = readFloat();
+		float defaultValue = readFloat();
+		std::string comment = readString();
+
+		model_.parameterList().emplace_back(name, minimum, maximum, defaultValue, comment);
+	}
+}
+
+void
+BinaryConfigFileReader::readSymbols()
+{
+	for (std::uint32_t i = 0, size = readUInt32(); i < size; ++i) {
+		std::string name   = readString();
+		float minimum      = readFloat();
+		float maximum      = readFloat();
+		float defaultValue = readFloat();
+		std::string comment = readString();
+
+		model_.symbolList().emplace_back(name, minimum, maximum, defaultValue, comment);
+	}
+}
+
+void
+BinaryConfigFileReader::readPostures()
+{
+	const unsigned int numParameters = model_.parameterList().size();
+	const unsigned int numSymbols = model_.symbolList().size();
+
+	for (std::uint32_t i = 0, size = readUInt32(); i < size; ++i) {
+		std::unique_ptr<Posture> posture(new Posture(readString(), numParameters, numSymbols));
+
+		for (std::uint32_t j = 0, numCategories = readUInt32(); j < numCategories; ++j) {
+			std::uint32_t categoryIndex = readUInt32();
+			if (categoryIndex >= model_.categoryList().size()) {
+				THROW_EXCEPTION(TRMControlModelException, "Invalid category index in the file " << filePath_ << '.');
+			}
+			posture->categoryList().push_back(model_.categoryList()[categoryIndex]);
+		}
+		for (unsigned int j = 0; j < numParameters; ++j) {
+			posture->setParameterTarget(j, readFloat());
+		}
+		for (unsigned int j = 0; j < numSymbols; ++j) {
+			posture->setSymbolTarget(j, readFloat());
+		}
+		posture->setComment(readString());
+
+		model_.postureList().add(std::move(posture));
+	}
+}
+
+void
+BinaryConfigFileReader::readEquations()
+{
+	for (std::uint32_t i = 0, size = readUInt32(); i < size; ++i) {
+		EquationGroup group;
+		group.name = readString();
+
+		for (std::uint32_t j = 0, groupSize = readUInt32(); j < groupSize; ++j) {
+			std::shared_ptr<Equation> eq(new Equation(readString()));
+			eq->setFormula(readString());
+			eq->setComment(readString());
+			group.equationList.push_back(eq);
+		}
+
+		model_.equationGroupList().push_back(std::move(group));
+	}
+}
+
+void
+BinaryConfigFileReader::readTransitions(bool special)
+{
+	auto readPoint = [&](Transition::Point& point) {
+		point.type = static_cast<Transition::Point::Type>(readUInt32());
+		point.value = readFloat();
+		point.isPhantom = readBool();
+		point.timeExpression = readEquationRef();
+		point.freeTime = readFloat();
+	};
+
+	for (std::uint32_t i = 0, size = readUInt32(); i < size; ++i) {
+		TransitionGroup group;
+		group.name = readString();
+
+		for (std::uint32_t j = 0, groupSize = readUInt32(); j < groupSize; ++j) {
+			std::string name = readString();
+			Transition::Type type = static_cast<Transition::Type>(readUInt32());
+			std::shared_ptr<Transition> tr(new Transition(name, type, special));
+			tr->setComment(readString());
+
+			for (std::uint32_t k = 0, numPointOrSlopes = readUInt32(); k < numPointOrSlopes; ++k) {
+				if (!readBool()) {
+					std::unique_ptr<Transition::Point> p(new Transition::Point());
+					readPoint(*p);
+					tr->pointOrSlopeList().push_back(std::move(p));
+				} else {
+					std::unique_ptr<Transition::SlopeRatio> p(new Transition::SlopeRatio());
+					for (std::uint32_t n = 0, numPoints = readUInt32(); n < numPoints; ++n) {
+						std::unique_ptr<Transition::Point> p2(new Transition::Point());
+						readPoint(*p2);
+						p->pointList.push_back(std::move(p2));
+					}
+					for (std::uint32_t n = 0, numSlopes = readUInt32(); n < numSlopes; ++n) {
+						std::unique_ptr<Transition::Slope> p2(new Transition::Slope());
+						p2->slope = readFloat();
+						p2->displayTime = readFloat();
+						p->slopeList.push_back(std::move(p2));
+					}
+					tr->pointOrSlopeList().push_back(std::move(p));
+				}
+			}
+
+			group.transitionList.push_back(tr);
+		}
+
+		if (special) {
+			model_.specialTransitionGroupList().push_back(std::move(group));
+		} else {
+			model_.transitionGroupList().push_back(std::move(group));
+		}
+	}
+}
+
+void
+BinaryConfigFileReader::readRules()
+{
+	const unsigned int numParameters = model_.parameterList().size();
+
+	for (std::uint32_t i = 0, size = readUInt32(); i < size; ++i) {
+		std::unique_ptr<Rule> rule(new Rule(numParameters));
+
+		std::vector<std::string> exprList;
+		for (std::uint32_t j = 0, numExpressions = readUInt32(); j < numExpressions; ++j) {
+			exprList.push_back(readString());
+		}
+		rule->setBooleanExpressionList(exprList, model_);
+
+		for (unsigned int j = 0; j < numParameters; ++j) {
+			rule->setParamProfileTransition(j, readTransitionRef(false));
+		}
+		for (unsigned int j = 0; j < numParameters; ++j) {
+			rule->setSpecialProfileTransition(j, readTransitionRef(true));
+		}
+
+		Rule::ExpressionSymbolEquations& exprSymbolEquations = rule->exprSymbolEquations();
+		exprSymbolEquations.ruleDuration = readEquationRef();
+		exprSymbolEquations.beat         = readEquationRef();
+		exprSymbolEquations.mark1        = readEquationRef();
+		exprSymbolEquations.mark2        = readEquationRef();
+		exprSymbolEquations.mark3        = readEquationRef();
+
+		rule->setComment(readString());
+
+		model_.ruleList().push_back(std::move(rule));
+	}
+}
+
+} /* namespace TRMControlModel */
+} /* namespace GS */
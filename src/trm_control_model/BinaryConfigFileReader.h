@@ -0,0 +1,94 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+#ifndef TRM_CONTROL_MODEL_BINARY_CONFIG_FILE_READER_H_
+#define TRM_CONTROL_MODEL_BINARY_CONFIG_FILE_READER_H_
+
+#include <cstddef> /* std::size_t */
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#define GS_TRM_CONTROL_MODEL_BINARY_CONFIG_MAGIC "GSMODEL"
+#define GS_TRM_CONTROL_MODEL_BINARY_CONFIG_MAGIC_SIZE 8 /* with the null terminator */
+// Must be incremented when the format or the meaning of the data changes.
+#define GS_TRM_CONTROL_MODEL_BINARY_CONFIG_VERSION 1
+#define GS_TRM_CONTROL_MODEL_BINARY_CONFIG_NULL_INDEX 0xffffffffU
+
+
+
+namespace GS {
+namespace TRMControlModel {
+
+class Equation;
+class Model;
+class Transition;
+
+/*******************************************************************************
+ * Reads a model saved by BinaryConfigFileWriter.
+ *
+ * The numbers are stored in binary form, and the references to categories,
+ * equations and transitions are stored as indexes. Only the formulas and the
+ * boolean expressions of the rules are parsed.
+ */
+class BinaryConfigFileReader {
+public:
+	BinaryConfigFileReader(Model& model, const std::string& filePath);
+	~BinaryConfigFileReader();
+
+	// Loads the model.
+	//
+	// Returns false if the file could not be opened, or if it was created
+	// by another version of the format or from another source (sourceHash
+	// is different).
+	//
+	// Precondition: the model is empty.
+	bool loadModel(std::uint64_t sourceHash);
+
+	// Hash of the source XML, used to detect stale files.
+	static std::uint64_t hash(const std::string& data);
+private:
+	BinaryConfigFileReader(const BinaryConfigFileReader&) = delete;
+	BinaryConfigFileReader& operator=(const BinaryConfigFileReader&) = delete;
+
+	const char* readBytes(std::size_t size);
+	std::uint32_t readUInt32();
+	std::uint64_t readUInt64();
+	float readFloat();
+	bool readBool();
+	std::string readString();
+	std::shared_ptr<Equation> readEquationRef();
+	std::shared_ptr<Transition> readTransitionRef(bool special);
+
+	void readCategories();
+	void readParameters();
+	void readSymbols();
+	void readPostures();
+	void readEquations();
+	void readTransitions(bool special);
+	void readRules();
+
+	Model& model_;
+	std::string filePath_;
+	std::string data_;
+	std::size_t pos_;
+};
+
+} /* namespace TRMControlModel */
+} /* namespace GS */
+
+#endif /* TRM_CONTROL_MODEL_BINARY_CONFIG_FILE_READER_H_ */
@@ -0,0 +1,344 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+#include "BinaryConfigFileWriter.h"
+
+#include <cstdio> /* remove, rename */
+#include <cstring> /* memcpy */
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+# include <process.h>
+# define getpid _getpid
+#else
+# include <unistd.h>
+#endif
+
+#include "BinaryConfigFileReader.h"
+#include "Exception.h"
+#include "Model.h"
+
+
+
+namespace GS {
+namespace TRMControlModel {
+
+/*******************************************************************************
+ * Constructor.
+ */
+BinaryConfigFileWriter::BinaryConfigFileWriter(const Model& model, const std::string& filePath)
+		: model_(model)
+		, filePath_(filePath)
+		, out_(nullptr)
+{
+}
+
+/*******************************************************************************
+ * Destructor.
+ */
+BinaryConfigFileWriter::~BinaryConfigFileWriter()
+{
+}
+
+void
+BinaryConfigFileWriter::saveModel(std::uint64_t sourceHash)
+{
+	std::ostringstream tempFilePath;
+	tempFilePath << filePath_ << ".tmp" << getpid();
+
+	{
+		std::ofstream out(tempFilePath.str().c_str(), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		if (!out) {
+			THROW_EXCEPTION(IOException, "Could not open the file " << tempFilePath.str() << " for writing.");
+		}
+		out_ = &out;
+
+		out.write(GS_TRM_CONTROL_MODEL_BINARY_CONFIG_MAGIC, GS_TRM_CONTROL_MODEL_BINARY_CONFIG_MAGIC_SIZE);
+		writeUInt32(GS_TRM_CONTROL_MODEL_BINARY_CONFIG_VERSION);
+		writeUInt64(sourceHash);
+
+		writeCategories();
+		writeParameters();
+		writeSymbols();
+		writePostures();
+		writeEquations();
+		writeTransitions(false);
+		writeTransitions(true);
+		writeRules();
+
+		out_ = nullptr;
+		out.close();
+		if (!out) {
+			std::remove(tempFilePath.str().c_str());
+			THROW_EXCEPTION(IOException, "Could not write to the file " << tempFilePath.str() << '.');
+		}
+	}
+
+#ifdef _WIN32
+	std::remove(filePath_.c_str());
+#endif
+	if (std::rename(tempFilePath.str().c_str(), filePath_.c_str()) != 0) {
+		std::remove(tempFilePath.str().c_str());
+		THROW_EXCEPTION(IOException, "Could not rename the file " << tempFilePath.str() << " to " << filePath_ << '.');
+	}
+}
+
+void
+BinaryConfigFileWriter::writeUInt32(std::uint32_t data)
+{
+	char array[4];
+
+	array[0] =  data        & 0xff;
+	array[1] = (data >> 8)  & 0xff;
+	array[2] = (data >> 16) & 0xff;
+	array[3] = (data >> 24) & 0xff;
+
+	out_->write(array, 4);
+}
+
+void
+BinaryConfigFileWriter::writeUInt64(std::uint64_t data)
+{
+	writeUInt32(static_cast<std::uint32_t>(data));
+	writeUInt32(static_cast<std::uint32_t>(data >> 32));
+}
+
+void
+BinaryConfigFileWriter::writeFloat(float data)
+{
+	std::uint32_t i;
+	std::memcpy(&i, &data, sizeof i);
+	writeUInt32(i);
+}
+
+void
+BinaryConfigFileWriter::writeBool(bool data)
+{
+	out_->put(data ? 1 : 0);
+}
+
+void
+BinaryConfigFileWriter::writeString(const std::string& s)
+{
+	writeUInt32(s.size());
+	out_->write(s.data(), s.size());
+}
+
+void
+BinaryConfigFileWriter::writeEquationRef(const std::shared_ptr<Equation>& equation)
+{
+	if (!equation) {
+		writeUInt32(GS_TRM_CONTROL_MODEL_BINARY_CONFIG_NULL_INDEX);
+		writeUInt32(GS_TRM_CONTROL_MODEL_BINARY_CONFIG_NULL_INDEX);
+		return;
+	}
+	auto iter = equationIndexMap_.find(equation.get());
+	if (iter == equationIndexMap_.end()) {
+		THROW_EXCEPTION(TRMControlModelException, "Equation not found: " << equation->name() << '.');
+	}
+	writeUInt32(iter->second.first);
+	writeUInt32(iter->second.second);
+}
+
+void
+BinaryConfigFileWriter::writeTransitionRef(const std::shared_ptr<Transition>& transition)
+{
+	if (!transition) {
+		writeUInt32(GS_TRM_CONTROL_MODEL_BINARY_CONFIG_NULL_INDEX);
+		writeUInt32(GS_TRM_CONTROL_MODEL_BINARY_CONFIG_NULL_INDEX);
+		return;
+	}
+	auto iter = transitionIndexMap_.find(transition.get());
+	if (iter == transitionIndexMap_.end()) {
+		THROW_EXCEPTION(TRMControlModelException, "Transition not found: " << transition->name() << '.');
+	}
+	writeUInt32(iter->second.first);
+	writeUInt32(iter->second.second);
+}
+
+void
+BinaryConfigFileWriter::writeCategories()
+{
+	writeUInt32(model_.categoryList().size());
+	for (const auto& category : model_.categoryList()) {
+		writeString(category->name());
+		writeString(category->comment());
+	}
+}
+
+void
+BinaryConfigFileWriter::writeParameters()
+{
+	writeUInt32(model_.parameterList().size());
+	for (const auto& parameter : model_.parameterList()) {
+		writeString(parameter.name());
+		writeFloat(parameter.minimum());
+		writeFloat(parameter.maximum());
+		writeFloat(parameter.defaultValue());
+		writeString(parameter.comment());
+	}
+}
+
+void
+BinaryConfigFileWriter::writeSymbols()
+{
+	writeUInt32(model_.symbolList().size());
+	for (const auto& symbol : model_.symbolList()) {
+		writeString(symbol.name());
+		writeFloat(symbol.minimum());
+		writeFloat(symbol.maximum());
+		writeFloat(symbol.defaultValue());
+		writeString(symbol.comment());
+	}
+}
+
+void
+BinaryConfigFileWriter::writePostures()
+{
+	std::unordered_map<const Category*, std::uint32_t> categoryIndexMap;
+	for (std::uint32_t i = 0, size = model_.categoryList().size(); i < size; ++i) {
+		categoryIndexMap[model_.categoryList()[i].get()] = i;
+	}
+
+	const PostureList& postureList = model_.postureList();
+	writeUInt32(postureList.size());
+	for (std::uint32_t i = 0, size = postureList.size(); i < size; ++i) {
+		const Posture& posture = postureList[i];
+		writeString(posture.name());
+
+		// The native category is created by the Posture constructor.
+		std::uint32_t numCategories = 0;
+		for (const auto& category : posture.categoryList()) {
+			if (!category->native()) ++numCategories;
+		}
+		writeUInt32(numCategories);
+		for (const auto& category : posture.categoryList()) {
+			if (category->native()) continue;
+			auto iter = categoryIndexMap.find(category.get());
+			if (iter == categoryIndexMap.end()) {
+				THROW_EXCEPTION(TRMControlModelException, "Posture category not found: " << category->name() << '.');
+			}
+			writeUInt32(iter->second);
+		}
+
+		for (unsigned int j = 0, numParameters = model_.parameterList().size(); j < numParameters; ++j) {
+			writeFloat(posture.getParameterTarget(j));
+		}
+		for (unsigned int j = 0, numSymbols = model_.symbolList().size(); j < numSymbols; ++j) {
+			writeFloat(posture.getSymbolTarget(j));
+		}
+		writeString(posture.comment());
+	}
+}
+
+void
+BinaryConfigFileWriter::writeEquations()
+{
+	const auto& groupList = model_.equationGroupList();
+	writeUInt32(groupList.size());
+	for (std::uint32_t i = 0, size = groupList.size(); i < size; ++i) {
+		const EquationGroup& group = groupList[i];
+		writeString(group.name);
+		writeUInt32(group.equationList.size());
+		for (std::uint32_t j = 0, groupSize = group.equationList.size(); j < groupSize; ++j) {
+			const Equation& equation = *group.equationList[j];
+			writeString(equation.name());
+			writeString(equation.formula());
+			writeString(equation.comment());
+			equationIndexMap_[&equation] = GroupItemIndex(i, j);
+		}
+	}
+}
+
+void
+BinaryConfigFileWriter::writeTransitions(bool special)
+{
+	auto writePoint = [&](const Transition::Point& point) {
+		writeUInt32(point.type);
+		writeFloat(point.value);
+		writeBool(point.isPhantom);
+		writeEquationRef(point.timeExpression);
+		writeFloat(point.freeTime);
+	};
+
+	const auto& groupList = special ? model_.specialTransitionGroupList() : model_.transitionGroupList();
+	writeUInt32(groupList.size());
+	for (std::uint32_t i = 0, size = groupList.size(); i < size; ++i) {
+		const TransitionGroup& group = groupList[i];
+		writeString(group.name);
+		writeUInt32(group.transitionList.size());
+		for (std::uint32_t j = 0, groupSize = group.transitionList.size(); j < groupSize; ++j) {
+			const Transition& transition = *group.transitionList[j];
+			writeString(transition.name());
+			writeUInt32(transition.type());
+			writeString(transition.comment());
+
+			writeUInt32(transition.pointOrSlopeList().size());
+			for (const auto& pointOrSlope : transition.pointOrSlopeList()) {
+				writeBool(pointOrSlope->isSlopeRatio());
+				if (!pointOrSlope->isSlopeRatio()) {
+					writePoint(dynamic_cast<const Transition::Point&>(*pointOrSlope));
+				} else {
+					const auto& slopeRatio = dynamic_cast<const Transition::SlopeRatio&>(*pointOrSlope);
+					writeUInt32(slopeRatio.pointList.size());
+					for (const auto& point : slopeRatio.pointList) {
+						writePoint(*point);
+					}
+					writeUInt32(slopeRatio.slopeList.size());
+					for (const auto& slope : slopeRatio.slopeList) {
+						writeFloat(slope->slope);
+						writeFloat(slope->displayTime);
+					}
+				}
+			}
+
+			transitionIndexMap_[&transition] = GroupItemIndex(i, j);
+		}
+	}
+}
+
+void
+BinaryConfigFileWriter::writeRules()
+{
+	writeUInt32(model_.ruleList().size());
+	for (const auto& rule : model_.ruleList()) {
+		writeUInt32(rule->booleanExpressionList().size());
+		for (const std::string& expr : rule->booleanExpressionList()) {
+			writeString(expr);
+		}
+
+		for (const auto& transition : rule->paramProfileTransitionList()) {
+			writeTransitionRef(transition);
+		}
+		for (const auto& transition : rule->specialProfileTransitionList()) {
+			writeTransitionRef(transition);
+		}
+
+		const Rule::ExpressionSymbolEquations& exprSymbolEquations = rule->exprSymbolEquations();
+		writeEquationRef(exprSymbolEquations.ruleDuration);
+		writeEquationRef(exprSymbolEquations.beat);
+		writeEquationRef(exprSymbolEquations.mark1);
+		writeEquationRef(exprSymbolEquations.mark2);
+		writeEquationRef(exprSymbolEquations.mark3);
+
+		writeString(rule->comment());
+	}
+}
+
+} /* namespace TRMControlModel */
+} /* namespace GS */
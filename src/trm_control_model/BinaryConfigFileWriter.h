@@ -0,0 +1,80 @@
+/***************************************************************************
+ *  Copyright 2014 Marcelo Y. Matuda                                       *
+ *                                                                         *
+ *  This program is free software: you can redistribute it and/or modify   *
+ *  it under the terms of the GNU General Public License as published by   *
+ *  the Free Software Foundation, either version 3 of the License, or      *
+ *  (at your option) any later version.                                    *
+ *                                                                         *
+ *  This program is distributed in the hope that it will be useful,        *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of         *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *  GNU General Public License for more details.                           *
+ *                                                                         *
+ *  You should have received a copy of the GNU General Public License      *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.  *
+ ***************************************************************************/
+
+#ifndef TRM_CONTROL_MODEL_BINARY_CONFIG_FILE_WRITER_H_
+#define TRM_CONTROL_MODEL_BINARY_CONFIG_FILE_WRITER_H_
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility> /* pair */
+
+
+
+namespace GS {
+namespace TRMControlModel {
+
+class Equation;
+class Model;
+class Transition;
+
+/*******************************************************************************
+ * Saves the model in the format read by BinaryConfigFileReader.
+ */
+class BinaryConfigFileWriter {
+public:
+	BinaryConfigFileWriter(const Model& model, const std::string& filePath);
+	~BinaryConfigFileWriter();
+
+	// The file is written to a temporary file, which is then renamed,
+	// so a reader never sees a partial file.
+	void saveModel(std::uint64_t sourceHash);
+private:
+	typedef std::pair<std::uint32_t, std::uint32_t> GroupItemIndex;
+
+	BinaryConfigFileWriter(const BinaryConfigFileWriter&) = delete;
+	BinaryConfigFileWriter& operator=(const BinaryConfigFileWriter&) = delete;
+
+	void writeUInt32(std::uint32_t data);
+	void writeUInt64(std::uint64_t data);
+	void writeFloat(float data);
+	void writeBool(bool data);
+	void writeString(const std::string& s);
+	void writeEquationRef(const std::shared_ptr<Equation>& equation);
+	void writeTransitionRef(const std::shared_ptr<Transition>& transition);
+
+	void writeCategories();
+	void writeParameters();
+	void writeSymbols();
+	void writePostures();
+	void writeEquations();
+	void writeTransitions(bool special);
+	void writeRules();
+
+	const Model& model_;
+	std::string filePath_;
+	std::ostream* out_;
+	std::unordered_map<const Equation*, GroupItemIndex> equationIndexMap_;
+	std::unordered_map<const Transition*, GroupItemIndex> transitionIndexMap_;
+};
+
+} /* namespace TRMControlModel */
+} /* namespace GS */
+
+#endif /* TRM_CONTROL_MODEL_BINARY_CONFIG_FILE_WRITER_H_ */
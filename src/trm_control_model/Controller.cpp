@@ -21,6 +21,7 @@
 #include "Controller.h"
 
 #include <cstring>
+#include <fstream>
 #include <sstream>
 
 #include "Exception.h"
@@ -35,9 +36,10 @@
 namespace GS {
 namespace TRMControlModel {
 
-Controller::Controller(const char* configDirPath, Model& model)
+Controller::Controller(const char* configDirPath, const Model& model)
 		: model_(model)
 		, eventList_(configDirPath, model_)
+		, synthesisThreads_(1)
 {
 	loadConfiguration(configDirPath);
 }
@@ -72,49 +74,50 @@ Controller::loadConfiguration(const char* configDirPath)
 void
 Controller::synthesizeFromEventList(const char* trmParamFile, const char* outputFile)
 {
-	std::fstream trmParamStream(trmParamFile, std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
-	if (!trmParamStream) {
-		THROW_EXCEPTION(IOException, "Could not open the file " << trmParamFile << '.');
+	synthesizeFromEventList(frameBuffer_);
+	if (trmParamFile != nullptr) {
+		writeTRMParamFile(trmParamFile);
 	}
 
-	initUtterance(trmParamStream);
-
-	eventList_.generateOutput(trmParamStream);
-
-	trmParamStream.seekg(0);
-
-	TRM::Tube trm;
-	trm.synthesizeToFile(trmParamStream, outputFile);
+	tube_.synthesizeToFile(frameBuffer_, outputFile);
 }
 
 void
 Controller::synthesizeFromEventList(const char* trmParamFile, std::vector<float>& buffer)
 {
-	std::fstream trmParamStream(trmParamFile, std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
-	if (!trmParamStream) {
-		THROW_EXCEPTION(IOException, "Could not open the file " << trmParamFile << '.');
+	synthesizeFromEventList(frameBuffer_);
+	if (trmParamFile != nullptr) {
+		writeTRMParamFile(trmParamFile);
 	}
 
-	initUtterance(trmParamStream);
-
-	eventList_.generateOutput(trmParamStream);
+	tube_.synthesizeToBuffer(frameBuffer_, buffer);
+}
 
-	trmParamStream.seekg(0);
+void
+Controller::synthesizeFromEventList(TRM::ControlFrameBuffer& frameBuffer)
+{
+	initUtterance(frameBuffer);
 
-	TRM::Tube trm;
-	trm.synthesizeToBuffer(trmParamStream, buffer);
+	eventList_.generateOutput(frameBuffer);
 }
 
+/*******************************************************************************
+ * Writes the contents of frameBuffer_ in the trm_param file format.
+ */
 void
-Controller::initUtterance(std::ostream& trmParamStream)
+Controller::writeTRMParamFile(const char* trmParamFile)
 {
-	if ((trmConfig_.outputRate != 22050.0) && (trmConfig_.outputRate != 44100.0)) {
-		trmConfig_.outputRate = 44100.0;
-	}
-	if ((trmConfig_.vtlOffset + trmConfig_.vocalTractLength) < 15.9) {
-		trmConfig_.outputRate = 44100.0;
+	std::ofstream trmParamStream(trmParamFile, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	if (!trmParamStream) {
+		THROW_EXCEPTION(IOException, "Could not open the file " << trmParamFile << '.');
 	}
 
+	frameBuffer_.write(trmParamStream);
+}
+
+void
+Controller::initUtterance(TRM::ControlFrameBuffer& frameBuffer)
+{
 	if (Log::debugEnabled) {
 		printf("Tube Length = %f\n", trmConfig_.vtlOffset + trmConfig_.vocalTractLength);
 		printf("Voice: %s L: %f  tp: %f  tnMin: %f  tnMax: %f  glotPitch: %f\n", trmControlModelConfig_.voiceName.c_str(),
@@ -129,32 +132,36 @@ Controller::initUtterance(std::ostream& trmParamStream)
 	eventList_.setUpDriftGenerator(trmControlModelConfig_.driftDeviation, trmControlModelConfig_.controlRate, trmControlModelConfig_.driftLowpassCutoff);
 	eventList_.setRadiusCoef(trmConfig_.radiusCoef);
 
-	trmParamStream <<
-		trmConfig_.outputRate              << '\n' <<
-		trmControlModelConfig_.controlRate << '\n' <<
-		trmConfig_.volume                  << '\n' <<
-		trmConfig_.channels                << '\n' <<
-		trmConfig_.balance                 << '\n' <<
-		trmConfig_.waveform                << '\n' <<
-		trmConfig_.glottalPulseTp          << '\n' <<
-		trmConfig_.glottalPulseTnMin       << '\n' <<
-		trmConfig_.glottalPulseTnMax       << '\n' <<
-		trmConfig_.breathiness             << '\n' <<
-		trmConfig_.vtlOffset + trmConfig_.vocalTractLength << '\n' << // tube length
-		trmConfig_.temperature             << '\n' <<
-		trmConfig_.lossFactor              << '\n' <<
-		trmConfig_.apertureRadius          << '\n' <<
-		trmConfig_.mouthCoef               << '\n' <<
-		trmConfig_.noseCoef                << '\n' <<
-		trmConfig_.noseRadius[1]           << '\n' <<
-		trmConfig_.noseRadius[2]           << '\n' <<
-		trmConfig_.noseRadius[3]           << '\n' <<
-		trmConfig_.noseRadius[4]           << '\n' <<
-		trmConfig_.noseRadius[5]           << '\n' <<
-		trmConfig_.throatCutoff            << '\n' <<
-		trmConfig_.throatVol               << '\n' <<
-		trmConfig_.modulation              << '\n' <<
-		trmConfig_.mixOffset               << '\n';
+	frameBuffer.clear();
+
+	TRM::ControlFrameBuffer::Header& header = frameBuffer.header();
+	header.outputRate     = trmConfig_.outputRate;
+	header.controlRate    = trmControlModelConfig_.controlRate;
+	header.volume         = trmConfig_.volume;
+	header.channels       = trmConfig_.channels;
+	header.balance        = trmConfig_.balance;
+	header.waveform       = trmConfig_.waveform;
+	header.tp             = trmConfig_.glottalPulseTp;
+	header.tnMin          = trmConfig_.glottalPulseTnMin;
+	header.tnMax          = trmConfig_.glottalPulseTnMax;
+	header.breathiness    = trmConfig_.breathiness;
+	header.length         = trmConfig_.vtlOffset + trmConfig_.vocalTractLength; // tube length
+	header.temperature    = trmConfig_.temperature;
+	header.lossFactor     = trmConfig_.lossFactor;
+	header.apertureRadius = trmConfig_.apertureRadius;
+	header.mouthCoef      = trmConfig_.mouthCoef;
+	header.noseCoef       = trmConfig_.noseCoef;
+	header.noseRadius[0]  = 0.0;
+	for (int i = 1; i < TRM::ControlFrameBuffer::NUM_NOSE_SECTIONS; ++i) {
+		header.noseRadius[i] = trmConfig_.noseRadius[i];
+	}
+	header.throatCutoff   = trmConfig_.throatCutoff;
+	header.throatVol      = trmConfig_.throatVol;
+	header.modulation     = trmConfig_.modulation;
+	header.mixOffset      = trmConfig_.mixOffset;
+	header.coefficientUpdatePeriod = trmConfig_.coefficientUpdatePeriod;
+	header.sampleRateConverterQuality = trmConfig_.sampleRateConverterQuality;
+	header.glottalSourceOscillator    = trmConfig_.glottalSourceOscillator;
 }
 
 // Chunks are separated by /c.
@@ -22,13 +22,19 @@
 #define TRM_CONTROL_MODEL_CONTROLLER_H_
 
 #include <cstdio>
-#include <fstream>
+#include <exception>
 #include <istream>
+#include <memory>
+#include <thread>
+#include <utility> /* move */
 #include <vector>
 
+#include "BoundedQueue.h"
+#include "ControlFrameBuffer.h"
 #include "EventList.h"
 #include "Log.h"
 #include "Model.h"
+#include "ParallelTube.h"
 #include "TRMConfiguration.h"
 #include "TRMControlModelConfiguration.h"
 #include "Tube.h"
@@ -40,16 +46,27 @@ namespace TRMControlModel {
 
 class Controller {
 public:
-	Controller(const char* configDirPath, Model& model);
+	Controller(const char* configDirPath, const Model& model);
 	~Controller();
 
+	// trmParamFile may be null. If not null, the control frames are also written to this file.
 	template<typename T> void synthesizePhoneticString(T& phoneticStringParser, const char* phoneticString, const char* trmParamFile, const char* outputFile);
 	template<typename T> void synthesizePhoneticString(T& phoneticStringParser, const char* phoneticString, const char* trmParamFile, std::vector<float>& buffer);
 	template<typename T> void synthesizePhoneticString(T& phoneticStringParser, const char* phoneticString, std::iostream& trmParamStream);
+	template<typename T> void synthesizePhoneticString(T& phoneticStringParser, const char* phoneticString, TRM::ControlFrameBuffer& frameBuffer);
+	// The audio of each chunk of the phonetic string is sent to the callback as soon as it is synthesized.
+	template<typename T> void synthesizePhoneticStringToStream(T& phoneticStringParser, const char* phoneticString,
+									const TRM::Tube::StreamParameters& streamParameters, TRM::Tube::StreamCallback callback);
 	void synthesizeFromEventList(const char* trmParamFile, const char* outputFile);
 	void synthesizeFromEventList(const char* trmParamFile, std::vector<float>& buffer);
+	void synthesizeFromEventList(TRM::ControlFrameBuffer& frameBuffer);
 
-	Model& model() { return model_; }
+	// With more than one thread, the chunks of a phonetic string that is
+	// synthesized to a file or to a buffer are synthesized in parallel (see
+	// TRM::ParallelTube). The output is not identical.
+	void setSynthesisThreads(unsigned int numThreads) { synthesisThreads_ = numThreads; }
+
+	const Model& model() const { return model_; }
 	EventList& eventList() { return eventList_; }
 	Configuration& trmControlModelConfiguration() { return trmControlModelConfig_; }
 	TRM::Configuration& trmConfiguration() { return trmConfig_; }
@@ -57,12 +74,16 @@ private:
 	enum {
 		MAX_VOICES = 5
 	};
+	enum {
+		PIPELINE_QUEUE_SIZE = 2 /*  chunks waiting for the tube  */
+	};
 
 	Controller(const Controller&) = delete;
 	Controller& operator=(const Controller&) = delete;
 
 	void loadConfiguration(const char* configDirPath);
-	void initUtterance(std::ostream& trmParamStream);
+	void initUtterance(TRM::ControlFrameBuffer& frameBuffer);
+	void writeTRMParamFile(const char* trmParamFile);
 	int calcChunks(const char* string);
 	int nextChunk(const char* string);
 	void printVowelTransitions();
@@ -70,12 +91,21 @@ private:
 	int validPosture(const char* token);
 	void setIntonation(int intonation);
 
-	template<typename T> void synthesizePhoneticStringChunk(T& phoneticStringParser, const char* phoneticStringChunk, std::ostream& trmParamStream);
+	template<typename T> void synthesizePhoneticStringChunk(T& phoneticStringParser, const char* phoneticStringChunk, TRM::ControlFrameBuffer& frameBuffer);
+	// outputFile or outputBuffer must be null.
+	template<typename T> void synthesizePhoneticStringPipelined(T& phoneticStringParser, const char* phoneticString,
+									const char* outputFile, std::vector<float>* outputBuffer);
+	template<typename T> void synthesizePhoneticStringParallel(T& phoneticStringParser, const char* phoneticString,
+									const char* outputFile, std::vector<float>* outputBuffer);
 
-	Model& model_;
+	const Model& model_;
 	EventList eventList_;
+	unsigned int synthesisThreads_;
 	Configuration trmControlModelConfig_;
 	TRM::Configuration trmConfig_;
+	TRM::ControlFrameBuffer frameBuffer_;
+	TRM::Tube tube_;                     /*  reused in each utterance  */
+	std::unique_ptr<TRM::ParallelTube> parallelTube_;
 };
 
 
@@ -84,39 +114,57 @@ template<typename T>
 void
 Controller::synthesizePhoneticString(T& phoneticStringParser, const char* phoneticString, const char* trmParamFile, const char* outputFile)
 {
-	std::fstream trmParamStream(trmParamFile, std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
-	if (!trmParamStream) {
-		THROW_EXCEPTION(IOException, "Could not open the file " << trmParamFile << '.');
+	int chunks = calcChunks(phoneticString);
+	if (chunks > 1 && synthesisThreads_ > 1) {
+		synthesizePhoneticStringParallel(phoneticStringParser, phoneticString, outputFile, nullptr);
+	} else if (chunks > 1) {
+		synthesizePhoneticStringPipelined(phoneticStringParser, phoneticString, outputFile, nullptr);
+	} else {
+		synthesizePhoneticString(phoneticStringParser, phoneticString, frameBuffer_);
+		tube_.synthesizeToFile(frameBuffer_, outputFile);
 	}
 
-	synthesizePhoneticString(phoneticStringParser, phoneticString, trmParamStream);
-
-	TRM::Tube trm;
-	trm.synthesizeToFile(trmParamStream, outputFile);
+	if (trmParamFile != nullptr) {
+		writeTRMParamFile(trmParamFile);
+	}
 }
 
 template<typename T>
 void
 Controller::synthesizePhoneticString(T& phoneticStringParser, const char* phoneticString, const char* trmParamFile, std::vector<float>& buffer)
 {
-	std::fstream trmParamStream(trmParamFile, std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
-	if (!trmParamStream) {
-		THROW_EXCEPTION(IOException, "Could not open the file " << trmParamFile << '.');
+	int chunks = calcChunks(phoneticString);
+	if (chunks > 1 && synthesisThreads_ > 1) {
+		synthesizePhoneticStringParallel(phoneticStringParser, phoneticString, nullptr, &buffer);
+	} else if (chunks > 1) {
+		synthesizePhoneticStringPipelined(phoneticStringParser, phoneticString, nullptr, &buffer);
+	} else {
+		synthesizePhoneticString(phoneticStringParser, phoneticString, frameBuffer_);
+		tube_.synthesizeToBuffer(frameBuffer_, buffer);
 	}
 
-	synthesizePhoneticString(phoneticStringParser, phoneticString, trmParamStream);
-
-	TRM::Tube trm;
-	trm.synthesizeToBuffer(trmParamStream, buffer);
+	if (trmParamFile != nullptr) {
+		writeTRMParamFile(trmParamFile);
+	}
 }
 
 template<typename T>
 void
 Controller::synthesizePhoneticString(T& phoneticStringParser, const char* phoneticString, std::iostream& trmParamStream)
+{
+	synthesizePhoneticString(phoneticStringParser, phoneticString, frameBuffer_);
+	frameBuffer_.write(trmParamStream);
+
+	trmParamStream.seekg(0);
+}
+
+template<typename T>
+void
+Controller::synthesizePhoneticString(T& phoneticStringParser, const char* phoneticString, TRM::ControlFrameBuffer& frameBuffer)
 {
 	int chunks = calcChunks(phoneticString);
 
-	initUtterance(trmParamStream);
+	initUtterance(frameBuffer);
 
 	int index = 0;
 	while (chunks > 0) {
@@ -124,18 +172,43 @@ Controller::synthesizePhoneticString(T& phoneticStringParser, const char* phonet
 			printf("Speaking \"%s\"\n", &phoneticString[index]);
 		}
 
-		synthesizePhoneticStringChunk(phoneticStringParser, &phoneticString[index], trmParamStream);
+		synthesizePhoneticStringChunk(phoneticStringParser, &phoneticString[index], frameBuffer);
 
 		index += nextChunk(&phoneticString[index + 2]) + 2;
 		chunks--;
 	}
+}
 
-	trmParamStream.seekg(0);
+template<typename T>
+void
+Controller::synthesizePhoneticStringToStream(T& phoneticStringParser, const char* phoneticString,
+						const TRM::Tube::StreamParameters& streamParameters, TRM::Tube::StreamCallback callback)
+{
+	int chunks = calcChunks(phoneticString);
+
+	initUtterance(frameBuffer_);
+
+	tube_.beginStream(frameBuffer_.header(), streamParameters, callback);
+
+	int index = 0;
+	while (chunks > 0) {
+		if (Log::debugEnabled) {
+			printf("Speaking \"%s\"\n", &phoneticString[index]);
+		}
+
+		synthesizePhoneticStringChunk(phoneticStringParser, &phoneticString[index], frameBuffer_);
+		tube_.synthesizeStream(frameBuffer_);
+
+		index += nextChunk(&phoneticString[index + 2]) + 2;
+		chunks--;
+	}
+
+	tube_.endStream(frameBuffer_);
 }
 
 template<typename T>
 void
-Controller::synthesizePhoneticStringChunk(T& phoneticStringParser, const char* phoneticStringChunk, std::ostream& trmParamStream)
+Controller::synthesizePhoneticStringChunk(T& phoneticStringParser, const char* phoneticStringChunk, TRM::ControlFrameBuffer& frameBuffer)
 {
 	eventList_.setUp();
 
@@ -146,7 +219,123 @@ Controller::synthesizePhoneticStringChunk(T& phoneticStringParser, const char* p
 	eventList_.applyIntonation();
 	eventList_.applyIntonationSmooth();
 
-	eventList_.generateOutput(trmParamStream);
+	eventList_.generateOutput(frameBuffer);
+}
+
+/*******************************************************************************
+ * Synthesizes a phonetic string with several chunks in two stages.
+ *
+ * This thread generates the control frames of each chunk, while another
+ * thread runs the tube on the frames of the previous chunks. The tube
+ * thread appends the chunks to frameBuffer_, so at the end frameBuffer_
+ * contains the same frames as in the sequential synthesis, and the output
+ * is identical.
+ */
+template<typename T>
+void
+Controller::synthesizePhoneticStringPipelined(T& phoneticStringParser, const char* phoneticString,
+						const char* outputFile, std::vector<float>* outputBuffer)
+{
+	int chunks = calcChunks(phoneticString);
+
+	initUtterance(frameBuffer_);
+
+	tube_.beginSynthesis(frameBuffer_.header(), outputBuffer);
+
+	/*  A NULL CHUNK ENDS THE INPUT. THE QUEUE IS CLOSED IF A STAGE FAILS  */
+	BoundedQueue<std::unique_ptr<TRM::ControlFrameBuffer>> queue(PIPELINE_QUEUE_SIZE);
+	std::exception_ptr tubeError;
+	std::thread tubeThread([&]() {
+		try {
+			std::unique_ptr<TRM::ControlFrameBuffer> chunk;
+			while (queue.pop(chunk)) {
+				if (!chunk) {
+					if (outputFile != nullptr) {
+						tube_.finishToFile(frameBuffer_, outputFile);
+					} else {
+						tube_.finishToBuffer(frameBuffer_, *outputBuffer);
+					}
+					return;
+				}
+				frameBuffer_.addFrames(*chunk);
+				tube_.synthesizeFrames(frameBuffer_);
+			}
+		} catch (...) {
+			tubeError = std::current_exception();
+			queue.close();
+		}
+	});
+
+	try {
+		int index = 0;
+		while (chunks > 0) {
+			if (Log::debugEnabled) {
+				printf("Speaking \"%s\"\n", &phoneticString[index]);
+			}
+
+			std::unique_ptr<TRM::ControlFrameBuffer> chunk(new TRM::ControlFrameBuffer());
+			synthesizePhoneticStringChunk(phoneticStringParser, &phoneticString[index], *chunk);
+			if (!queue.push(std::move(chunk))) {
+				break; /*  THE TUBE HAS FAILED  */
+			}
+
+			index += nextChunk(&phoneticString[index + 2]) + 2;
+			chunks--;
+		}
+		queue.push(nullptr);
+	} catch (...) {
+		queue.close();
+		tubeThread.join();
+		throw;
+	}
+	tubeThread.join();
+
+	if (tubeError) {
+		std::rethrow_exception(tubeError);
+	}
+}
+
+/*******************************************************************************
+ * Synthesizes a phonetic string with several chunks using several threads.
+ *
+ * The control frames of all the chunks are generated in sequence, so the
+ * frames are the same as in the sequential synthesis. Then the tube
+ * synthesizes the frames of each chunk in a separate segment, and the
+ * segments are joined at the silences between the chunks.
+ */
+template<typename T>
+void
+Controller::synthesizePhoneticStringParallel(T& phoneticStringParser, const char* phoneticString,
+						const char* outputFile, std::vector<float>* outputBuffer)
+{
+	int chunks = calcChunks(phoneticString);
+
+	initUtterance(frameBuffer_);
+
+	std::vector<std::size_t> splitFrames;
+	int index = 0;
+	while (chunks > 0) {
+		if (Log::debugEnabled) {
+			printf("Speaking \"%s\"\n", &phoneticString[index]);
+		}
+
+		if (index > 0) {
+			splitFrames.push_back(frameBuffer_.size());
+		}
+		synthesizePhoneticStringChunk(phoneticStringParser, &phoneticString[index], frameBuffer_);
+
+		index += nextChunk(&phoneticString[index + 2]) + 2;
+		chunks--;
+	}
+
+	if (!parallelTube_ || parallelTube_->numThreads() != synthesisThreads_) {
+		parallelTube_.reset(new TRM::ParallelTube(synthesisThreads_));
+	}
+	if (outputFile != nullptr) {
+		parallelTube_->synthesizeToFile(frameBuffer_, splitFrames, outputFile);
+	} else {
+		parallelTube_->synthesizeToBuffer(frameBuffer_, splitFrames, *outputBuffer);
+	}
 }
 
 } /* namespace TRMControlModel */
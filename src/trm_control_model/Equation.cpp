@@ -18,6 +18,7 @@
 #include "Equation.h"
 
 #include <cctype> /* isspace */
+#include <cstddef> /* std::size_t */
 
 #include "Exception.h"
 #include "Log.h"
@@ -267,6 +268,51 @@ FormulaNodeParser::parse()
 	return formulaRoot;
 }
 
+void
+addConstInstruction(FormulaProgram& program, float value)
+{
+	FormulaInstruction instr;
+	instr.opcode = FormulaInstruction::OP_CONST;
+	instr.value = value;
+	program.push_back(instr);
+}
+
+/*******************************************************************************
+ * If both operands are constants, they are replaced by the result.
+ *
+ * The code of a subexpression that is not a constant always ends with an
+ * operator, so if the last two instructions are constants, they are the
+ * complete operands.
+ */
+void
+addBinaryOpInstruction(FormulaProgram& program, FormulaInstruction::Opcode opcode)
+{
+	const std::size_t size = program.size();
+	if (size >= 2 &&
+			program[size - 2].opcode == FormulaInstruction::OP_CONST &&
+			program[size - 1].opcode == FormulaInstruction::OP_CONST) {
+		const float a = program[size - 2].value;
+		const float b = program[size - 1].value;
+		float res;
+		switch (opcode) {
+		case FormulaInstruction::OP_ADD:  res = a + b; break;
+		case FormulaInstruction::OP_SUB:  res = a - b; break;
+		case FormulaInstruction::OP_MULT: res = a * b; break;
+		case FormulaInstruction::OP_DIV:  res = a / b; break;
+		default:
+			THROW_EXCEPTION(GS::InvalidParameterException, "Invalid binary operator: " << opcode << '.');
+		}
+		program.pop_back();
+		program.back().value = res;
+		return;
+	}
+
+	FormulaInstruction instr;
+	instr.opcode = opcode;
+	instr.value = 0.0;
+	program.push_back(instr);
+}
+
 } /* namespace */
 
 //==============================================================================
@@ -291,6 +337,21 @@ FormulaMinusUnaryOp::print(std::ostream& out, int level) const
 	out << prefix << "]" << std::endl;
 }
 
+void
+FormulaMinusUnaryOp::compile(FormulaProgram& program) const
+{
+	child_->compile(program);
+	if (program.back().opcode == FormulaInstruction::OP_CONST) {
+		program.back().value = -program.back().value;
+		return;
+	}
+
+	FormulaInstruction instr;
+	instr.opcode = FormulaInstruction::OP_MINUS;
+	instr.value = 0.0;
+	program.push_back(instr);
+}
+
 float
 FormulaAddBinaryOp::eval(const FormulaSymbolList& symbolList) const
 {
@@ -309,6 +370,14 @@ FormulaAddBinaryOp::print(std::ostream& out, int level) const
 	out << prefix << "]" << std::endl;
 }
 
+void
+FormulaAddBinaryOp::compile(FormulaProgram& program) const
+{
+	child1_->compile(program);
+	child2_->compile(program);
+	addBinaryOpInstruction(program, FormulaInstruction::OP_ADD);
+}
+
 float
 FormulaSubBinaryOp::eval(const FormulaSymbolList& symbolList) const
 {
@@ -327,6 +396,14 @@ FormulaSubBinaryOp::print(std::ostream& out, int level) const
 	out << prefix << "]" << std::endl;
 }
 
+void
+FormulaSubBinaryOp::compile(FormulaProgram& program) const
+{
+	child1_->compile(program);
+	child2_->compile(program);
+	addBinaryOpInstruction(program, FormulaInstruction::OP_SUB);
+}
+
 float
 FormulaMultBinaryOp::eval(const FormulaSymbolList& symbolList) const
 {
@@ -345,6 +422,14 @@ FormulaMultBinaryOp::print(std::ostream& out, int level) const
 	out << prefix << "]" << std::endl;
 }
 
+void
+FormulaMultBinaryOp::compile(FormulaProgram& program) const
+{
+	child1_->compile(program);
+	child2_->compile(program);
+	addBinaryOpInstruction(program, FormulaInstruction::OP_MULT);
+}
+
 float
 FormulaDivBinaryOp::eval(const FormulaSymbolList& symbolList) const
 {
@@ -363,6 +448,14 @@ FormulaDivBinaryOp::print(std::ostream& out, int level) const
 	out << prefix << "]" << std::endl;
 }
 
+void
+FormulaDivBinaryOp::compile(FormulaProgram& program) const
+{
+	child1_->compile(program);
+	child2_->compile(program);
+	addBinaryOpInstruction(program, FormulaInstruction::OP_DIV);
+}
+
 float
 FormulaConst::eval(const FormulaSymbolList& /*symbolList*/) const
 {
@@ -375,6 +468,12 @@ FormulaConst::print(std::ostream& out, int level) const
 	out << std::string(level * 8, ' ') << "const=" << value_ << std::endl;
 }
 
+void
+FormulaConst::compile(FormulaProgram& program) const
+{
+	addConstInstruction(program, value_);
+}
+
 float
 FormulaSymbolValue::eval(const FormulaSymbolList& symbolList) const
 {
@@ -387,6 +486,15 @@ FormulaSymbolValue::print(std::ostream& out, int level) const
 	out << std::string(level * 8, ' ') << "symbol=" << symbol_ << std::endl;
 }
 
+void
+FormulaSymbolValue::compile(FormulaProgram& program) const
+{
+	FormulaInstruction instr;
+	instr.opcode = FormulaInstruction::OP_SYMBOL;
+	instr.symbol = symbol_;
+	program.push_back(instr);
+}
+
 /*******************************************************************************
  *
  */
@@ -396,21 +504,72 @@ Equation::setFormula(const std::string& formula)
 	FormulaNodeParser p(formula);
 	FormulaNode_ptr tempFormulaRoot = p.parse();
 
+	FormulaProgram tempFormulaProgram;
+	tempFormulaRoot->compile(tempFormulaProgram);
+
+	int stackSize = 0;
+	for (const FormulaInstruction& instr : tempFormulaProgram) {
+		switch (instr.opcode) {
+		case FormulaInstruction::OP_CONST:
+		case FormulaInstruction::OP_SYMBOL:
+			if (++stackSize > MAX_STACK_SIZE) {
+				THROW_EXCEPTION(TRMControlModelException, "Formula too complex: " << formula << '.');
+			}
+			break;
+		case FormulaInstruction::OP_MINUS:
+			break;
+		default:
+			--stackSize;
+		}
+	}
+
 	formula_ = formula;
 	std::swap(tempFormulaRoot, formulaRoot_);
+	std::swap(tempFormulaProgram, formulaProgram_);
 }
 
 /*******************************************************************************
- *
+ * Executes the program of the formula.
  */
 float
 Equation::evalFormula(const FormulaSymbolList& symbolList) const
 {
-	if (!formulaRoot_) {
+	if (formulaProgram_.empty()) {
 		THROW_EXCEPTION(InvalidStateException, "Empty formula.");
 	}
 
-	return formulaRoot_->eval(symbolList);
+	float stack[MAX_STACK_SIZE];
+	int top = -1;
+	for (const FormulaInstruction& instr : formulaProgram_) {
+		switch (instr.opcode) {
+		case FormulaInstruction::OP_CONST:
+			stack[++top] = instr.value;
+			break;
+		case FormulaInstruction::OP_SYMBOL:
+			stack[++top] = symbolList[instr.symbol];
+			break;
+		case FormulaInstruction::OP_MINUS:
+			stack[top] = -stack[top];
+			break;
+		case FormulaInstruction::OP_ADD:
+			--top;
+			stack[top] = stack[top] + stack[top + 1];
+			break;
+		case FormulaInstruction::OP_SUB:
+			--top;
+			stack[top] = stack[top] - stack[top + 1];
+			break;
+		case FormulaInstruction::OP_MULT:
+			--top;
+			stack[top] = stack[top] * stack[top + 1];
+			break;
+		case FormulaInstruction::OP_DIV:
+			--top;
+			stack[top] = stack[top] / stack[top + 1];
+			break;
+		}
+	}
+	return stack[0];
 }
 
 /*******************************************************************************
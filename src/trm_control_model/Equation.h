@@ -31,12 +31,35 @@
 namespace GS {
 namespace TRMControlModel {
 
+// Instruction of the stack machine that evaluates the formulas.
+struct FormulaInstruction {
+	enum Opcode {
+		OP_CONST,  // push value
+		OP_SYMBOL, // push symbolList[symbol]
+		OP_MINUS,  // unary minus
+		OP_ADD,
+		OP_SUB,
+		OP_MULT,
+		OP_DIV
+	};
+	Opcode opcode;
+	union {
+		float value;
+		FormulaSymbol::Code symbol;
+	};
+};
+
+// Postfix sequence of instructions.
+typedef std::vector<FormulaInstruction> FormulaProgram;
+
 class FormulaNode {
 public:
 	virtual ~FormulaNode() {}
 
 	virtual float eval(const FormulaSymbolList& symbolList) const = 0;
 	virtual void print(std::ostream& out, int level = 0) const = 0;
+	// Appends the instructions to the program. Constant subexpressions are folded.
+	virtual void compile(FormulaProgram& program) const = 0;
 };
 
 typedef std::unique_ptr<FormulaNode> FormulaNode_ptr;
@@ -49,6 +72,7 @@ public:
 
 	virtual float eval(const FormulaSymbolList& symbolList) const;
 	virtual void print(std::ostream& out, int level = 0) const;
+	virtual void compile(FormulaProgram& program) const;
 private:
 	FormulaNode_ptr child_;
 };
@@ -61,6 +85,7 @@ public:
 
 	virtual float eval(const FormulaSymbolList& symbolList) const;
 	virtual void print(std::ostream& out, int level = 0) const;
+	virtual void compile(FormulaProgram& program) const;
 private:
 	FormulaNode_ptr child1_;
 	FormulaNode_ptr child2_;
@@ -74,6 +99,7 @@ public:
 
 	virtual float eval(const FormulaSymbolList& symbolList) const;
 	virtual void print(std::ostream& out, int level = 0) const;
+	virtual void compile(FormulaProgram& program) const;
 private:
 	FormulaNode_ptr child1_;
 	FormulaNode_ptr child2_;
@@ -87,6 +113,7 @@ public:
 
 	virtual float eval(const FormulaSymbolList& symbolList) const;
 	virtual void print(std::ostream& out, int level = 0) const;
+	virtual void compile(FormulaProgram& program) const;
 private:
 	FormulaNode_ptr child1_;
 	FormulaNode_ptr child2_;
@@ -100,6 +127,7 @@ public:
 
 	virtual float eval(const FormulaSymbolList& symbolList) const;
 	virtual void print(std::ostream& out, int level = 0) const;
+	virtual void compile(FormulaProgram& program) const;
 private:
 	FormulaNode_ptr child1_;
 	FormulaNode_ptr child2_;
@@ -113,6 +141,7 @@ public:
 
 	virtual float eval(const FormulaSymbolList& symbolList) const;
 	virtual void print(std::ostream& out, int level = 0) const;
+	virtual void compile(FormulaProgram& program) const;
 private:
 	float value_;
 };
@@ -125,6 +154,7 @@ public:
 
 	virtual float eval(const FormulaSymbolList& symbolList) const;
 	virtual void print(std::ostream& out, int level = 0) const;
+	virtual void compile(FormulaProgram& program) const;
 private:
 	FormulaSymbol::Code symbol_;
 };
@@ -149,10 +179,15 @@ public:
 
 	friend std::ostream& operator<<(std::ostream& out, const Equation& equation);
 private:
+	enum {
+		MAX_STACK_SIZE = 64
+	};
+
 	std::string name_;
 	std::string formula_;
 	std::string comment_;
-	FormulaNode_ptr formulaRoot_;
+	FormulaNode_ptr formulaRoot_; // used only by operator<<
+	FormulaProgram formulaProgram_;
 };
 
 struct EquationGroup {
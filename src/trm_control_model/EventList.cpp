@@ -20,6 +20,7 @@
 
 #include "EventList.h"
 
+#include <algorithm> /* fill, lower_bound */
 #include <cstring>
 #include <iomanip>
 #include <sstream>
@@ -33,33 +34,69 @@
 
 #define INTONATION_CONFIG_FILE_NAME "/intonation"
 #define EPS (1.0e-6)
+#define EVENT_BLOCK_SIZE 256
 
 
 
-namespace GS {
-namespace TRMControlModel {
+namespace {
 
-Event::Event() : time(0), flag(0)
+/*******************************************************************************
+ * Writes numFrames values of a parameter, which is the sum of two linear
+ * ramps (the parameter and its special parameter), and advances the ramps.
+ *
+ * The ramps are accumulated frame by frame, as in the original per-frame
+ * loop, so that the values are not changed by the rasterization.
+ */
+void
+rasterizeRamps(float* out, int numFrames, double& value, double delta, double& special, double specialDelta)
 {
-	for (int i = 0; i < EVENTS_SIZE; ++i) {
-		events[i] = GS_EVENTLIST_INVALID_EVENT_VALUE;
+	if (delta != 0.0 && specialDelta != 0.0) {
+		for (int k = 0; k < numFrames; ++k) {
+			out[k] = (float) value + (float) special;
+			value += delta;
+			special += specialDelta;
+		}
+	} else if (delta != 0.0) {
+		const float s = (float) special;
+		for (int k = 0; k < numFrames; ++k) {
+			out[k] = (float) value + s;
+			value += delta;
+		}
+	} else if (specialDelta != 0.0) {
+		const float v = (float) value;
+		for (int k = 0; k < numFrames; ++k) {
+			out[k] = v + (float) special;
+			special += specialDelta;
+		}
+	} else {
+		const float v = (float) value + (float) special;
+		for (int k = 0; k < numFrames; ++k) {
+			out[k] = v;
+		}
 	}
 }
 
-EventList::EventList(const char* configDirPath, Model& model)
+} /* namespace */
+
+namespace GS {
+namespace TRMControlModel {
+
+EventList::EventList(const char* configDirPath, const Model& model)
 		: model_(model)
 		, macroFlag_(0)
 		, microFlag_(0)
 		, driftFlag_(0)
 		, smoothIntonation_(1)
 		, globalTempo_(1.0)
+		, numEvents_(0)
+		, listUpdated_(true)
 		, tgParameters_(5)
 		, useFixedIntonationParameters_(false)
 		, randSrc_(randDev_())
 {
 	setUp();
 
-	list_.reserve(128);
+	formulaSymbolList_.fill(0.0f);
 
 	initToneGroups(configDirPath);
 
@@ -78,10 +115,15 @@ EventList::~EventList()
 void
 EventList::setUp()
 {
+	numEvents_ = 0;
+	eventTable_.clear();
 	list_.clear();
+	listUpdated_ = true;
+	for (int i = 0; i < NUM_TRACKS; ++i) {
+		track_[i].clear();
+	}
 
 	zeroRef_ = 0;
-	zeroIndex_ = 0;
 	duration_ = 0;
 	timeQuantization_ = 4;
 
@@ -360,60 +402,83 @@ EventList::insertEvent(int number, double time, double value)
 	//	tempTime++;
 	//}
 
-	if (list_.empty()) {
-		std::unique_ptr<Event> tempEvent(new Event());
-		tempEvent->time = tempTime;
-		if (number >= 0) {
-			tempEvent->setValue(value, number);
-		}
-		list_.push_back(std::move(tempEvent));
-		return list_.back().get();
+	const unsigned int tableIndex = tempTime >> 2;
+	if (tableIndex >= eventTable_.size()) {
+		eventTable_.resize(tableIndex + 1U, nullptr);
 	}
-
-	int i;
-	for (i = list_.size() - 1; i >= zeroIndex_; i--) {
-		if (list_[i]->time == tempTime) {
-			if (number >= 0) {
-				list_[i]->setValue(value, number);
-			}
-			return list_[i].get();
-		}
-		if (list_[i]->time < tempTime) {
-			std::unique_ptr<Event> tempEvent(new Event());
-			tempEvent->time = tempTime;
-			if (number >= 0) {
-				tempEvent->setValue(value, number);
+	Event*& event = eventTable_[tableIndex];
+	if (!event) {
+		event = newEvent(tempTime);
+	}
+	if (number >= 0) {
+		/*  THE VALUES ARE USUALLY INSERTED IN TIME ORDER  */
+		std::vector<EventValue>& track = track_[number];
+		if (track.empty() || track.back().time < tempTime) {
+			track.emplace_back(tempTime, value);
+		} else {
+			auto iter = std::lower_bound(track.begin(), track.end(), tempTime,
+					[](const EventValue& v, int t) { return v.time < t; });
+			if (iter->time == tempTime) {
+				iter->value = value;
+			} else {
+				track.insert(iter, EventValue(tempTime, value));
 			}
-			list_.insert(list_.begin() + (i + 1), std::move(tempEvent));
-			return list_[i + 1].get();
 		}
 	}
+	return event;
+}
 
-	std::unique_ptr<Event> tempEvent(new Event());
-	tempEvent->time = tempTime;
-	if (number >= 0) {
-		tempEvent->setValue(value, number);
+/*******************************************************************************
+ * Returns the value of the track at the time of an event, or
+ * GS_EVENTLIST_INVALID_EVENT_VALUE if the event does not have a value in
+ * the track.
+ */
+double
+EventList::eventValue(int number, int time) const
+{
+	const std::vector<EventValue>& track = track_[number];
+	auto iter = std::lower_bound(track.begin(), track.end(), time,
+			[](const EventValue& v, int t) { return v.time < t; });
+	if (iter == track.end() || iter->time != time) {
+		return GS_EVENTLIST_INVALID_EVENT_VALUE;
 	}
-	list_.insert(list_.begin() + (i + 1), std::move(tempEvent));
-	return list_[i + 1].get();
+	return iter->value;
 }
 
-void
-EventList::setZeroRef(int newValue)
+Event*
+EventList::newEvent(int time)
 {
-	zeroRef_ = newValue;
-	zeroIndex_ = 0;
-
-	if (list_.empty()) {
-		return;
+	const unsigned int blockIndex = numEvents_ / EVENT_BLOCK_SIZE;
+	if (blockIndex == eventBlockList_.size()) {
+		eventBlockList_.push_back(std::unique_ptr<Event[]>(new Event[EVENT_BLOCK_SIZE]));
 	}
+	Event* event = &eventBlockList_[blockIndex][numEvents_ % EVENT_BLOCK_SIZE];
+	++numEvents_;
 
-	for (int i = list_.size() - 1; i >= 0; i--) {
-		if (list_[i]->time < newValue) {
-			zeroIndex_ = i;
-			return;
+	*event = Event();
+	event->time = time;
+	listUpdated_ = false;
+	return event;
+}
+
+void
+EventList::updateList()
+{
+	if (listUpdated_) return;
+
+	list_.clear();
+	for (Event* event : eventTable_) {
+		if (event) {
+			list_.push_back(event);
 		}
 	}
+	listUpdated_ = true;
+}
+
+void
+EventList::setZeroRef(int newValue)
+{
+	zeroRef_ = newValue;
 }
 
 double
@@ -426,11 +491,11 @@ EventList::createSlopeRatioEvents(
 	double startValue;
 	double pointTime, pointValue;
 
-	Transition::getPointData(*slopeRatio.pointList.front(), model_, pointTime, pointValue);
+	Transition::getPointData(*slopeRatio.pointList.front(), formulaSymbolList_, pointTime, pointValue);
 	baseTime = pointTime;
 	startValue = pointValue;
 
-	Transition::getPointData(*slopeRatio.pointList.back(), model_, pointTime, pointValue);
+	Transition::getPointData(*slopeRatio.pointList.back(), formulaSymbolList_, pointTime, pointValue);
 	endTime = pointTime;
 	delta = pointValue - startValue;
 
@@ -443,8 +508,8 @@ EventList::createSlopeRatioEvents(
 		temp1 = slopeRatio.slopeList[i - 1]->slope / temp; /* Calculate normal slope */
 
 		/* Calculate time interval */
-		intervalTime = Transition::getPointTime(*slopeRatio.pointList[i], model_)
-				- Transition::getPointTime(*slopeRatio.pointList[i - 1], model_);
+		intervalTime = Transition::getPointTime(*slopeRatio.pointList[i], formulaSymbolList_)
+				- Transition::getPointTime(*slopeRatio.pointList[i - 1], formulaSymbolList_);
 
 		/* Apply interval percentage to slope */
 		temp1 = temp1 * (intervalTime / totalTime);
@@ -465,14 +530,14 @@ EventList::createSlopeRatioEvents(
 		const Transition::Point& point = *slopeRatio.pointList[i];
 
 		if (i >= 1 && i < slopeRatio.pointList.size() - 1) {
-			pointTime = Transition::getPointTime(point, model_);
+			pointTime = Transition::getPointTime(point, formulaSymbolList_);
 
 			pointValue = newPointValues[i - 1];
 			pointValue *= factor;
 			pointValue += temp;
 			temp = pointValue;
 		} else {
-			Transition::getPointData(point, model_, pointTime, pointValue);
+			Transition::getPointData(point, formulaSymbolList_, pointTime, pointValue);
 		}
 
 		value = baseline + ((pointValue / 100.0) * parameterDelta);
@@ -501,7 +566,7 @@ EventList::applyRule(const Rule& rule, const std::vector<const Posture*>& postur
 	double targets[4];
 	Event* tempEvent = nullptr;
 
-	rule.evaluateExpressionSymbols(tempos, postureList, model_, ruleSymbols);
+	rule.evaluateExpressionSymbols(tempos, postureList, formulaSymbolList_, ruleSymbols);
 
 	multiplier_ = 1.0 / (double) (postureData_[postureIndex].ruleTempo);
 
@@ -601,7 +666,7 @@ EventList::applyRule(const Rule& rule, const std::vector<const Posture*>& postur
 						currentValueDelta = targets[currentType - 1] - lastValue;
 					}
 					double pointTime;
-					Transition::getPointData(point, model_,
+					Transition::getPointData(point, formulaSymbolList_,
 									targets[currentType - 2], currentValueDelta, min_[i], max_[i],
 									pointTime, value);
 					if (!point.isPhantom) {
@@ -625,7 +690,7 @@ EventList::applyRule(const Rule& rule, const std::vector<const Posture*>& postur
 				const auto& point = dynamic_cast<const Transition::Point&>(pointOrSlope);
 
 				/* calculate time of event */
-				tempTime = Transition::getPointTime(point, model_);
+				tempTime = Transition::getPointTime(point, formulaSymbolList_);
 
 				/* Calculate value of event */
 				value = ((point.value / 100.0) * (max_[i] - min_[i]));
@@ -710,8 +775,7 @@ void
 EventList::setFullTimeScale()
 {
 	zeroRef_ = 0;
-	zeroIndex_ = 0;
-	duration_ = list_.back()->time + 100;
+	duration_ = (eventTable_.size() - 1U) * 4 + 100;
 }
 
 void
@@ -725,8 +789,7 @@ EventList::applyIntonation()
 	double randomSemitone, randomSlope;
 
 	zeroRef_ = 0;
-	zeroIndex_ = 0;
-	duration_ = list_.back()->time + 100;
+	duration_ = (eventTable_.size() - 1U) * 4 + 100;
 
 	intonationPoints_.clear();
 
@@ -962,27 +1025,36 @@ EventList::addIntonationPoint(double semitone, double offsetTime, double slope,
 	intonationPoints_.push_back(iPoint);
 }
 
+/*******************************************************************************
+ * Interpolates the values of the tracks between the events.
+ *
+ * trackPos[i] is the position of the first value of track i that is not
+ * before the current event, so the next value of a track is found without
+ * scanning the following events.
+ */
 void
-EventList::generateOutput(std::ostream& trmParamStream)
+EventList::generateOutput(TRM::ControlFrameBuffer& frameBuffer)
 {
 	double currentValues[36];
 	double currentDeltas[36];
-	double temp;
-	float table[16];
+	std::size_t trackPos[NUM_TRACKS];
+	const EventValue* eventValues[NUM_TRACKS];
 
+	updateList();
 	if (list_.empty()) {
 		return;
 	}
 
+	/*  SKIP THE VALUES OF THE FIRST EVENT  */
+	for (int i = 0; i < NUM_TRACKS; i++) {
+		trackPos[i] = (!track_[i].empty() && track_[i][0].time == list_[0]->time) ? 1 : 0;
+	}
+
 	for (int i = 0; i < 16; i++) {
-		unsigned int j = 1;
-		while ((temp = list_[j]->getValue(i)) == GS_EVENTLIST_INVALID_EVENT_VALUE) {
-			j++;
-			if (j >= list_.size()) break;
-		}
-		currentValues[i] = list_[0]->getValue(i);
-		if (j < list_.size()) {
-			currentDeltas[i] = ((temp - currentValues[i]) / (double) (list_[j]->time)) * 4.0;
+		currentValues[i] = trackPos[i] ? track_[i][0].value : GS_EVENTLIST_INVALID_EVENT_VALUE;
+		if (trackPos[i] < track_[i].size()) {
+			const EventValue& next = track_[i][trackPos[i]];
+			currentDeltas[i] = ((next.value - currentValues[i]) / (double) (next.time)) * 4.0;
 		} else {
 			currentDeltas[i] = 0.0;
 		}
@@ -992,73 +1064,56 @@ EventList::generateOutput(std::ostream& trmParamStream)
 	}
 
 	if (smoothIntonation_) {
-		unsigned int j = 0;
-		while ((temp = list_[j]->getValue(32)) == GS_EVENTLIST_INVALID_EVENT_VALUE) {
-			j++;
-			if (j >= list_.size()) break;
-		}
-		if (j < list_.size()) {
-			currentValues[32] = list_[j]->getValue(32);
+		if (!track_[32].empty()) {
+			currentValues[32] = track_[32][0].value;
 		} else {
 			currentValues[32] = 0.0;
 		}
 		currentDeltas[32] = 0.0;
 	} else {
-		unsigned int j = 1;
-		while ((temp = list_[j]->getValue(32)) == GS_EVENTLIST_INVALID_EVENT_VALUE) {
-			j++;
-			if (j >= list_.size()) break;
-		}
-		currentValues[32] = list_[0]->getValue(32);
-		if (j < list_.size()) {
-			currentDeltas[32] = ((temp - currentValues[32]) / (double) (list_[j]->time)) * 4.0;
+		currentValues[32] = trackPos[32] ? track_[32][0].value : GS_EVENTLIST_INVALID_EVENT_VALUE;
+		if (trackPos[32] < track_[32].size()) {
+			const EventValue& next = track_[32][trackPos[32]];
+			currentDeltas[32] = ((next.value - currentValues[32]) / (double) (next.time)) * 4.0;
 		} else {
 			currentDeltas[32] = 0.0;
 		}
 		currentValues[32] = -20.0;
 	}
 
+	/*  THE FRAMES ARE RASTERIZED IN SPANS BETWEEN EVENTS, AND THE
+	    PITCH CONTRIBUTIONS AND THE RADIUS COEFFICIENTS ARE APPLIED
+	    IN SEPARATE PASSES  */
+	const std::size_t firstFrame = frameBuffer.size();
+	std::vector<float> macroIntonation;
+
 	unsigned int index = 1;
 	int currentTime = 0;
-	int nextTime = list_[1]->time;
+	int nextTime = (list_.size() > 1) ? list_[1]->time : 0;
 	while (index < list_.size()) {
+		/*  FRAMES UNTIL THE NEXT EVENT IS REACHED (AT LEAST ONE)  */
+		const int numFrames = (nextTime - currentTime > 4) ? (nextTime - currentTime + 3) / 4 : 1;
+		const std::size_t pos = frameBuffer.addFrames(numFrames);
 
 		for (int j = 0; j < 16; j++) {
-			table[j] = (float) currentValues[j] + (float) currentValues[j + 16];
-		}
-		if (!microFlag_) table[0] = 0.0;
-		if (driftFlag_)  table[0] += static_cast<float>(driftGenerator_.drift());
-		if (macroFlag_)  table[0] += static_cast<float>(currentValues[32]);
-
-		table[0] += static_cast<float>(pitchMean_);
-
-		//trmParamStream << std::fixed << std::setprecision(3);
-		trmParamStream << table[0];
-		for (int k = 1; k < 7; ++k) {
-			trmParamStream << ' ' << table[k];
+			rasterizeRamps(frameBuffer.parameterData(j) + pos, numFrames,
+					currentValues[j], currentDeltas[j], currentValues[j + 16], currentDeltas[j + 16]);
 		}
-		for (int k = 7; k < 15; ++k) { // R1 - R8
-			trmParamStream << ' ' << table[k] * radiusCoef[k - 7];
-		}
-		trmParamStream << ' ' << table[15];
-		trmParamStream << '\n';
 
-		for (int j = 0; j < 32; j++) {
-			if (currentDeltas[j]) {
-				currentValues[j] += currentDeltas[j];
-			}
-		}
+		for (int k = 0; k < numFrames; ++k) {
+			if (macroFlag_) macroIntonation.push_back(static_cast<float>(currentValues[32]));
 
-		if (smoothIntonation_) {
-			currentDeltas[34] += currentDeltas[35];
-			currentDeltas[33] += currentDeltas[34];
-			currentValues[32] += currentDeltas[33];
-		} else {
-			if (currentDeltas[32]) {
-				currentValues[32] += currentDeltas[32];
+			if (smoothIntonation_) {
+				currentDeltas[34] += currentDeltas[35];
+				currentDeltas[33] += currentDeltas[34];
+				currentValues[32] += currentDeltas[33];
+			} else {
+				if (currentDeltas[32]) {
+					currentValues[32] += currentDeltas[32];
+				}
 			}
 		}
-		currentTime += 4;
+		currentTime += 4 * numFrames;
 
 		if (currentTime >= nextTime) {
 			++index;
@@ -1066,34 +1121,68 @@ EventList::generateOutput(std::ostream& trmParamStream)
 				break;
 			}
 			nextTime = list_[index]->time;
+
+			/*  GET THE VALUES OF THE EVENT THAT HAS BEEN REACHED  */
+			const int eventTime = list_[index - 1]->time;
+			for (int j = 0; j < NUM_TRACKS; j++) {
+				if (trackPos[j] < track_[j].size() && track_[j][trackPos[j]].time == eventTime) {
+					eventValues[j] = &track_[j][trackPos[j]++];
+				} else {
+					eventValues[j] = nullptr;
+				}
+			}
+
 			for (int j = 0; j < 33; j++) { /* 32? 33? */
-				if (list_[index - 1]->getValue(j) != GS_EVENTLIST_INVALID_EVENT_VALUE) {
-					unsigned int k = index;
-					while ((temp = list_[k]->getValue(j)) == GS_EVENTLIST_INVALID_EVENT_VALUE) {
-						if (k >= list_.size() - 1U) {
-							currentDeltas[j] = 0.0;
-							break;
-						}
-						k++;
-					}
-					if (temp != GS_EVENTLIST_INVALID_EVENT_VALUE) {
-						currentDeltas[j] = (temp - currentValues[j]) /
-									(double) (list_[k]->time - currentTime) * 4.0;
+				if (eventValues[j]) {
+					if (trackPos[j] < track_[j].size()) {
+						const EventValue& next = track_[j][trackPos[j]];
+						currentDeltas[j] = (next.value - currentValues[j]) /
+									(double) (next.time - currentTime) * 4.0;
+					} else {
+						currentDeltas[j] = 0.0;
 					}
 				}
 			}
 			if (smoothIntonation_) {
-				if (list_[index - 1]->getValue(33) != GS_EVENTLIST_INVALID_EVENT_VALUE) {
-					currentValues[32] = list_[index - 1]->getValue(32);
+				if (eventValues[33]) {
+					currentValues[32] = eventValues[32] ? eventValues[32]->value : GS_EVENTLIST_INVALID_EVENT_VALUE;
 					currentDeltas[32] = 0.0;
-					currentDeltas[33] = list_[index - 1]->getValue(33);
-					currentDeltas[34] = list_[index - 1]->getValue(34);
-					currentDeltas[35] = list_[index - 1]->getValue(35);
+					currentDeltas[33] = eventValues[33]->value;
+					currentDeltas[34] = eventValues[34] ? eventValues[34]->value : GS_EVENTLIST_INVALID_EVENT_VALUE;
+					currentDeltas[35] = eventValues[35] ? eventValues[35]->value : GS_EVENTLIST_INVALID_EVENT_VALUE;
 				}
 			}
 		}
 	}
 
+	const std::size_t numFrames = frameBuffer.size() - firstFrame;
+	float* pitch = frameBuffer.parameterData(TRM::Tube::PARAM_GLOT_PITCH) + firstFrame;
+	if (!microFlag_) {
+		std::fill(pitch, pitch + numFrames, 0.0f);
+	}
+	if (driftFlag_) {
+		for (std::size_t k = 0; k < numFrames; ++k) {
+			pitch[k] += static_cast<float>(driftGenerator_.drift());
+		}
+	}
+	if (macroFlag_) {
+		for (std::size_t k = 0; k < numFrames; ++k) {
+			pitch[k] += macroIntonation[k];
+		}
+	}
+	const float pitchMean = static_cast<float>(pitchMean_);
+	for (std::size_t k = 0; k < numFrames; ++k) {
+		pitch[k] += pitchMean;
+	}
+
+	for (int j = TRM::Tube::PARAM_R1; j <= TRM::Tube::PARAM_R8; ++j) {
+		float* radius = frameBuffer.parameterData(j) + firstFrame;
+		const double coef = radiusCoef[j - TRM::Tube::PARAM_R1];
+		for (std::size_t k = 0; k < numFrames; ++k) {
+			radius[k] *= coef;
+		}
+	}
+
 	if (Log::debugEnabled) {
 		printDataStructures();
 	}
@@ -1102,11 +1191,8 @@ EventList::generateOutput(std::ostream& trmParamStream)
 void
 EventList::clearMacroIntonation()
 {
-	for (unsigned int i = 0, size = list_.size(); i < size; ++i) {
-		auto& event = list_[i];
-		for (unsigned int j = 32; j < 36; ++j) {
-			event->setValue(GS_EVENTLIST_INVALID_EVENT_VALUE, j);
-		}
+	for (int i = 32; i < NUM_TRACKS; ++i) {
+		track_[i].clear();
 	}
 }
 
@@ -1137,21 +1223,22 @@ EventList::printDataStructures()
 			ruleData_[i].lastPosture, ruleData_[i].duration);
 	}
 #if 0
+	updateList();
 	printf("\nEvents %lu\n", list_.size());
 	for (unsigned int i = 0; i < list_.size(); i++) {
 		const Event& event = *list_[i];
 		printf("  Event: time=%d flag=%d\n    Values: ", event.time, event.flag);
 
 		for (int j = 0; j < 16; j++) {
-			printf("%.3f ", event.getValue(j));
+			printf("%.3f ", eventValue(j, event.time));
 		}
 		printf("\n            ");
 		for (int j = 16; j < 32; j++) {
-			printf("%.3f ", event.getValue(j));
+			printf("%.3f ", eventValue(j, event.time));
 		}
 		printf("\n            ");
-		for (int j = 32; j < Event::EVENTS_SIZE; j++) {
-			printf("%.3f ", event.getValue(j));
+		for (int j = 32; j < NUM_TRACKS; j++) {
+			printf("%.3f ", eventValue(j, event.time));
 		}
 		printf("\n");
 	}
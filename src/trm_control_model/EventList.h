@@ -23,10 +23,10 @@
 
 #include <limits> /* std::numeric_limits<double>::infinity() */
 #include <memory>
-#include <ostream>
 #include <random>
 #include <vector>
 
+#include "ControlFrameBuffer.h"
 #include "DriftGenerator.h"
 #include "IntonationPoint.h"
 #include "Model.h"
@@ -99,34 +99,36 @@ struct RuleData {
 		, beat(0.0) {}
 };
 
+// The values of the events are stored in the tracks of the EventList.
 struct Event {
-	enum {
-		EVENTS_SIZE = 36
-	};
-	Event();
-
-	void setValue(double value, int index) {
-		if (index < 0) return;
-		events[index] = value;
-	}
-	double getValue(int index) const {
-		return events[index];
-	}
+	Event() : time(0), flag(0) {}
 
 	int time;
 	int flag;
-	double events[EVENTS_SIZE];
 };
-typedef std::unique_ptr<Event> Event_ptr;
+
+// A value of a track, at the time of an event.
+struct EventValue {
+	int time;
+	double value;
+	EventValue(int time, double value)
+		: time(time)
+		, value(value) {}
+};
 
 
 
 class EventList {
 public:
-	EventList(const char* configDirPath, Model& model);
+	enum {
+		NUM_TRACKS = 36 /*  0-15: parameters, 16-31: special parameters, 32-35: intonation  */
+	};
+
+	EventList(const char* configDirPath, const Model& model);
 	~EventList();
 
-	const std::vector<Event_ptr>& list() const { return list_; }
+	// The events sorted by time.
+	const std::vector<Event*>& list() { updateList(); return list_; }
 	std::vector<IntonationPoint>& intonationPoints() { return intonationPoints_; }
 
 	void setPitchMean(double newMean) { pitchMean_ = newMean; }
@@ -167,7 +169,7 @@ public:
 	void generateEventList();
 	void applyIntonation();
 	void applyIntonationSmooth();
-	void generateOutput(std::ostream& trmParamStream);
+	void generateOutput(TRM::ControlFrameBuffer& frameBuffer);
 	void clearMacroIntonation();
 
 	void setUpDriftGenerator(double deviation, double sampleRate, double lowpassCutoff);
@@ -192,16 +194,19 @@ private:
 	void setFullTimeScale();
 	void newPosture();
 	Event* insertEvent(int number, double time, double value);
+	double eventValue(int number, int time) const;
+	Event* newEvent(int time);
+	void updateList();
 	void setZeroRef(int newValue);
 	void applyRule(const Rule& rule, const std::vector<const Posture*>& postureList, const double* tempos, int postureIndex);
 	void printDataStructures();
 	double createSlopeRatioEvents(const Transition::SlopeRatio& slopeRatio,
 			double baseline, double parameterDelta, double min, double max, int eventIndex);
 
-	Model& model_;
+	const Model& model_;
+	FormulaSymbolList formulaSymbolList_;
 
 	int zeroRef_;
-	int zeroIndex_;
 	int duration_;
 	int timeQuantization_;
 	int macroFlag_;
@@ -232,7 +237,16 @@ private:
 	double max_[16];
 
 	std::vector<IntonationPoint> intonationPoints_;
-	std::vector<Event_ptr> list_;
+	// The events are allocated in blocks, which are reused in setUp().
+	std::vector<std::unique_ptr<Event[]>> eventBlockList_;
+	unsigned int numEvents_;
+	// Index: time / 4. The times of the events are multiples of 4.
+	std::vector<Event*> eventTable_;
+	std::vector<Event*> list_;
+	bool listUpdated_;
+	// One track per event number, sorted by time. Each event has a
+	// value only in the tracks that have been set at its time.
+	std::vector<EventValue> track_[NUM_TRACKS];
 	DriftGenerator driftGenerator_;
 
 	bool tgUseRandom_;
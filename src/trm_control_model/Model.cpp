@@ -22,14 +22,21 @@
 
 #include "Model.h"
 
-#include <algorithm> /* sort */
+#include <algorithm> /* min, sort */
+#include <cstdint>
+#include <exception>
 #include <iostream>
 #include <utility> /* make_pair */
 
+#include "BinaryConfigFileReader.h"
+#include "BinaryConfigFileWriter.h"
 #include "Log.h"
+#include "RapidXmlUtil.h"
 #include "XMLConfigFileReader.h"
 #include "XMLConfigFileWriter.h"
 
+#define MODEL_CACHE_FILE_SUFFIX ".cache"
+
 
 
 namespace GS {
@@ -39,6 +46,7 @@ namespace TRMControlModel {
  * Constructor.
  */
 Model::Model()
+		: ruleSetSize_(0)
 {
 }
 
@@ -62,11 +70,13 @@ Model::clear()
 	equationGroupList_.clear();
 	transitionGroupList_.clear();
 	specialTransitionGroupList_.clear();
-	formulaSymbolList_.fill(0.0f);
+	updateRuleIndex();
 }
 
 /*******************************************************************************
- *
+ * The model is loaded from the binary cache (configFileName + ".cache"), if it
+ * was created from the same XML. Otherwise the XML is parsed, and the cache is
+ * updated, if possible.
  */
 void
 Model::load(const char* configDirPath, const char* configFileName)
@@ -75,11 +85,36 @@ Model::load(const char* configDirPath, const char* configFileName)
 
 	try {
 		std::string filePath = std::string(configDirPath) + configFileName;
+		std::string cacheFilePath = filePath + MODEL_CACHE_FILE_SUFFIX;
+
+		std::string source = readXMLFile(filePath);
+		const std::uint64_t sourceHash = BinaryConfigFileReader::hash(source);
+
+		try {
+			BinaryConfigFileReader cache(*this, cacheFilePath);
+			if (cache.loadModel(sourceHash)) {
+				LOG_DEBUG("Loaded the cached configuration: " << cacheFilePath);
+				updateRuleIndex();
+				return;
+			}
+		} catch (std::exception& e) {
+			LOG_ERROR("Invalid model cache " << cacheFilePath << " (ignored): " << e.what());
+		}
+		clear();
 
 		// Load the configuration file.
 		LOG_DEBUG("Loading xml configuration: " << filePath);
 		XMLConfigFileReader cfg(*this, filePath);
-		cfg.loadModel();
+		cfg.loadModel(source);
+		updateRuleIndex();
+
+		try {
+			BinaryConfigFileWriter cache(*this, cacheFilePath);
+			cache.saveModel(sourceHash);
+		} catch (std::exception& e) {
+			// The directory may be read-only.
+			LOG_DEBUG("Could not save the model cache: " << e.what());
+		}
 	} catch (...) {
 		clear();
 		throw;
@@ -318,87 +353,51 @@ Model::findCategoryName(const std::string& name) const
  *
  */
 void
-Model::clearFormulaSymbolList()
-{
-	formulaSymbolList_.fill(0.0);
-}
-
-/*******************************************************************************
- *
- */
-void
-Model::setFormulaSymbolValue(FormulaSymbol::Code symbol, float value)
-{
-	formulaSymbolList_[symbol] = value;
-}
-
-/*******************************************************************************
- *
- */
-float
-Model::getFormulaSymbolValue(FormulaSymbol::Code symbol) const
-{
-	return formulaSymbolList_[symbol];
-}
-
-/*******************************************************************************
- *
- */
-void
-Model::setDefaultFormulaSymbols(Transition::Type transitionType)
-{
-	setFormulaSymbolValue(FormulaSymbol::SYMB_TRANSITION1, 33.3333f);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_TRANSITION2, 33.3333f);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_TRANSITION3, 33.3333f);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_TRANSITION4, 33.3333f);
-
-	setFormulaSymbolValue(FormulaSymbol::SYMB_QSSA1      , 33.3333f);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_QSSA2      , 33.3333f);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_QSSA3      , 33.3333f);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_QSSA4      , 33.3333f);
-
-	setFormulaSymbolValue(FormulaSymbol::SYMB_QSSB1      , 33.3333f);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_QSSB2      , 33.3333f);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_QSSB3      , 33.3333f);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_QSSB4      , 33.3333f);
-
-	setFormulaSymbolValue(FormulaSymbol::SYMB_TEMPO1, 1.0);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_TEMPO2, 1.0);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_TEMPO3, 1.0);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_TEMPO4, 1.0);
-
-	setFormulaSymbolValue(FormulaSymbol::SYMB_BEAT ,  33.0);
-	setFormulaSymbolValue(FormulaSymbol::SYMB_MARK1, 100.0);
+Model::setDefaultFormulaSymbols(Transition::Type transitionType, FormulaSymbolList& symbolList)
+{
+	symbolList[FormulaSymbol::SYMB_TRANSITION1] = 33.3333f;
+	symbolList[FormulaSymbol::SYMB_TRANSITION2] = 33.3333f;
+	symbolList[FormulaSymbol::SYMB_TRANSITION3] = 33.3333f;
+	symbolList[FormulaSymbol::SYMB_TRANSITION4] = 33.3333f;
+
+	symbolList[FormulaSymbol::SYMB_QSSA1]       = 33.3333f;
+	symbolList[FormulaSymbol::SYMB_QSSA2]       = 33.3333f;
+	symbolList[FormulaSymbol::SYMB_QSSA3]       = 33.3333f;
+	symbolList[FormulaSymbol::SYMB_QSSA4]       = 33.3333f;
+
+	symbolList[FormulaSymbol::SYMB_QSSB1]       = 33.3333f;
+	symbolList[FormulaSymbol::SYMB_QSSB2]       = 33.3333f;
+	symbolList[FormulaSymbol::SYMB_QSSB3]       = 33.3333f;
+	symbolList[FormulaSymbol::SYMB_QSSB4]       = 33.3333f;
+
+	symbolList[FormulaSymbol::SYMB_TEMPO1] = 1.0;
+	symbolList[FormulaSymbol::SYMB_TEMPO2] = 1.0;
+	symbolList[FormulaSymbol::SYMB_TEMPO3] = 1.0;
+	symbolList[FormulaSymbol::SYMB_TEMPO4] = 1.0;
+
+	symbolList[FormulaSymbol::SYMB_BEAT]  =  33.0;
+	symbolList[FormulaSymbol::SYMB_MARK1] = 100.0;
 	switch (transitionType) {
 	case Transition::TYPE_DIPHONE:
-		setFormulaSymbolValue(FormulaSymbol::SYMB_RD   , 100.0);
-		setFormulaSymbolValue(FormulaSymbol::SYMB_MARK2,   0.0);
-		setFormulaSymbolValue(FormulaSymbol::SYMB_MARK3,   0.0);
+		symbolList[FormulaSymbol::SYMB_RD]    = 100.0;
+		symbolList[FormulaSymbol::SYMB_MARK2] =   0.0;
+		symbolList[FormulaSymbol::SYMB_MARK3] =   0.0;
 		break;
 	case Transition::TYPE_TRIPHONE:
-		setFormulaSymbolValue(FormulaSymbol::SYMB_RD   , 200.0);
-		setFormulaSymbolValue(FormulaSymbol::SYMB_MARK2, 200.0);
-		setFormulaSymbolValue(FormulaSymbol::SYMB_MARK3,   0.0);
+		symbolList[FormulaSymbol::SYMB_RD]    = 200.0;
+		symbolList[FormulaSymbol::SYMB_MARK2] = 200.0;
+		symbolList[FormulaSymbol::SYMB_MARK3] =   0.0;
 		break;
 	case Transition::TYPE_TETRAPHONE:
-		setFormulaSymbolValue(FormulaSymbol::SYMB_RD   , 300.0);
-		setFormulaSymbolValue(FormulaSymbol::SYMB_MARK2, 200.0);
-		setFormulaSymbolValue(FormulaSymbol::SYMB_MARK3, 300.0);
+		symbolList[FormulaSymbol::SYMB_RD]    = 300.0;
+		symbolList[FormulaSymbol::SYMB_MARK2] = 200.0;
+		symbolList[FormulaSymbol::SYMB_MARK3] = 300.0;
 		break;
 	default:
 		THROW_EXCEPTION(TRMControlModelException, "Invalid transition type: " << transitionType << '.');
 	}
 }
 
-/*******************************************************************************
- *
- */
-float
-Model::evalEquationFormula(const Equation& equation) const
-{
-	return equation.evalFormula(formulaSymbolList_);
-}
-
 /*******************************************************************************
  *
  */
@@ -665,11 +664,86 @@ Model::findSpecialTransitionIndex(const std::string& name, unsigned int& groupIn
 	return false;
 }
 
+/*******************************************************************************
+ * Evaluates the boolean expressions of all the rules for all the postures.
+ */
+void
+Model::updateRuleIndex()
+{
+	const unsigned int numRules = ruleList_.size();
+	const unsigned int numPostures = postureList_.size();
+	ruleSetSize_ = (numRules + 63) / 64;
+
+	postureIndexMap_.clear();
+	for (unsigned int i = 0; i < numPostures; ++i) {
+		postureIndexMap_[&postureList_[i]] = i;
+	}
+
+	ruleMatchTable_.assign(MAX_RULE_EXPRESSIONS * numPostures * ruleSetSize_, 0);
+	ruleSizeMaskTable_.assign((MAX_RULE_EXPRESSIONS + 1) * ruleSetSize_, 0);
+	for (unsigned int i = 0; i < numRules; ++i) {
+		const Rule& rule = *ruleList_[i];
+		const unsigned int word = i / 64;
+		const std::uint64_t bit = std::uint64_t(1) << (i % 64);
+		const unsigned int numExpressions = rule.numberOfExpressions();
+		if (numExpressions > MAX_RULE_EXPRESSIONS) {
+			THROW_EXCEPTION(TRMControlModelException, "Invalid number of boolean expressions: " << numExpressions << '.');
+		}
+
+		for (unsigned int size = numExpressions; size <= MAX_RULE_EXPRESSIONS; ++size) {
+			ruleSizeMaskTable_[size * ruleSetSize_ + word] |= bit;
+		}
+		for (unsigned int j = 0; j < MAX_RULE_EXPRESSIONS; ++j) {
+			for (unsigned int k = 0; k < numPostures; ++k) {
+				if (j >= numExpressions || rule.evalBooleanExpression(postureList_[k], j)) {
+					ruleMatchTable_[(j * numPostures + k) * ruleSetSize_ + word] |= bit;
+				}
+			}
+		}
+	}
+}
+
 /*******************************************************************************
  * Finds the first Rule that matches the given sequence of Postures.
  */
 const Rule*
 Model::findFirstMatchingRule(const std::vector<const Posture*>& postureSequence, unsigned int& ruleIndex) const
+{
+	const unsigned int numPostures = postureList_.size();
+	const unsigned int size = std::min<std::size_t>(postureSequence.size(), MAX_RULE_EXPRESSIONS);
+	const std::uint64_t* rows[MAX_RULE_EXPRESSIONS];
+	for (unsigned int i = 0; i < size; ++i) {
+		auto iter = postureIndexMap_.find(postureSequence[i]);
+		if (iter == postureIndexMap_.end()) {
+			// The posture does not belong to the model.
+			return findFirstMatchingRuleWithoutIndex(postureSequence, ruleIndex);
+		}
+		rows[i] = &ruleMatchTable_[(i * numPostures + iter->second) * ruleSetSize_];
+	}
+
+	const std::uint64_t* sizeMask = &ruleSizeMaskTable_[size * ruleSetSize_];
+	for (unsigned int word = 0; word < ruleSetSize_; ++word) {
+		std::uint64_t ruleSet = sizeMask[word];
+		for (unsigned int i = 0; i < size; ++i) {
+			ruleSet &= rows[i][word];
+		}
+		if (ruleSet != 0) {
+			unsigned int bitIndex = 0;
+			while ((ruleSet & 1U) == 0) {
+				ruleSet >>= 1;
+				++bitIndex;
+			}
+			ruleIndex = word * 64 + bitIndex;
+			return ruleList_[ruleIndex].get();
+		}
+	}
+
+	ruleIndex = 0;
+	return nullptr;
+}
+
+const Rule*
+Model::findFirstMatchingRuleWithoutIndex(const std::vector<const Posture*>& postureSequence, unsigned int& ruleIndex) const
 {
 	if (ruleList_.empty()) {
 		ruleIndex = 0;
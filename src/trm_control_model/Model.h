@@ -23,8 +23,10 @@
 #ifndef TRM_CONTROL_MODEL_MODEL_H_
 #define TRM_CONTROL_MODEL_MODEL_H_
 
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "Category.h"
@@ -46,6 +48,11 @@ namespace TRMControlModel {
 class ConfigFile;
 class InputFile;
 
+/*******************************************************************************
+ * The model is not modified during synthesis, so one instance may be shared
+ * by several Controllers running in different threads. The values of the
+ * formula symbols are kept by the user (see EventList).
+ */
 class Model {
 public:
 	Model();
@@ -55,14 +62,10 @@ public:
 	void load(const char* configDirPath, const char* configFileName);
 	void save(const char* configDirPath, const char* configFileName);
 	void printInfo() const;
-	void clearFormulaSymbolList();
-	void setFormulaSymbolValue(FormulaSymbol::Code symbol, float value);
-	float getFormulaSymbolValue(FormulaSymbol::Code symbol) const;
-	void setDefaultFormulaSymbols(Transition::Type transitionType);
+	static void setDefaultFormulaSymbols(Transition::Type transitionType, FormulaSymbolList& symbolList);
 
 	const std::vector<EquationGroup>& equationGroupList() const { return equationGroupList_; }
 	std::vector<EquationGroup>& equationGroupList() { return equationGroupList_; }
-	float evalEquationFormula(const Equation& equation) const;
 	bool findEquationGroupName(const std::string& name) const;
 	bool findEquationName(const std::string& name) const;
 	bool findEquationIndex(const std::string& name, unsigned int& groupIndex, unsigned int& index) const;
@@ -99,7 +102,10 @@ public:
 
 	const std::vector<std::unique_ptr<Rule>>& ruleList() const { return ruleList_; }
 	std::vector<std::unique_ptr<Rule>>& ruleList() { return ruleList_; }
+	// Uses the index created by updateRuleIndex.
 	const Rule* findFirstMatchingRule(const std::vector<const Posture*>& postureSequence, unsigned int& ruleIndex) const;
+	// Must be called after the rules or the postures are modified (load calls it).
+	void updateRuleIndex();
 
 	const std::vector<std::shared_ptr<Category>>& categoryList() const { return categoryList_; }
 	std::vector<std::shared_ptr<Category>>& categoryList() { return categoryList_; }
@@ -107,6 +113,12 @@ public:
 	std::shared_ptr<Category> findCategory(const std::string& name);
 	bool findCategoryName(const std::string& name) const;
 private:
+	enum {
+		MAX_RULE_EXPRESSIONS = 4
+	};
+
+	const Rule* findFirstMatchingRuleWithoutIndex(const std::vector<const Posture*>& postureSequence, unsigned int& ruleIndex) const;
+
 	std::vector<std::shared_ptr<Category>> categoryList_;
 	std::vector<Parameter> parameterList_;
 	std::vector<Symbol> symbolList_;
@@ -115,7 +127,16 @@ private:
 	std::vector<EquationGroup> equationGroupList_;
 	std::vector<TransitionGroup> transitionGroupList_;
 	std::vector<TransitionGroup> specialTransitionGroupList_;
-	FormulaSymbolList formulaSymbolList_;
+
+	// Rule index.
+	// The rules are represented by bits, in words of ruleSetSize_ elements.
+	unsigned int ruleSetSize_;
+	std::unordered_map<const Posture*, unsigned int> postureIndexMap_;
+	// [expression index][posture index][word]: the rules whose expression matches the posture.
+	// If the rule does not have the expression, the bit is set.
+	std::vector<std::uint64_t> ruleMatchTable_;
+	// [number of postures][word]: the rules that can be applied to a sequence of postures.
+	std::vector<std::uint64_t> ruleSizeMaskTable_;
 };
 
 } /* namespace TRMControlModel */
@@ -485,20 +485,20 @@ Rule::numberOfExpressions() const
 // ruleSymbols: {rd, beat, mark1, mark2, mark3}
 // tempos[4]
 void
-Rule::evaluateExpressionSymbols(const double* tempos, const std::vector<const Posture*>& postures, Model& model, double* ruleSymbols) const
+Rule::evaluateExpressionSymbols(const double* tempos, const std::vector<const Posture*>& postures, FormulaSymbolList& symbolList, double* ruleSymbols) const
 {
 	double localTempos[4];
 
-	model.clearFormulaSymbolList();
+	symbolList.fill(0.0f);
 	if (postures.size() >= 2) {
 		const Posture& posture = *postures[0];
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_TRANSITION1, posture.getSymbolTarget(1 /* hardcoded */));
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_QSSA1      , posture.getSymbolTarget(2 /* hardcoded */));
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_QSSB1      , posture.getSymbolTarget(3 /* hardcoded */));
+		symbolList[FormulaSymbol::SYMB_TRANSITION1] = posture.getSymbolTarget(1 /* hardcoded */);
+		symbolList[FormulaSymbol::SYMB_QSSA1]       = posture.getSymbolTarget(2 /* hardcoded */);
+		symbolList[FormulaSymbol::SYMB_QSSB1]       = posture.getSymbolTarget(3 /* hardcoded */);
 		const Posture& posture2 = *postures[1];
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_TRANSITION2, posture2.getSymbolTarget(1 /* hardcoded */));
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_QSSA2      , posture2.getSymbolTarget(2 /* hardcoded */));
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_QSSB2      , posture2.getSymbolTarget(3 /* hardcoded */));
+		symbolList[FormulaSymbol::SYMB_TRANSITION2] = posture2.getSymbolTarget(1 /* hardcoded */);
+		symbolList[FormulaSymbol::SYMB_QSSA2]       = posture2.getSymbolTarget(2 /* hardcoded */);
+		symbolList[FormulaSymbol::SYMB_QSSB2]       = posture2.getSymbolTarget(3 /* hardcoded */);
 		localTempos[0] = tempos[0];
 		localTempos[1] = tempos[1];
 	} else {
@@ -507,54 +507,54 @@ Rule::evaluateExpressionSymbols(const double* tempos, const std::vector<const Po
 	}
 	if (postures.size() >= 3) {
 		const Posture& posture = *postures[2];
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_TRANSITION3, posture.getSymbolTarget(1 /* hardcoded */));
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_QSSA3      , posture.getSymbolTarget(2 /* hardcoded */));
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_QSSB3      , posture.getSymbolTarget(3 /* hardcoded */));
+		symbolList[FormulaSymbol::SYMB_TRANSITION3] = posture.getSymbolTarget(1 /* hardcoded */);
+		symbolList[FormulaSymbol::SYMB_QSSA3]       = posture.getSymbolTarget(2 /* hardcoded */);
+		symbolList[FormulaSymbol::SYMB_QSSB3]       = posture.getSymbolTarget(3 /* hardcoded */);
 		localTempos[2] = tempos[2];
 	} else {
 		localTempos[2] = 0.0;
 	}
 	if (postures.size() == 4) {
 		const Posture& posture = *postures[3];
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_TRANSITION4, posture.getSymbolTarget(1 /* hardcoded */));
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_QSSA4      , posture.getSymbolTarget(2 /* hardcoded */));
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_QSSB4      , posture.getSymbolTarget(3 /* hardcoded */));
+		symbolList[FormulaSymbol::SYMB_TRANSITION4] = posture.getSymbolTarget(1 /* hardcoded */);
+		symbolList[FormulaSymbol::SYMB_QSSA4]       = posture.getSymbolTarget(2 /* hardcoded */);
+		symbolList[FormulaSymbol::SYMB_QSSB4]       = posture.getSymbolTarget(3 /* hardcoded */);
 		localTempos[3] = tempos[3];
 	} else {
 		localTempos[3] = 0.0;
 	}
-	model.setFormulaSymbolValue(FormulaSymbol::SYMB_TEMPO1, static_cast<float>(localTempos[0]));
-	model.setFormulaSymbolValue(FormulaSymbol::SYMB_TEMPO2, static_cast<float>(localTempos[1]));
-	model.setFormulaSymbolValue(FormulaSymbol::SYMB_TEMPO3, static_cast<float>(localTempos[2]));
-	model.setFormulaSymbolValue(FormulaSymbol::SYMB_TEMPO4, static_cast<float>(localTempos[3]));
-	model.setFormulaSymbolValue(FormulaSymbol::SYMB_RD   , static_cast<float>(ruleSymbols[0]));
-	model.setFormulaSymbolValue(FormulaSymbol::SYMB_BEAT , static_cast<float>(ruleSymbols[1]));
-	model.setFormulaSymbolValue(FormulaSymbol::SYMB_MARK1, static_cast<float>(ruleSymbols[2]));
-	model.setFormulaSymbolValue(FormulaSymbol::SYMB_MARK2, static_cast<float>(ruleSymbols[3]));
-	model.setFormulaSymbolValue(FormulaSymbol::SYMB_MARK3, static_cast<float>(ruleSymbols[4]));
+	symbolList[FormulaSymbol::SYMB_TEMPO1] = static_cast<float>(localTempos[0]);
+	symbolList[FormulaSymbol::SYMB_TEMPO2] = static_cast<float>(localTempos[1]);
+	symbolList[FormulaSymbol::SYMB_TEMPO3] = static_cast<float>(localTempos[2]);
+	symbolList[FormulaSymbol::SYMB_TEMPO4] = static_cast<float>(localTempos[3]);
+	symbolList[FormulaSymbol::SYMB_RD]    = static_cast<float>(ruleSymbols[0]);
+	symbolList[FormulaSymbol::SYMB_BEAT]  = static_cast<float>(ruleSymbols[1]);
+	symbolList[FormulaSymbol::SYMB_MARK1] = static_cast<float>(ruleSymbols[2]);
+	symbolList[FormulaSymbol::SYMB_MARK2] = static_cast<float>(ruleSymbols[3]);
+	symbolList[FormulaSymbol::SYMB_MARK3] = static_cast<float>(ruleSymbols[4]);
 
 	// Execute in this order.
 	if (exprSymbolEquations_.ruleDuration) {
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_RD   , model.evalEquationFormula(*exprSymbolEquations_.ruleDuration));
+		symbolList[FormulaSymbol::SYMB_RD]    = exprSymbolEquations_.ruleDuration->evalFormula(symbolList);
 	}
 	if (exprSymbolEquations_.mark1) {
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_MARK1, model.evalEquationFormula(*exprSymbolEquations_.mark1));
+		symbolList[FormulaSymbol::SYMB_MARK1] = exprSymbolEquations_.mark1->evalFormula(symbolList);
 	}
 	if (exprSymbolEquations_.mark2) {
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_MARK2, model.evalEquationFormula(*exprSymbolEquations_.mark2));
+		symbolList[FormulaSymbol::SYMB_MARK2] = exprSymbolEquations_.mark2->evalFormula(symbolList);
 	}
 	if (exprSymbolEquations_.mark3) {
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_MARK3, model.evalEquationFormula(*exprSymbolEquations_.mark3));
+		symbolList[FormulaSymbol::SYMB_MARK3] = exprSymbolEquations_.mark3->evalFormula(symbolList);
 	}
 	if (exprSymbolEquations_.beat) {
-		model.setFormulaSymbolValue(FormulaSymbol::SYMB_BEAT , model.evalEquationFormula(*exprSymbolEquations_.beat));
+		symbolList[FormulaSymbol::SYMB_BEAT]  = exprSymbolEquations_.beat->evalFormula(symbolList);
 	}
 
-	ruleSymbols[0] = model.getFormulaSymbolValue(FormulaSymbol::SYMB_RD);
-	ruleSymbols[1] = model.getFormulaSymbolValue(FormulaSymbol::SYMB_BEAT);
-	ruleSymbols[2] = model.getFormulaSymbolValue(FormulaSymbol::SYMB_MARK1);
-	ruleSymbols[3] = model.getFormulaSymbolValue(FormulaSymbol::SYMB_MARK2);
-	ruleSymbols[4] = model.getFormulaSymbolValue(FormulaSymbol::SYMB_MARK3);
+	ruleSymbols[0] = symbolList[FormulaSymbol::SYMB_RD];
+	ruleSymbols[1] = symbolList[FormulaSymbol::SYMB_BEAT];
+	ruleSymbols[2] = symbolList[FormulaSymbol::SYMB_MARK1];
+	ruleSymbols[3] = symbolList[FormulaSymbol::SYMB_MARK2];
+	ruleSymbols[4] = symbolList[FormulaSymbol::SYMB_MARK3];
 }
 
 void
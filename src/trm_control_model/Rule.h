@@ -30,6 +30,7 @@
 #include <vector>
 
 #include "Exception.h"
+#include "FormulaSymbol.h"
 
 
 
@@ -172,7 +173,7 @@ public:
 		specialProfileTransitionList_[parameterIndex] = transition;
 	}
 
-	void evaluateExpressionSymbols(const double* tempos, const std::vector<const Posture*>& postures, Model& model, double* ruleSymbols) const;
+	void evaluateExpressionSymbols(const double* tempos, const std::vector<const Posture*>& postures, FormulaSymbolList& symbolList, double* ruleSymbols) const;
 
 	const std::vector<std::string>& booleanExpressionList() const { return booleanExpressionList_; }
 	void setBooleanExpressionList(const std::vector<std::string>& exprList, const Model& model);
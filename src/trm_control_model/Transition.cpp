@@ -22,8 +22,6 @@
 
 #include "Transition.h"
 
-#include "Model.h"
-
 
 
 namespace GS {
@@ -40,37 +38,37 @@ Transition::SlopeRatio::totalSlopeUnits() const
 }
 
 double
-Transition::getPointTime(const Transition::Point& point, const Model& model)
+Transition::getPointTime(const Transition::Point& point, const FormulaSymbolList& symbolList)
 {
 	if (!point.timeExpression) {
 		return point.freeTime;
 	} else {
-		return model.evalEquationFormula(*point.timeExpression);
+		return point.timeExpression->evalFormula(symbolList);
 	}
 }
 
 void
-Transition::getPointData(const Transition::Point& point, const Model& model,
+Transition::getPointData(const Transition::Point& point, const FormulaSymbolList& symbolList,
 				double& time, double& value)
 {
 	if (!point.timeExpression) {
 		time = point.freeTime;
 	} else {
-		time = model.evalEquationFormula(*point.timeExpression);
+		time = point.timeExpression->evalFormula(symbolList);
 	}
 
 	value = point.value;
 }
 
 void
-Transition::getPointData(const Transition::Point& point, const Model& model,
+Transition::getPointData(const Transition::Point& point, const FormulaSymbolList& symbolList,
 				double baseline, double delta, double min, double max,
 				double& time, double& value)
 {
 	if (!point.timeExpression) {
 		time = point.freeTime;
 	} else {
-		time = model.evalEquationFormula(*point.timeExpression);
+		time = point.timeExpression->evalFormula(symbolList);
 	}
 
 	value = baseline + ((point.value / 100.0) * delta);
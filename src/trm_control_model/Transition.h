@@ -35,8 +35,6 @@
 namespace GS {
 namespace TRMControlModel {
 
-class Model;
-
 class Transition {
 public:
 	enum Type {
@@ -173,10 +171,10 @@ public:
 	std::vector<PointOrSlope_ptr>& pointOrSlopeList() { return pointOrSlopeList_; }
 	const std::vector<PointOrSlope_ptr>& pointOrSlopeList() const { return pointOrSlopeList_; }
 
-	static double getPointTime(const Transition::Point& point, const Model& model);
-	static void getPointData(const Transition::Point& point, const Model& model,
+	static double getPointTime(const Transition::Point& point, const FormulaSymbolList& symbolList);
+	static void getPointData(const Transition::Point& point, const FormulaSymbolList& symbolList,
 					double& time, double& value);
-	static void getPointData(const Transition::Point& point, const Model& model,
+	static void getPointData(const Transition::Point& point, const FormulaSymbolList& symbolList,
 					double baseline, double delta, double min, double max,
 					double& time, double& value);
 	static Type getTypeFromName(const std::string& typeName) {
@@ -558,6 +558,12 @@ void
 XMLConfigFileReader::loadModel()
 {
 	std::string source = readXMLFile(filePath_);
+	loadModel(source);
+}
+
+void
+XMLConfigFileReader::loadModel(std::string& source)
+{
 	xml_document<char> doc;
 	doc.parse<parse_no_data_nodes | parse_validate_closing_tags>(&source[0]);
 
@@ -51,6 +51,8 @@ public:
 	//
 	// Precondition: the model is empty.
 	void loadModel();
+	// source: contents of the XML file (will be modified).
+	void loadModel(std::string& source);
 private:
 	XMLConfigFileReader(const XMLConfigFileReader&) = delete;
 	XMLConfigFileReader& operator=(const XMLConfigFileReader&) = delete;
@@ -0,0 +1,12 @@
+# Writes the output of REFERENCE_PROGRAM for INPUT to SAMPLES, and compares
+# the output of TEST_PROGRAM with it. Fails if the SNR is below MIN_SNR dB.
+
+execute_process(COMMAND ${REFERENCE_PROGRAM} -d ${SAMPLES} ${INPUT} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Could not write the reference samples (${result}).")
+endif()
+
+execute_process(COMMAND ${TEST_PROGRAM} -c ${SAMPLES} -s ${MIN_SNR} ${INPUT} RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "The output differs from the reference (${result}).")
+endif()